@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "music-tags.hpp"
+#include "quality-governor.hpp"
+#include "stream-file.hpp"
+#include "stream-stats.hpp"
+
+// the format specific part of a stream (the *Stream classes), reads a file and produces blocks of PCM at the source rate
+// StreamPipeline does everything after that
+class AudioDecoder
+{
+public:
+    // filled in by open()
+    struct SourceInfo
+    {
+        int sampleRate = 0;
+        int channels = 0;
+
+        // the most channels in a decoded block, less than channels if the decoder mixes them itself
+        int blockChannels = 0;
+
+        uint64_t totalFrames = 0; // 0 if unknown
+        uint32_t fileLength = 0;
+
+        // cost of decoding at full quality, from QualityGovernor::estimateCost
+        float cost = 1.0f;
+    };
+
+    // decode() is never asked for fewer frames than this, enough for the smallest fixed unit (a QOA slice)
+    static const int minBlockFrames = 64;
+
+    virtual ~AudioDecoder(){}
+
+    // opens a file and reads the headers and tags, returns false if it can't be played
+    virtual bool open(const std::string &filename, SourceInfo &info, MusicTags &tags) = 0;
+
+    // decodes up to maxFrames interleaved frames into out, returns the number of frames (0 at the end of the file)
+    // blockChannels is set to the channels in this block, which can be fewer than SourceInfo::blockChannels in the cheaper quality modes
+    // anything left of a larger unit (an MP3/FLAC frame, a module tick) is kept for the next call
+    virtual int decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels) = 0;
+
+    // jumps to ms into the track, returns the frame it actually got to
+    virtual uint64_t seek(int ms) = 0;
+
+    // bytes of the file used so far, for the bitrate
+    virtual uint32_t getInputPos() const = 0;
+
+    // for the read stats/time
+    virtual const StreamFile &getFile() const = 0;
+
+    // anything else for the stats overlay, after each block
+    virtual void updateStats(StreamStats &stats) const {}
+};
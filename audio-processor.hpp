@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+
+// a stage that modifies blocks of decoded (mono, 22050Hz) samples in place
+class AudioProcessor
+{
+public:
+    virtual ~AudioProcessor(){}
+
+    // called on track change to clear any filter state
+    virtual void reset() {}
+
+    virtual void process(int16_t *samples, int count) = 0;
+};
+
+// runs several processors in order
+class ProcessorChain final : public AudioProcessor
+{
+public:
+    bool add(AudioProcessor *processor)
+    {
+        if(numProcessors == maxProcessors)
+            return false;
+
+        processors[numProcessors++] = processor;
+        return true;
+    }
+
+    void reset() override
+    {
+        for(int i = 0; i < numProcessors; i++)
+            processors[i]->reset();
+    }
+
+    void process(int16_t *samples, int count) override
+    {
+        for(int i = 0; i < numProcessors; i++)
+            processors[i]->process(samples, count);
+    }
+
+private:
+    static const int maxProcessors = 4;
+
+    AudioProcessor *processors[maxProcessors];
+    int numProcessors = 0;
+};
@@ -0,0 +1,181 @@
+#include <cstring>
+
+#include "audio-sink.hpp"
+
+#include "audio/audio.hpp"
+#include "trace.hpp"
+
+void AudioSink::reset()
+{
+    if(channel != -1)
+        blit::channels[channel].off();
+
+    started = ended = false;
+    ring.reset();
+    bufferedSamples = 0;
+    underruns = 0;
+}
+
+void AudioSink::play(int channel)
+{
+    this->channel = channel;
+
+    if(!started)
+    {
+        started = true;
+        blit::channels[channel].wave_buf_pos = 0;
+
+        // the start of the track doesn't need fading in
+        fade.reset(true);
+    }
+    else if(blit::channels[channel].adsr_phase == blit::ADSRPhase::OFF)
+    {
+        // stopped at the end of the track (and then seeked back)
+        fade.reset(false);
+    }
+
+    fade.fadeIn();
+
+    blit::channels[channel].waveforms = blit::Waveform::WAVE;
+    blit::channels[channel].user_data = this;
+    blit::channels[channel].wave_buffer_callback = &AudioSink::staticCallback;
+
+    blit::channels[channel].adsr = 0xFFFF00;
+    blit::channels[channel].trigger_sustain();
+}
+
+void AudioSink::fadeOut()
+{
+    fade.fadeOut();
+}
+
+bool AudioSink::getStarted() const
+{
+    return started;
+}
+
+bool AudioSink::getPlaying() const
+{
+    return channel != -1 && blit::channels[channel].adsr_phase == blit::ADSRPhase::SUSTAIN && fade.getOn();
+}
+
+bool AudioSink::getSilent() const
+{
+    return channel == -1 || blit::channels[channel].adsr_phase == blit::ADSRPhase::OFF || fade.getSilent();
+}
+
+int AudioSink::getChannel() const
+{
+    return channel;
+}
+
+void AudioSink::setEnded()
+{
+    ended = true;
+}
+
+bool AudioSink::getEnded() const
+{
+    return ended;
+}
+
+void AudioSink::restart(int position)
+{
+    ring.reset();
+    ended = false;
+    bufferedSamples = position;
+}
+
+int AudioSink::getPosition() const
+{
+    if(channel == -1)
+        return 0;
+
+    return bufferedSamples + blit::channels[channel].wave_buf_pos;
+}
+
+bool AudioSink::wantBlock(uint32_t elapsedUs) const
+{
+    return ring.wantBlock(elapsedUs);
+}
+
+int AudioSink::getFilled() const
+{
+    return ring.getFilled();
+}
+
+int AudioSink::peek(int16_t *samples, int count) const
+{
+    return ring.peek(samples, count);
+}
+
+bool AudioSink::write(const int16_t *samples, int count)
+{
+    return ring.write(samples, count);
+}
+
+int16_t *AudioSink::beginWrite(int &count)
+{
+    return ring.beginWrite(count);
+}
+
+void AudioSink::endWrite(int count)
+{
+    ring.endWrite(count);
+}
+
+uint32_t AudioSink::getUnderruns() const
+{
+    return underruns;
+}
+
+void AudioSink::staticCallback(blit::AudioChannel &channel)
+{
+    reinterpret_cast<AudioSink *>(channel.user_data)->callback(channel);
+}
+
+void AudioSink::callback(blit::AudioChannel &channel)
+{
+    TRACE_THREAD_NAME("Audio");
+    TRACE_SCOPE("Audio callback");
+
+    if(!started)
+    {
+        channel.off();
+        return;
+    }
+
+    // paused or seeking, hold the position
+    if(fade.getSilent())
+    {
+        memset(channel.wave_buffer, 0, 64 * sizeof(int16_t));
+        return;
+    }
+
+    // check this first, everything has been written to the ring once it's set
+    bool atEnd = ended;
+
+    // underrun, wait until there's a whole buffer
+    if(!atEnd && ring.getFilled() < 64)
+    {
+        memset(channel.wave_buffer, 0, 64 * sizeof(int16_t));
+        underruns++;
+        return;
+    }
+
+    int read = ring.read(channel.wave_buffer, 64);
+
+    if(!read)
+    {
+        channel.off();
+        return;
+    }
+
+    // pad the end of the track
+    if(read < 64)
+        memset(channel.wave_buffer + read, 0, (64 - read) * sizeof(int16_t));
+
+    fade.process(channel.wave_buffer, 64);
+
+    bufferedSamples += 64;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "audio/audio.hpp"
+
+#include "fade-ramp.hpp"
+#include "sample-ring.hpp"
+
+// the end of a StreamPipeline, the ring of processed samples and the blit::AudioChannel callback that plays them
+class AudioSink final
+{
+public:
+    // stops the channel and empties the ring, for loading a new track
+    void reset();
+
+    // starts the channel, or fades back in if it's already running
+    void play(int channel);
+
+    // the channel keeps running, the callback holds the position once the fade has finished
+    void fadeOut();
+
+    // something has been played since reset()
+    bool getStarted() const;
+
+    bool getPlaying() const;
+    bool getSilent() const;
+
+    int getChannel() const;
+
+    // everything has been written, the channel stops once it has all been played
+    void setEnded();
+    bool getEnded() const;
+
+    // empties the ring and jumps to position (in output samples), only while silent
+    void restart(int position);
+
+    // output samples played so far
+    int getPosition() const;
+
+    // the same as SampleRing
+    bool wantBlock(uint32_t elapsedUs) const;
+    int getFilled() const;
+    int peek(int16_t *samples, int count) const;
+
+    bool write(const int16_t *samples, int count);
+    int16_t *beginWrite(int &count);
+    void endWrite(int count);
+
+    // audio callbacks that had nothing to play
+    uint32_t getUnderruns() const;
+
+private:
+    static void staticCallback(blit::AudioChannel &channel);
+    void callback(blit::AudioChannel &channel);
+
+    int channel = -1;
+
+    SampleRing ring;
+    bool started = false;
+    std::atomic<bool> ended{false};
+
+    int bufferedSamples = 0;
+
+    FadeRamp fade;
+
+    uint32_t underruns = 0;
+};
@@ -0,0 +1,552 @@
+// decodes files as fast as possible through the streams, using the stubbed blit APIs
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "audio/audio.hpp"
+#include "engine/file.hpp"
+
+#include "dynamics.hpp"
+#include "equalizer.hpp"
+#include "stream-pipeline.hpp"
+#include "stream-registry.hpp"
+#include "trace.hpp"
+
+struct BenchResult
+{
+    std::string filename;
+    bool loaded = false;
+
+    uint64_t outputSamples = 0;
+    uint64_t loadNs = 0; // includes the duration scan
+    uint64_t totalNs = 0; // play + update calls
+    uint64_t readNs = 0, callbackNs = 0;
+    uint64_t bytesRead = 0;
+
+    // from the stream's stats
+    uint64_t stageUs[int(PipelineStage::Count)]{};
+
+    double getAudioSeconds() const {return outputSamples / 22050.0;}
+    double getRealtimeFactor() const {return totalNs ? getAudioSeconds() * 1e9 / totalNs : 0.0;}
+    double getNsPerSample() const {return outputSamples ? static_cast<double>(totalNs) / outputSamples : 0.0;}
+    uint64_t getDecodeNs() const {return totalNs - readNs;}
+};
+
+// golden PCM checks, each file is decoded in every mode and compared to previously written output
+// the cheaper modes are also compared to the full quality output, so a reference written from a broken build doesn't pass forever
+struct DecodeMode
+{
+    const char *name;
+    QualityMode quality;
+    bool dsp;
+
+    // error budget against the reference
+    int maxError;
+    double minPSNR;
+
+    // against the full quality output, 0 to skip. loose, as dropping the upper subbands removes a lot of the MP3 fixture
+    // (and the cheap mode does that as well)
+    double minFullPSNR;
+};
+
+static const DecodeMode decodeModes[]
+{
+    {"decode", QualityMode::Full, false, 64, 60.0, 0.0},
+    {"dsp", QualityMode::Full, true, 256, 50.0, 0.0},
+
+    // the cheaper modes have their own references, skipping work makes them more sensitive to rounding differences
+    {"mono", QualityMode::Mono, false, 64, 60.0, 40.0},
+    {"half", QualityMode::HalfBandwidth, false, 96, 56.0, 23.0},
+    {"cheap", QualityMode::CheapResampler, false, 128, 52.0, 23.0},
+};
+
+enum class GoldenOp
+{
+    None,
+    Write,
+    Check
+};
+
+struct GoldenResult
+{
+    std::string filename;
+    const DecodeMode *mode;
+
+    bool ok = false;
+    std::string error;
+
+    bool compared = false;
+    int maxError = 0;
+    double psnr = 0.0;
+
+    bool comparedFull = false;
+    double fullPSNR = 0.0;
+};
+
+static Equalizer equalizer;
+static Dynamics dynamics;
+static ProcessorChain processorChain;
+
+static uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string getExtension(const std::string &filename)
+{
+    auto dot = filename.find_last_of('.');
+    if(dot == std::string::npos)
+        return "";
+
+    auto ext = filename.substr(dot);
+    std::for_each(ext.begin(), ext.end(), [](char &c) {c = tolower(c);});
+    return ext;
+}
+
+static bool isSupportedFile(const std::string &filename)
+{
+    auto extensions = StreamRegistry::getExtensions();
+    return std::find(extensions.begin(), extensions.end(), getExtension(filename)) != extensions.end();
+}
+
+static StreamPipeline pipeline;
+
+static void setDSP(bool enabled)
+{
+    pipeline.setProcessor(enabled ? &processorChain : nullptr);
+}
+
+static void setQualityMode(QualityMode mode)
+{
+    pipeline.setQualityMode(mode);
+}
+
+static bool parseQualityMode(const char *name, QualityMode &mode)
+{
+    static const char *names[]{"full", "mono", "half", "cheap", "auto"};
+
+    for(int i = 0; i <= int(QualityMode::Auto); i++)
+    {
+        if(strcmp(name, names[i]) == 0)
+        {
+            mode = QualityMode(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static BenchResult benchFile(const std::string &filename, std::vector<int16_t> *output = nullptr)
+{
+    BenchResult result;
+    result.filename = filename;
+
+    fileStats = FileStats();
+
+    auto start = nowNs();
+
+    // includes the probe read
+    bool loaded = pipeline.load(filename);
+
+    result.loadNs = nowNs() - start;
+
+    if(!loaded)
+        return result;
+
+    auto stream = &pipeline;
+
+    result.loaded = true;
+
+    auto loadReadNs = fileStats.readNs;
+    auto &channel = blit::channels[0];
+
+    start = nowNs();
+    stream->play(0);
+    result.totalNs += nowNs() - start;
+
+    // refill whenever needed, then take another block
+    while(channel.adsr_phase != blit::ADSRPhase::OFF)
+    {
+        start = nowNs();
+        stream->update();
+        auto mid = nowNs();
+        channel.wave_buffer_callback(channel);
+        auto end = nowNs();
+
+        result.totalNs += mid - start;
+        result.callbackNs += end - mid;
+
+        if(channel.adsr_phase != blit::ADSRPhase::OFF)
+        {
+            result.outputSamples += 64;
+
+            if(output)
+                output->insert(output->end(), channel.wave_buffer, channel.wave_buffer + 64);
+        }
+    }
+
+    result.readNs = fileStats.readNs - loadReadNs;
+    result.bytesRead = fileStats.readBytes;
+
+    auto &stats = stream->getStats();
+    std::copy(std::begin(stats.stageUs), std::end(stats.stageUs), result.stageUs);
+
+    return result;
+}
+
+static std::string getGoldenPath(const std::string &dir, const std::string &filename, const DecodeMode &mode)
+{
+    return dir + "/" + std::filesystem::path(filename).filename().string() + "." + mode.name + ".pcm";
+}
+
+// raw 16-bit mono, 22050Hz, native endian
+static bool writePCM(const std::string &path, const std::vector<int16_t> &samples)
+{
+    auto fh = fopen(path.c_str(), "wb");
+    if(!fh)
+        return false;
+
+    bool ok = fwrite(samples.data(), sizeof(int16_t), samples.size(), fh) == samples.size();
+    fclose(fh);
+
+    return ok;
+}
+
+static bool readPCM(const std::string &path, std::vector<int16_t> &samples)
+{
+    auto fh = fopen(path.c_str(), "rb");
+    if(!fh)
+        return false;
+
+    fseek(fh, 0, SEEK_END);
+    samples.resize(ftell(fh) / sizeof(int16_t));
+    fseek(fh, 0, SEEK_SET);
+
+    bool ok = fread(samples.data(), sizeof(int16_t), samples.size(), fh) == samples.size();
+    fclose(fh);
+
+    return ok;
+}
+
+// identical output is reported as infinite PSNR
+static double calcPSNR(const std::vector<int16_t> &samples, const std::vector<int16_t> &reference, int &maxError)
+{
+    maxError = 0;
+
+    double errorSq = 0.0;
+    for(size_t i = 0; i < samples.size(); i++)
+    {
+        int error = samples[i] - reference[i];
+        maxError = std::max(maxError, std::abs(error));
+        errorSq += double(error) * error;
+    }
+
+    double mse = samples.empty() ? 0.0 : errorSq / samples.size();
+    return mse > 0.0 ? 10.0 * std::log10(32767.0 * 32767.0 / mse) : std::numeric_limits<double>::infinity();
+}
+
+// fullSamples is the output of the first (full quality) mode, every other mode has to be the same length
+static GoldenResult goldenFile(const std::string &filename, const DecodeMode &mode, GoldenOp op, const std::string &dir, std::vector<int16_t> &fullSamples)
+{
+    GoldenResult result;
+    result.filename = filename;
+    result.mode = &mode;
+
+    setDSP(mode.dsp);
+    setQualityMode(mode.quality);
+
+    std::vector<int16_t> samples;
+    if(!benchFile(filename, &samples).loaded)
+    {
+        result.error = "failed to load";
+        return result;
+    }
+
+    // a different length means the speed changed, which no reference should accept
+    if(&mode == decodeModes)
+        fullSamples = samples;
+    else if(samples.size() != fullSamples.size())
+    {
+        result.error = "length " + std::to_string(samples.size()) + ", full quality is " + std::to_string(fullSamples.size());
+        return result;
+    }
+
+    if(mode.minFullPSNR > 0.0)
+    {
+        int maxError;
+        result.comparedFull = true;
+        result.fullPSNR = calcPSNR(samples, fullSamples, maxError);
+
+        if(result.fullPSNR < mode.minFullPSNR)
+        {
+            result.error = "too far from full quality";
+            return result;
+        }
+    }
+
+    auto path = getGoldenPath(dir, filename, mode);
+
+    if(op == GoldenOp::Write)
+    {
+        result.ok = writePCM(path, samples);
+        if(!result.ok)
+            result.error = "failed to write " + path;
+
+        return result;
+    }
+
+    std::vector<int16_t> reference;
+    if(!readPCM(path, reference))
+    {
+        result.error = "no reference";
+        return result;
+    }
+
+    if(samples.size() != reference.size())
+    {
+        result.error = "length " + std::to_string(samples.size()) + ", expected " + std::to_string(reference.size());
+        return result;
+    }
+
+    result.compared = true;
+    result.psnr = calcPSNR(samples, reference, result.maxError);
+
+    result.ok = result.maxError <= mode.maxError && result.psnr >= mode.minPSNR;
+
+    if(!result.ok)
+        result.error = "over budget";
+
+    return result;
+}
+
+static void printGoldenTable(const std::vector<GoldenResult> &results, GoldenOp op)
+{
+    if(op == GoldenOp::Check)
+        printf("%-40s %-8s %9s %9s %9s  %s\n", "file", "mode", "max error", "PSNR dB", "vs full", "result");
+    else
+        printf("%-40s %-8s %9s  %s\n", "file", "mode", "vs full", "result");
+
+    for(auto &result : results)
+    {
+        auto name = std::filesystem::path(result.filename).filename().string();
+        if(name.length() > 40)
+            name = name.substr(0, 37) + "...";
+
+        auto status = result.ok ? std::string("ok") : "FAIL (" + result.error + ")";
+
+        char fullPSNR[16] = "-";
+        if(result.comparedFull)
+            snprintf(fullPSNR, sizeof(fullPSNR), "%.1f", result.fullPSNR);
+
+        if(result.compared)
+            printf("%-40s %-8s %9i %9.1f %9s  %s\n", name.c_str(), result.mode->name, result.maxError, result.psnr, fullPSNR, status.c_str());
+        else if(op == GoldenOp::Check)
+            printf("%-40s %-8s %9s %9s %9s  %s\n", name.c_str(), result.mode->name, "-", "-", fullPSNR, status.c_str());
+        else
+            printf("%-40s %-8s %9s  %s\n", name.c_str(), result.mode->name, fullPSNR, status.c_str());
+    }
+}
+
+static void printTable(const std::vector<BenchResult> &results)
+{
+    printf("%-40s %8s %8s %9s %9s %9s %9s %9s\n", "file", "audio s", "load ms", "decode ms", "read ms", "ns/sample", "realtime", "read %");
+
+    for(auto &result : results)
+    {
+        auto name = std::filesystem::path(result.filename).filename().string();
+        if(name.length() > 40)
+            name = name.substr(0, 37) + "...";
+
+        if(!result.loaded)
+        {
+            printf("%-40s failed to load\n", name.c_str());
+            continue;
+        }
+
+        printf("%-40s %8.1f %8.1f %9.1f %9.2f %9.1f %8.1fx %8.1f%%\n", name.c_str(),
+            result.getAudioSeconds(), result.loadNs / 1e6, result.getDecodeNs() / 1e6, result.readNs / 1e6,
+            result.getNsPerSample(), result.getRealtimeFactor(), result.totalNs ? result.readNs * 100.0 / result.totalNs : 0.0);
+    }
+}
+
+static void writeJSON(FILE *out, const std::vector<BenchResult> &results, bool dsp)
+{
+    fprintf(out, "{\n  \"outputRate\": 22050,\n  \"dsp\": %s,\n  \"files\": [\n", dsp ? "true" : "false");
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        auto &result = results[i];
+
+        // paths shouldn't contain anything that needs more escaping than this
+        std::string name;
+        for(auto c : result.filename)
+        {
+            if(c == '"' || c == '\\')
+                name += '\\';
+            name += c;
+        }
+
+        fprintf(out, "    {\"file\": \"%s\", \"loaded\": %s", name.c_str(), result.loaded ? "true" : "false");
+
+        if(result.loaded)
+        {
+            fprintf(out, ", \"outputSamples\": %llu, \"audioSeconds\": %.3f, \"loadNs\": %llu, \"totalNs\": %llu, \"decodeNs\": %llu, \"readNs\": %llu, \"callbackNs\": %llu, \"bytesRead\": %llu, \"nsPerSample\": %.2f, \"realtimeFactor\": %.2f",
+                static_cast<unsigned long long>(result.outputSamples), result.getAudioSeconds(),
+                static_cast<unsigned long long>(result.loadNs), static_cast<unsigned long long>(result.totalNs),
+                static_cast<unsigned long long>(result.getDecodeNs()), static_cast<unsigned long long>(result.readNs),
+                static_cast<unsigned long long>(result.callbackNs), static_cast<unsigned long long>(result.bytesRead),
+                result.getNsPerSample(), result.getRealtimeFactor());
+
+            fprintf(out, ", \"stageUs\": {");
+
+            for(int j = 0; j < int(PipelineStage::Count); j++)
+            {
+                std::string stageName = getPipelineStageName(PipelineStage(j));
+                std::for_each(stageName.begin(), stageName.end(), [](char &c) {c = tolower(c);});
+
+                fprintf(out, "%s\"%s\": %llu", j ? ", " : "", stageName.c_str(), static_cast<unsigned long long>(result.stageUs[j]));
+            }
+
+            fprintf(out, "}");
+        }
+
+        fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> files;
+    const char *jsonPath = nullptr;
+    const char *tracePath = nullptr;
+    bool dsp = false;
+    QualityMode quality = QualityMode::Full;
+
+    GoldenOp goldenOp = GoldenOp::None;
+    std::string goldenDir;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else if(strcmp(argv[i], "--dsp") == 0)
+            dsp = true;
+        else if(strcmp(argv[i], "--quality") == 0 && i + 1 < argc)
+        {
+            if(!parseQualityMode(argv[++i], quality))
+            {
+                fprintf(stderr, "unknown quality mode %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if((strcmp(argv[i], "--golden-write") == 0 || strcmp(argv[i], "--golden-check") == 0) && i + 1 < argc)
+        {
+            goldenOp = argv[i][9] == 'w' ? GoldenOp::Write : GoldenOp::Check;
+            goldenDir = argv[++i];
+        }
+        else if(argv[i][0] == '-')
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+        else if(std::filesystem::is_directory(argv[i]))
+        {
+            for(auto &entry : std::filesystem::recursive_directory_iterator(argv[i]))
+            {
+                if(entry.is_regular_file() && isSupportedFile(entry.path().string()))
+                    files.push_back(entry.path().string());
+            }
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    if(files.empty())
+    {
+        fprintf(stderr, "usage: %s [--dsp] [--quality mode] [--json file|-] [--trace file] <file or directory>...\n", argv[0]);
+        fprintf(stderr, "  --dsp   enable the speaker EQ/dynamics processing\n");
+        fprintf(stderr, "  --quality full|mono|half|cheap|auto  decode quality (default full, ignored by golden checks)\n");
+        fprintf(stderr, "  --json  write results as JSON, - for stdout (replaces the table)\n");
+        fprintf(stderr, "  --trace file  write a Chrome trace of the last events (refills, decodes, reads, callbacks)\n");
+        fprintf(stderr, "  --golden-write dir  decode in every mode and write the output to dir as reference PCM\n");
+        fprintf(stderr, "  --golden-check dir  decode in every mode and compare against the reference PCM, fails if any mode is over its error budget\n");
+        return 1;
+    }
+
+    std::sort(files.begin(), files.end());
+
+    equalizer.setPreset(Equalizer::Preset::Speaker);
+    dynamics.setPreset(Dynamics::Preset::Speaker);
+    processorChain.add(&equalizer);
+    processorChain.add(&dynamics);
+
+    if(goldenOp != GoldenOp::None)
+    {
+        if(goldenOp == GoldenOp::Write)
+            std::filesystem::create_directories(goldenDir);
+
+        std::vector<GoldenResult> goldenResults;
+        bool failed = false;
+
+        for(auto &file : files)
+        {
+            std::vector<int16_t> fullSamples;
+
+            for(auto &mode : decodeModes)
+            {
+                goldenResults.push_back(goldenFile(file, mode, goldenOp, goldenDir, fullSamples));
+                failed = failed || !goldenResults.back().ok;
+            }
+        }
+
+        printGoldenTable(goldenResults, goldenOp);
+        return failed ? 1 : 0;
+    }
+
+    setDSP(dsp);
+    setQualityMode(quality);
+
+    std::vector<BenchResult> results;
+
+    for(auto &file : files)
+        results.push_back(benchFile(file));
+
+    bool jsonToStdout = jsonPath && strcmp(jsonPath, "-") == 0;
+
+    if(!jsonToStdout)
+        printTable(results);
+
+    if(jsonToStdout)
+        writeJSON(stdout, results, dsp);
+    else if(jsonPath)
+    {
+        auto out = fopen(jsonPath, "w");
+        if(!out)
+        {
+            fprintf(stderr, "failed to open %s\n", jsonPath);
+            return 1;
+        }
+
+        writeJSON(out, results, dsp);
+        fclose(out);
+    }
+
+    if(tracePath && !traceDump(tracePath))
+    {
+        fprintf(stderr, "failed to open %s\n", tracePath);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <cinttypes>
+
+#include "fault-file.hpp"
+
+bool FaultConfig::isEnabled() const
+{
+    return latencyUs > 0.0 || usPerKB > 0.0 || tailChance > 0.0 || shortReadChance > 0.0 || errorChance > 0.0;
+}
+
+FaultFileBackend::FaultFileBackend(const FaultConfig &config) : config(config), rng(config.seed)
+{
+}
+
+int32_t FaultFileBackend::read(blit::File &file, uint32_t offset, uint32_t length, char *buffer)
+{
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    double latency = config.latencyUs + config.usPerKB * length / 1024.0;
+
+    if(config.tailChance > 0.0 && chance(rng) < config.tailChance)
+        latency += std::exponential_distribution<double>(1.0 / config.tailMeanUs)(rng);
+
+    int32_t result;
+
+    if(config.errorChance > 0.0 && chance(rng) < config.errorChance)
+        result = -1;
+    else
+    {
+        // anywhere from one byte to one short
+        auto readLength = length;
+        if(length > 1 && config.shortReadChance > 0.0 && chance(rng) < config.shortReadChance)
+            readLength = std::uniform_int_distribution<uint32_t>(1, length - 1)(rng);
+
+        result = file.read(offset, readLength, buffer);
+    }
+
+    pendingLatencyUs += latency;
+    reads.push_back({timeMs, offset, length, result, latency});
+
+    return result;
+}
+
+void FaultFileBackend::setTime(double timeMs)
+{
+    this->timeMs = timeMs;
+}
+
+double FaultFileBackend::takeLatencyUs()
+{
+    auto ret = pendingLatencyUs;
+    pendingLatencyUs = 0.0;
+    return ret;
+}
+
+const std::vector<ReadRecord> &FaultFileBackend::getReads() const
+{
+    return reads;
+}
+
+void FaultFileBackend::clearReads()
+{
+    reads.clear();
+}
+
+void FaultFileBackend::writeLogHeader(FILE *fh)
+{
+    fprintf(fh, "file,time_ms,offset,length,result,latency_us\n");
+}
+
+void FaultFileBackend::writeLog(FILE *fh, const std::string &label) const
+{
+    for(auto &read : reads)
+        fprintf(fh, "\"%s\",%.3f,%" PRIu32 ",%" PRIu32 ",%" PRIi32 ",%.1f\n", label.c_str(), read.timeMs, read.offset, read.length, read.result, read.latencyUs);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "stream-file.hpp"
+
+// file backend that makes reads slow/unreliable like an SD card can be, and records every read
+// the latency is simulated, the caller decides what to do with it (the virtual clock in playback-sim)
+
+struct FaultConfig
+{
+    // per read, plus transfer time
+    double latencyUs = 0.0;
+    double usPerKB = 0.0;
+
+    // the long tail, some reads get an extra exponentially distributed delay
+    double tailChance = 0.0;
+    double tailMeanUs = 0.0;
+
+    double shortReadChance = 0.0;
+    double errorChance = 0.0;
+
+    unsigned int seed = 1;
+
+    bool isEnabled() const;
+};
+
+struct ReadRecord
+{
+    double timeMs; // virtual time of the read
+    uint32_t offset, length;
+    int32_t result;
+    double latencyUs;
+};
+
+class FaultFileBackend final : public FileBackend
+{
+public:
+    FaultFileBackend(const FaultConfig &config);
+
+    int32_t read(blit::File &file, uint32_t offset, uint32_t length, char *buffer) override;
+
+    // sets the time recorded for the following reads
+    void setTime(double timeMs);
+
+    // latency added since the last call
+    double takeLatencyUs();
+
+    const std::vector<ReadRecord> &getReads() const;
+    void clearReads();
+
+    // appends the reads as CSV rows, labelled with the file being played
+    static void writeLogHeader(FILE *fh);
+    void writeLog(FILE *fh, const std::string &label) const;
+
+private:
+    FaultConfig config;
+    std::mt19937 rng;
+
+    double timeMs = 0.0;
+    double pendingLatencyUs = 0.0;
+
+    std::vector<ReadRecord> reads;
+};
@@ -0,0 +1,114 @@
+// 32blit front end for the kernel microbenchmarks, runs on the files in /bench and shows/logs the results
+#include <cinttypes>
+
+#include "32blit.hpp"
+
+#include "kernel-bench.hpp"
+
+// only the start of each file is loaded, that's enough to fill the captures without running out of RAM
+static const uint32_t maxFileBytes = 64 * 1024;
+static const int maxCases = 6;
+
+static std::vector<std::string> files;
+static unsigned int nextFile = 0;
+
+static std::vector<std::string> lines;
+
+static std::string getExtension(const std::string &filename)
+{
+    auto dot = filename.find_last_of('.');
+    if(dot == std::string::npos)
+        return "";
+
+    auto ext = filename.substr(dot);
+    std::for_each(ext.begin(), ext.end(), [](char &c) {c = tolower(c);});
+    return ext;
+}
+
+static void addLine(const std::string &line)
+{
+    lines.push_back(line);
+    blit::debug(line + "\n");
+}
+
+static void benchFile(const std::string &filename)
+{
+    addLine(filename);
+
+    blit::File file(filename);
+    std::vector<uint8_t> data(std::min(file.get_length(), maxFileBytes));
+
+    if(!file.is_open() || file.read(0, data.size(), reinterpret_cast<char *>(data.data())) != int32_t(data.size()))
+    {
+        addLine("  failed to read");
+        return;
+    }
+
+    KernelList kernels;
+    auto ext = getExtension(filename);
+
+    if(ext == ".mp3")
+        captureMP3Kernels(data.data(), data.size(), maxCases, kernels);
+    else
+        captureVorbisKernels(data.data(), data.size(), maxCases, kernels);
+
+    data.clear();
+    data.shrink_to_fit();
+
+    if(kernels.empty())
+        addLine("  nothing captured");
+
+    BenchConfig config;
+    config.timedPasses = 20;
+
+    for(auto &kernel : kernels)
+    {
+        auto result = runKernel(*kernel, config);
+
+        char buf[100];
+        snprintf(buf, sizeof(buf), "  %-22.22s %8" PRIu32 " cyc %8.1f us", result.name, result.medianCycles, result.medianNs / 1000.0);
+        addLine(buf);
+    }
+}
+
+void init()
+{
+    blit::set_screen_mode(blit::ScreenMode::hires);
+
+    for(auto &info : blit::list_files("/bench"))
+    {
+        auto ext = getExtension(info.name);
+        if(ext == ".mp3" || ext == ".ogg" || ext == ".oga")
+            files.push_back("/bench/" + info.name);
+    }
+
+    std::sort(files.begin(), files.end());
+
+    if(files.empty())
+        addLine("put some .mp3/.ogg files in /bench");
+}
+
+// one file per update, so that there's something on screen while the rest run
+void update(uint32_t time)
+{
+    if(nextFile < files.size())
+        benchFile(files[nextFile++]);
+}
+
+void render(uint32_t time)
+{
+    blit::screen.pen = blit::Pen(20, 30, 40);
+    blit::screen.clear();
+
+    blit::screen.pen = blit::Pen(255, 255, 255);
+
+    const int lineHeight = 10;
+    int maxLines = blit::screen.bounds.h / lineHeight;
+    int first = std::max(0, int(lines.size()) - maxLines);
+
+    for(int i = first; i < int(lines.size()); i++)
+        blit::screen.text(lines[i], blit::minimal_font, blit::Point(2, (i - first) * lineHeight + 1), false);
+
+    if(nextFile < files.size())
+        blit::screen.text("Running...", blit::minimal_font, blit::Point(blit::screen.bounds.w - 2, blit::screen.bounds.h - 10), true, blit::TextAlign::top_right);
+}
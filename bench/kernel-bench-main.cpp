@@ -0,0 +1,215 @@
+// host front end for the kernel microbenchmarks
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "kernel-bench.hpp"
+
+struct FileResult
+{
+    std::string filename;
+    std::vector<KernelResult> kernels;
+};
+
+static std::string getExtension(const std::string &filename)
+{
+    auto dot = filename.find_last_of('.');
+    if(dot == std::string::npos)
+        return "";
+
+    auto ext = filename.substr(dot);
+    std::for_each(ext.begin(), ext.end(), [](char &c) {c = tolower(c);});
+    return ext;
+}
+
+static bool isMP3(const std::string &filename)
+{
+    return getExtension(filename) == ".mp3";
+}
+
+static bool isVorbis(const std::string &filename)
+{
+    auto ext = getExtension(filename);
+    return ext == ".ogg" || ext == ".oga";
+}
+
+static bool readFile(const std::string &filename, std::vector<uint8_t> &data)
+{
+    auto fh = fopen(filename.c_str(), "rb");
+    if(!fh)
+        return false;
+
+    fseek(fh, 0, SEEK_END);
+    data.resize(ftell(fh));
+    fseek(fh, 0, SEEK_SET);
+
+    bool ok = fread(data.data(), 1, data.size(), fh) == data.size();
+    fclose(fh);
+
+    return ok;
+}
+
+static void printTable(const std::vector<FileResult> &results)
+{
+    for(auto &file : results)
+    {
+        printf("%s\n", file.filename.c_str());
+
+        if(file.kernels.empty())
+        {
+            printf("  nothing captured\n\n");
+            continue;
+        }
+
+        printf("  %-38s %6s %8s %10s %10s %10s %10s\n", "kernel", "cases", "calls", "min ns", "median ns", "mean ns", "stddev ns");
+
+        for(auto &kernel : file.kernels)
+        {
+            printf("  %-38s %6i %8i %10.1f %10.1f %10.1f %10.1f\n", kernel.name, kernel.cases, kernel.calls,
+                kernel.minNs, kernel.medianNs, kernel.meanNs, kernel.stddevNs);
+        }
+
+        printf("\n");
+    }
+}
+
+static void writeJSON(FILE *out, const std::vector<FileResult> &results, const BenchConfig &config)
+{
+    fprintf(out, "{\n  \"warmupPasses\": %i,\n  \"timedPasses\": %i,\n  \"files\": [\n", config.warmupPasses, config.timedPasses);
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        auto &file = results[i];
+
+        std::string name;
+        for(auto c : file.filename)
+        {
+            if(c == '"' || c == '\\')
+                name += '\\';
+            name += c;
+        }
+
+        fprintf(out, "    {\"file\": \"%s\", \"kernels\": [", name.c_str());
+
+        for(size_t j = 0; j < file.kernels.size(); j++)
+        {
+            auto &kernel = file.kernels[j];
+            fprintf(out, "\n      {\"name\": \"%s\", \"cases\": %i, \"calls\": %i, \"minNs\": %.1f, \"medianNs\": %.1f, \"meanNs\": %.1f, \"stddevNs\": %.1f}%s",
+                kernel.name, kernel.cases, kernel.calls, kernel.minNs, kernel.medianNs, kernel.meanNs, kernel.stddevNs,
+                j + 1 < file.kernels.size() ? "," : "\n    ");
+        }
+
+        fprintf(out, "]}%s\n", i + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> files;
+    const char *jsonPath = nullptr;
+    const char *kernelFilter = nullptr;
+    int maxCases = 256;
+    BenchConfig config;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if(strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+            kernelFilter = argv[++i];
+        else if(strcmp(argv[i], "--cases") == 0 && i + 1 < argc)
+            maxCases = std::max(1, atoi(argv[++i]));
+        else if(strcmp(argv[i], "--passes") == 0 && i + 1 < argc)
+            config.timedPasses = std::max(1, atoi(argv[++i]));
+        else if(strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            config.warmupPasses = std::max(0, atoi(argv[++i]));
+        else if(argv[i][0] == '-')
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+        else if(std::filesystem::is_directory(argv[i]))
+        {
+            for(auto &entry : std::filesystem::recursive_directory_iterator(argv[i]))
+            {
+                auto path = entry.path().string();
+                if(entry.is_regular_file() && (isMP3(path) || isVorbis(path)))
+                    files.push_back(path);
+            }
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    if(files.empty())
+    {
+        fprintf(stderr, "usage: %s [options] <file or directory>...\n", argv[0]);
+        fprintf(stderr, "  --kernel name  only run kernels with names starting with name\n");
+        fprintf(stderr, "  --cases n      capture at most n calls per kernel (default %i)\n", maxCases);
+        fprintf(stderr, "  --passes n     timed passes over the captured calls (default %i)\n", config.timedPasses);
+        fprintf(stderr, "  --warmup n     untimed passes first (default %i)\n", config.warmupPasses);
+        fprintf(stderr, "  --json file    write results as JSON, - for stdout (replaces the table)\n");
+        return 1;
+    }
+
+    std::sort(files.begin(), files.end());
+
+    std::vector<FileResult> results;
+
+    for(auto &filename : files)
+    {
+        FileResult result;
+        result.filename = filename;
+
+        std::vector<uint8_t> data;
+        if(!readFile(filename, data))
+        {
+            fprintf(stderr, "failed to read %s\n", filename.c_str());
+            continue;
+        }
+
+        KernelList kernels;
+
+        if(isMP3(filename))
+            captureMP3Kernels(data.data(), data.size(), maxCases, kernels);
+        else if(isVorbis(filename))
+            captureVorbisKernels(data.data(), data.size(), maxCases, kernels);
+
+        for(auto &kernel : kernels)
+        {
+            if(kernelFilter && strncmp(kernel->getName(), kernelFilter, strlen(kernelFilter)) != 0)
+                continue;
+
+            result.kernels.push_back(runKernel(*kernel, config));
+        }
+
+        results.push_back(std::move(result));
+    }
+
+    bool jsonToStdout = jsonPath && strcmp(jsonPath, "-") == 0;
+
+    if(!jsonToStdout)
+        printTable(results);
+
+    if(jsonToStdout)
+        writeJSON(stdout, results, config);
+    else if(jsonPath)
+    {
+        auto out = fopen(jsonPath, "w");
+        if(!out)
+        {
+            fprintf(stderr, "failed to open %s\n", jsonPath);
+            return 1;
+        }
+
+        writeJSON(out, results, config);
+        fclose(out);
+    }
+
+    return 0;
+}
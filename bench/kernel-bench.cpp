@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "kernel-bench.hpp"
+
+#ifdef TARGET_32BLIT_HW
+// DWT cycle counter, not exposed by the blit API so poke the registers directly
+static volatile uint32_t &demcr = *reinterpret_cast<volatile uint32_t *>(0xE000EDFC);
+static volatile uint32_t &dwtCtrl = *reinterpret_cast<volatile uint32_t *>(0xE0001000);
+static volatile uint32_t &dwtCycCnt = *reinterpret_cast<volatile uint32_t *>(0xE0001004);
+static volatile uint32_t &dwtLockAccess = *reinterpret_cast<volatile uint32_t *>(0xE0001FB0);
+
+static const double cpuFreq = 480000000.0;
+
+using Ticks = uint32_t;
+
+static void initTimer()
+{
+    demcr |= 1 << 24; // TRCENA
+    dwtLockAccess = 0xC5ACCE55;
+    dwtCycCnt = 0;
+    dwtCtrl |= 1; // CYCCNTENA
+}
+
+static inline Ticks readTimer()
+{
+    return dwtCycCnt;
+}
+
+static double ticksToNs(double ticks)
+{
+    return ticks * 1e9 / cpuFreq;
+}
+
+bool hasCycleCounter()
+{
+    return true;
+}
+#else
+#include <chrono>
+
+using Ticks = uint64_t;
+
+static void initTimer()
+{
+}
+
+static inline Ticks readTimer()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double ticksToNs(double ticks)
+{
+    return ticks;
+}
+
+bool hasCycleCounter()
+{
+    return false;
+}
+#endif
+
+// the cost of reading the timer twice, subtracted from every sample
+static Ticks measureOverhead()
+{
+    Ticks overhead = ~Ticks(0);
+
+    for(int i = 0; i < 256; i++)
+    {
+        auto start = readTimer();
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        auto end = readTimer();
+        overhead = std::min(overhead, Ticks(end - start));
+    }
+
+    return overhead;
+}
+
+KernelResult runKernel(BenchKernel &kernel, const BenchConfig &config)
+{
+    KernelResult result;
+    result.name = kernel.getName();
+    result.cases = kernel.getNumCases();
+
+    if(!result.cases)
+        return result;
+
+    initTimer();
+    auto overhead = measureOverhead();
+
+    for(int pass = 0; pass < config.warmupPasses; pass++)
+    {
+        for(int i = 0; i < result.cases; i++)
+        {
+            kernel.prepare(i);
+            kernel.run(i);
+        }
+    }
+
+    std::vector<Ticks> samples;
+    samples.reserve(config.timedPasses * result.cases);
+
+    for(int pass = 0; pass < config.timedPasses; pass++)
+    {
+        for(int i = 0; i < result.cases; i++)
+        {
+            kernel.prepare(i);
+
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            auto start = readTimer();
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+
+            kernel.run(i);
+
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            auto end = readTimer();
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+
+            Ticks time = end - start;
+            samples.push_back(time > overhead ? time - overhead : 0);
+        }
+    }
+
+    result.calls = samples.size();
+
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for(auto sample : samples)
+        sum += sample;
+
+    double mean = sum / samples.size();
+
+    double variance = 0.0;
+    for(auto sample : samples)
+        variance += (sample - mean) * (sample - mean);
+
+    variance /= samples.size();
+
+    auto median = samples[samples.size() / 2];
+
+    result.minNs = ticksToNs(samples[0]);
+    result.medianNs = ticksToNs(median);
+    result.meanNs = ticksToNs(mean);
+    result.stddevNs = ticksToNs(std::sqrt(variance));
+
+    if(hasCycleCounter())
+        result.medianCycles = median;
+
+    return result;
+}
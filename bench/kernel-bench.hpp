@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// microbenchmarks for the minimp3/stb_vorbis hot loops, each kernel is replayed over inputs captured while decoding a real file
+
+class BenchKernel
+{
+public:
+    virtual ~BenchKernel() = default;
+
+    virtual const char *getName() const = 0;
+    virtual int getNumCases() const = 0;
+
+    // restores the inputs for a case, not timed
+    // cases are always run in order, so a case may depend on the state left by the previous one
+    virtual void prepare(int index) = 0;
+    // the timed call
+    virtual void run(int index) = 0;
+};
+
+using KernelList = std::vector<std::unique_ptr<BenchKernel>>;
+
+struct BenchConfig
+{
+    int warmupPasses = 2;
+    int timedPasses = 50;
+};
+
+struct KernelResult
+{
+    const char *name = nullptr;
+    int cases = 0, calls = 0;
+
+    double minNs = 0.0, medianNs = 0.0, meanNs = 0.0, stddevNs = 0.0;
+    uint32_t medianCycles = 0; // only with a cycle counter
+};
+
+bool hasCycleCounter();
+
+KernelResult runKernel(BenchKernel &kernel, const BenchConfig &config);
+
+// adds a kernel for each hot loop the file reached, at most maxCases captured calls each
+void captureMP3Kernels(const uint8_t *data, uint32_t length, int maxCases, KernelList &kernels);
+void captureVorbisKernels(const uint8_t *data, uint32_t length, int maxCases, KernelList &kernels);
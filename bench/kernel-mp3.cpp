@@ -0,0 +1,278 @@
+// captures the inputs to the minimp3 layer 3 kernels by repeating the steps of mp3dec_decode_frame/L3_decode
+#include <cstring>
+
+#include "kernel-bench.hpp"
+
+#define MINIMP3_IMPLEMENTATION
+#define MINIMP3_ONLY_MP3
+#include "minimp3.h"
+
+// same as the long/stop windows in L3_imdct_gr
+static const float mdctWindow[2][18] = {
+    { 0.99904822f,0.99144486f,0.97629601f,0.95371695f,0.92387953f,0.88701083f,0.84339145f,0.79335334f,0.73727734f,0.04361938f,0.13052619f,0.21643961f,0.30070580f,0.38268343f,0.46174861f,0.53729961f,0.60876143f,0.67559021f },
+    { 1,1,1,1,1,1,0.99144486f,0.92387953f,0.79335334f,0,0,0,0,0,0,0.13052619f,0.38268343f,0.60876143f }
+};
+
+class HuffmanKernel final : public BenchKernel
+{
+public:
+    struct Case
+    {
+        std::vector<uint8_t> data;
+        int pos, limit, layer3grLimit;
+        L3_gr_info_t grInfo;
+        float scf[40];
+    };
+
+    const char *getName() const override {return "L3_huffman";}
+    int getNumCases() const override {return cases.size();}
+
+    void prepare(int index) override
+    {
+        auto &c = cases[index];
+        bs.buf = c.data.data();
+        bs.pos = c.pos;
+        bs.limit = c.limit;
+        memset(grbuf, 0, sizeof(grbuf));
+    }
+
+    void run(int index) override
+    {
+        auto &c = cases[index];
+        L3_huffman(grbuf, &bs, &c.grInfo, c.scf, c.layer3grLimit);
+    }
+
+    void capture(const bs_t &bsIn, const L3_gr_info_t &grInfo, const float *scf, int layer3grLimit)
+    {
+        Case c;
+        c.data.assign(bsIn.buf, bsIn.buf + (bsIn.limit + 7) / 8);
+        c.pos = bsIn.pos;
+        c.limit = bsIn.limit;
+        c.layer3grLimit = layer3grLimit;
+        c.grInfo = grInfo;
+        memcpy(c.scf, scf, sizeof(c.scf));
+
+        cases.push_back(std::move(c));
+    }
+
+    std::vector<Case> cases;
+
+private:
+    bs_t bs;
+    float grbuf[576];
+};
+
+// only pure long block granules, short blocks go through L3_imdct_short
+class IMDCT36Kernel final : public BenchKernel
+{
+public:
+    struct Case
+    {
+        float grbuf[576];
+        float overlap[9 * 32];
+        bool stop;
+    };
+
+    const char *getName() const override {return "L3_imdct36";}
+    int getNumCases() const override {return cases.size();}
+
+    void prepare(int index) override
+    {
+        auto &c = cases[index];
+        memcpy(grbuf, c.grbuf, sizeof(grbuf));
+        memcpy(overlap, c.overlap, sizeof(overlap));
+    }
+
+    void run(int index) override
+    {
+        L3_imdct36(grbuf, overlap, mdctWindow[cases[index].stop], 32);
+    }
+
+    void capture(const float *grbufIn, const float *overlapIn, bool stop)
+    {
+        Case c;
+        memcpy(c.grbuf, grbufIn, sizeof(c.grbuf));
+        memcpy(c.overlap, overlapIn, sizeof(c.overlap));
+        c.stop = stop;
+
+        cases.push_back(c);
+    }
+
+    std::vector<Case> cases;
+
+private:
+    float grbuf[576], overlap[9 * 32];
+};
+
+// each granule is nine calls, the first call of a granule restores the DCT output/history
+class SynthKernel final : public BenchKernel
+{
+public:
+    struct Granule
+    {
+        float grbuf[576 * 2];
+        float qmfState[15 * 64];
+        int channels;
+    };
+
+    const char *getName() const override {return "mp3d_synth";}
+    int getNumCases() const override {return granules.size() * callsPerGranule;}
+
+    void prepare(int index) override
+    {
+        if(index % callsPerGranule)
+            return;
+
+        auto &g = granules[index / callsPerGranule];
+        memcpy(grbuf, g.grbuf, sizeof(grbuf));
+
+        for(int i = 0; i < g.channels; i++)
+            mp3d_DCT_II(grbuf + 576 * i, 18);
+
+        memcpy(lins, g.qmfState, sizeof(g.qmfState));
+    }
+
+    void run(int index) override
+    {
+        auto &g = granules[index / callsPerGranule];
+        int i = (index % callsPerGranule) * 2;
+        mp3d_synth(grbuf + i, pcm + 32 * g.channels * i, g.channels, lins + i * 64);
+    }
+
+    void capture(const float *qmfState, const float *grbufIn, int channels)
+    {
+        Granule g;
+        memcpy(g.grbuf, grbufIn, sizeof(float) * 576 * channels);
+        memcpy(g.qmfState, qmfState, sizeof(g.qmfState));
+        g.channels = channels;
+
+        granules.push_back(g);
+    }
+
+    std::vector<Granule> granules;
+
+private:
+    static const int callsPerGranule = 9;
+
+    float grbuf[576 * 2];
+    float lins[(18 + 15) * 64];
+    mp3d_sample_t pcm[576 * 2];
+};
+
+// L3_decode with the kernel inputs captured along the way
+static void decodeGranule(mp3dec_t *h, mp3dec_scratch_t *s, L3_gr_info_t *gr_info, int nch, int maxCases, HuffmanKernel &huffman, IMDCT36Kernel &imdct)
+{
+    for(int ch = 0; ch < nch; ch++)
+    {
+        int layer3gr_limit = s->bs.pos + gr_info[ch].part_23_length;
+        L3_decode_scalefactors(h->header, s->ist_pos[ch], &s->bs, gr_info + ch, s->scf, ch);
+
+        if(huffman.getNumCases() < maxCases)
+            huffman.capture(s->bs, gr_info[ch], s->scf, layer3gr_limit);
+
+        L3_huffman(s->grbuf[ch], &s->bs, gr_info + ch, s->scf, layer3gr_limit);
+    }
+
+    if(HDR_TEST_I_STEREO(h->header))
+        L3_intensity_stereo(s->grbuf[0], s->ist_pos[1], gr_info, h->header);
+    else if(HDR_IS_MS_STEREO(h->header))
+        L3_midside_stereo(s->grbuf[0], 576);
+
+    for(int ch = 0; ch < nch; ch++, gr_info++)
+    {
+        int aa_bands = 31;
+        int n_long_bands = (gr_info->mixed_block_flag ? 2 : 0) << (int)(HDR_GET_MY_SAMPLE_RATE(h->header) == 2);
+
+        if(gr_info->n_short_sfb)
+        {
+            aa_bands = n_long_bands - 1;
+            L3_reorder(s->grbuf[ch] + n_long_bands * 18, s->syn[0], gr_info->sfbtab + gr_info->n_long_sfb);
+        }
+
+        L3_antialias(s->grbuf[ch], aa_bands);
+
+        if(gr_info->block_type != SHORT_BLOCK_TYPE && !n_long_bands && imdct.getNumCases() < maxCases)
+            imdct.capture(s->grbuf[ch], h->mdct_overlap[ch], gr_info->block_type == STOP_BLOCK_TYPE);
+
+        L3_imdct_gr(s->grbuf[ch], h->mdct_overlap[ch], gr_info->block_type, n_long_bands);
+        L3_change_sign(s->grbuf[ch]);
+    }
+}
+
+void captureMP3Kernels(const uint8_t *data, uint32_t length, int maxCases, KernelList &kernels)
+{
+    auto huffman = std::make_unique<HuffmanKernel>();
+    auto imdct = std::make_unique<IMDCT36Kernel>();
+    auto synth = std::make_unique<SynthKernel>();
+
+    uint32_t offset = 0;
+
+    // skip ID3v2, the frame sync search gives up on large tags
+    if(length > 10 && memcmp(data, "ID3", 3) == 0)
+        offset = 10 + ((data[6] & 0x7F) << 21 | (data[7] & 0x7F) << 14 | (data[8] & 0x7F) << 7 | (data[9] & 0x7F));
+
+    mp3dec_t dec;
+    mp3dec_init(&dec);
+
+    auto scratch = std::make_unique<mp3dec_scratch_t>();
+    auto s = scratch.get();
+    mp3d_sample_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+
+    while(offset < length && (huffman->getNumCases() < maxCases || imdct->getNumCases() < maxCases || int(synth->granules.size()) < maxCases))
+    {
+        // header only
+        mp3dec_frame_info_t info;
+        int samples = mp3dec_decode_frame(&dec, data + offset, length - offset, nullptr, &info);
+
+        if(!info.frame_bytes)
+            break;
+
+        if(!samples || info.layer != 3)
+        {
+            offset += info.frame_bytes;
+            continue;
+        }
+
+        auto hdr = data + offset + info.frame_offset;
+        int frameSize = info.frame_bytes - info.frame_offset;
+        offset += info.frame_bytes;
+
+        bs_t bsFrame;
+        bs_init(&bsFrame, hdr + HDR_SIZE, frameSize - HDR_SIZE);
+
+        if(HDR_IS_CRC(hdr))
+            get_bits(&bsFrame, 16);
+
+        int mainDataBegin = L3_read_side_info(&bsFrame, s->gr_info, hdr);
+        if(mainDataBegin < 0 || bsFrame.pos > bsFrame.limit)
+        {
+            mp3dec_init(&dec);
+            continue;
+        }
+
+        if(L3_restore_reservoir(&dec, &bsFrame, s, mainDataBegin))
+        {
+            for(int igr = 0; igr < (HDR_TEST_MPEG1(hdr) ? 2 : 1); igr++)
+            {
+                memset(s->grbuf[0], 0, sizeof(s->grbuf));
+                decodeGranule(&dec, s, s->gr_info + igr * info.channels, info.channels, maxCases, *huffman, *imdct);
+
+                if(int(synth->granules.size()) < maxCases)
+                    synth->capture(dec.qmf_state, s->grbuf[0], info.channels);
+
+                mp3d_synth_granule(dec.qmf_state, s->grbuf[0], 18, info.channels, pcm, s->syn[0]);
+            }
+        }
+
+        L3_save_reservoir(&dec, s);
+    }
+
+    if(huffman->getNumCases())
+        kernels.push_back(std::move(huffman));
+
+    if(imdct->getNumCases())
+        kernels.push_back(std::move(imdct));
+
+    if(synth->getNumCases())
+        kernels.push_back(std::move(synth));
+}
@@ -0,0 +1,218 @@
+// captures the inputs to the stb_vorbis residue/IMDCT kernels while decoding from memory
+#include <cstring>
+
+#include "kernel-bench.hpp"
+
+// both kernels are static and there are no hooks, so the calls are redirected to the capturing overloads below by appending a tag argument
+// (the tag turns into an unused function pointer parameter on the real definitions)
+struct stb_vorbis;
+struct CaptureTag {};
+
+static int codebook_decode_deinterleave_repeat(stb_vorbis *f, void *c, float **outputs, int ch, int *c_inter_p, int *p_inter_p, int len, int total_decode, CaptureTag);
+static void inverse_mdct(float *buffer, int n, stb_vorbis *f, int blocktype, CaptureTag);
+
+#define codebook_decode_deinterleave_repeat(...) codebook_decode_deinterleave_repeat(__VA_ARGS__, CaptureTag())
+#define inverse_mdct(...) inverse_mdct(__VA_ARGS__, CaptureTag())
+
+#define STB_VORBIS_NO_PUSHDATA_API
+#define STB_VORBIS_NO_STDIO
+#include "stb_vorbis.c"
+
+#undef codebook_decode_deinterleave_repeat
+#undef inverse_mdct
+
+// keeps the decoder (codebooks, MDCT tables) and the data it's reading alive while the kernels exist
+struct VorbisSource
+{
+    ~VorbisSource()
+    {
+        if(vorbis)
+            stb_vorbis_close(vorbis);
+    }
+
+    std::vector<uint8_t> data;
+    stb_vorbis *vorbis = nullptr;
+};
+
+// the decoder state is copied so that the bit reader can be rewound
+class CodebookKernel final : public BenchKernel
+{
+public:
+    struct Case
+    {
+        stb_vorbis state;
+        Codebook *codebook;
+        bool hasOutput[2];
+        int channels, cInter, pInter, len, totalDecode;
+    };
+
+    CodebookKernel(std::shared_ptr<VorbisSource> source) : source(source) {}
+
+    const char *getName() const override {return "codebook_decode_deinterleave_repeat";}
+    int getNumCases() const override {return cases.size();}
+
+    void prepare(int index) override
+    {
+        auto &c = cases[index];
+        memcpy(&state, &c.state, sizeof(state));
+        cInter = c.cInter;
+        pInter = c.pInter;
+
+        for(int i = 0; i < c.channels; i++)
+            outputs[i] = c.hasOutput[i] ? outputBuffers[i].data() : nullptr;
+    }
+
+    void run(int index) override
+    {
+        auto &c = cases[index];
+        codebook_decode_deinterleave_repeat(&state, c.codebook, outputs, c.channels, &cInter, &pInter, c.len, c.totalDecode, nullptr);
+    }
+
+    void capture(stb_vorbis *f, Codebook *codebook, float **outputsIn, int channels, int cInterIn, int pInterIn, int len, int totalDecode)
+    {
+        // the file would have to be more than stereo to get here with more channels
+        if(channels > 2)
+            return;
+
+        Case c;
+        memcpy(&c.state, f, sizeof(c.state));
+        c.codebook = codebook;
+        c.channels = channels;
+        c.cInter = cInterIn;
+        c.pInter = pInterIn;
+        c.len = len;
+        c.totalDecode = totalDecode;
+
+        for(int i = 0; i < channels; i++)
+        {
+            c.hasOutput[i] = outputsIn[i] != nullptr;
+            if(int(outputBuffers[i].size()) < len)
+                outputBuffers[i].resize(len);
+        }
+
+        cases.push_back(c);
+    }
+
+    std::vector<Case> cases;
+
+private:
+    std::shared_ptr<VorbisSource> source;
+
+    stb_vorbis state;
+    int cInter, pInter;
+    float *outputs[2];
+    std::vector<float> outputBuffers[2];
+};
+
+// long and short blocks are separate kernels as the sizes are so different
+class IMDCTKernel final : public BenchKernel
+{
+public:
+    struct Case
+    {
+        std::vector<float> buffer;
+    };
+
+    IMDCTKernel(std::shared_ptr<VorbisSource> source, int blockType) : source(source), blockType(blockType) {}
+
+    const char *getName() const override {return blockType ? "inverse_mdct (long)" : "inverse_mdct (short)";}
+    int getNumCases() const override {return cases.size();}
+
+    void prepare(int index) override
+    {
+        auto &c = cases[index];
+        std::copy(c.buffer.begin(), c.buffer.end(), buffer.begin());
+    }
+
+    void run(int index) override
+    {
+        inverse_mdct(buffer.data(), cases[index].buffer.size() * 2, source->vorbis, blockType, nullptr);
+    }
+
+    void capture(const float *bufferIn, int n)
+    {
+        // only the first half is input
+        Case c;
+        c.buffer.assign(bufferIn, bufferIn + n / 2);
+
+        if(int(buffer.size()) < n)
+            buffer.resize(n);
+
+        cases.push_back(std::move(c));
+    }
+
+    std::vector<Case> cases;
+
+private:
+    std::shared_ptr<VorbisSource> source;
+    int blockType;
+
+    std::vector<float> buffer;
+};
+
+static int maxCaptureCases = 0;
+static CodebookKernel *codebookCapture = nullptr;
+static IMDCTKernel *imdctCapture[2]{};
+
+static int codebook_decode_deinterleave_repeat(stb_vorbis *f, void *c, float **outputs, int ch, int *c_inter_p, int *p_inter_p, int len, int total_decode, CaptureTag)
+{
+    auto codebook = static_cast<Codebook *>(c);
+
+    if(codebookCapture && codebookCapture->getNumCases() < maxCaptureCases)
+        codebookCapture->capture(f, codebook, outputs, ch, *c_inter_p, *p_inter_p, len, total_decode);
+
+    return codebook_decode_deinterleave_repeat(f, codebook, outputs, ch, c_inter_p, p_inter_p, len, total_decode, nullptr);
+}
+
+static void inverse_mdct(float *buffer, int n, stb_vorbis *f, int blocktype, CaptureTag)
+{
+    auto kernel = imdctCapture[blocktype];
+
+    if(kernel && kernel->getNumCases() < maxCaptureCases)
+        kernel->capture(buffer, n);
+
+    inverse_mdct(buffer, n, f, blocktype, nullptr);
+}
+
+void captureVorbisKernels(const uint8_t *data, uint32_t length, int maxCases, KernelList &kernels)
+{
+    auto source = std::make_shared<VorbisSource>();
+    source->data.assign(data, data + length);
+
+    int err;
+    source->vorbis = stb_vorbis_open_memory(source->data.data(), length, &err, nullptr);
+
+    if(!source->vorbis)
+        return;
+
+    auto codebook = std::make_unique<CodebookKernel>(source);
+    auto imdctShort = std::make_unique<IMDCTKernel>(source, 0);
+    auto imdctLong = std::make_unique<IMDCTKernel>(source, 1);
+
+    maxCaptureCases = maxCases;
+    codebookCapture = codebook.get();
+    imdctCapture[0] = imdctShort.get();
+    imdctCapture[1] = imdctLong.get();
+
+    int channels;
+    float **output;
+
+    while(codebook->getNumCases() < maxCases || imdctShort->getNumCases() < maxCases || imdctLong->getNumCases() < maxCases)
+    {
+        if(!stb_vorbis_get_frame_float(source->vorbis, &channels, &output))
+            break;
+    }
+
+    codebookCapture = nullptr;
+    imdctCapture[0] = imdctCapture[1] = nullptr;
+
+    // mono streams don't use the deinterleaving path
+    if(codebook->getNumCases())
+        kernels.push_back(std::move(codebook));
+
+    if(imdctLong->getNumCases())
+        kernels.push_back(std::move(imdctLong));
+
+    if(imdctShort->getNumCases())
+        kernels.push_back(std::move(imdctShort));
+}
@@ -0,0 +1,518 @@
+// plays files in virtual time, calling the audio callback exactly every 64 samples at 22050Hz and update() on a simulated frame schedule
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "audio/audio.hpp"
+#include "engine/engine.hpp"
+
+#include "fault-file.hpp"
+#include "stream-pipeline.hpp"
+
+// the main loop of the blit engine: updates at a fixed rate, caught up before each render
+struct Schedule
+{
+    double updateMs = 10.0;
+    double frameMs = 1000.0 / 60.0;
+    double jitterMs = 0.0;
+
+    // every nth frame takes heavyMs instead
+    int heavyEvery = 0;
+    double heavyMs = 0.0;
+
+    // every nth frame is followed by dropCount missed frames
+    int dropEvery = 0;
+    int dropCount = 0;
+
+    // how long update() takes, as a multiple of the time measured on the host
+    double cpuScale = 0.0;
+
+    unsigned int seed = 1;
+};
+
+class Histogram
+{
+public:
+    Histogram(double bucketSize, int numBuckets) : bucketSize(bucketSize), buckets(numBuckets) {}
+
+    void add(double value)
+    {
+        int bucket = std::min(static_cast<int>(value / bucketSize), static_cast<int>(buckets.size()) - 1);
+        buckets[std::max(bucket, 0)]++;
+        total++;
+    }
+
+    void print(const char *label) const
+    {
+        printf("  %s:\n", label);
+
+        if(!total)
+            return;
+
+        uint64_t maxCount = *std::max_element(buckets.begin(), buckets.end());
+
+        for(size_t i = 0; i < buckets.size(); i++)
+        {
+            if(!buckets[i])
+                continue;
+
+            bool last = i == buckets.size() - 1;
+            int barLen = static_cast<int>(buckets[i] * 40 / maxCount);
+
+            if(last)
+                printf("    %6.1f+        ", i * bucketSize);
+            else
+                printf("    %6.1f - %6.1f", i * bucketSize, (i + 1) * bucketSize);
+
+            printf(" %9llu %5.1f%% ", static_cast<unsigned long long>(buckets[i]), buckets[i] * 100.0 / total);
+
+            for(int j = 0; j < barLen; j++)
+                putchar('#');
+
+            putchar('\n');
+        }
+    }
+
+private:
+    double bucketSize;
+    std::vector<uint64_t> buckets;
+    uint64_t total = 0;
+};
+
+struct SimResult
+{
+    bool loaded = false;
+
+    double audioMs = 0.0;
+    int callbacks = 0, updates = 0, frames = 0;
+
+    int underruns = 0;
+    int underrunEvents = 0; // consecutive underrun callbacks count once
+
+    int minHeadroom = -1; // samples
+    double maxUpdateGapMs = 0.0;
+
+    double durationMs = 0.0;
+    bool endedEarly = false; // stopped before the duration, without --seconds cutting it short
+    double startMs = 0.0; // play() until the first sample can be output
+
+    QualityMode quality = QualityMode::Full; // at the end
+
+    // with the fault injecting backend
+    double loadReadLatencyMs = 0.0; // before playback starts
+    int reads = 0, shortReads = 0, readErrors = 0;
+    double maxReadLatencyUs = 0.0, totalReadLatencyMs = 0.0;
+
+    Histogram headroom{25.0, 20}; // ms
+    Histogram updateGap{5.0, 20}; // ms
+};
+
+static const double sampleRate = 22050.0;
+static const int callbackSamples = 64;
+
+static FaultFileBackend *faultBackend = nullptr;
+
+static double samplesToMs(double samples)
+{
+    return samples * 1000.0 / sampleRate;
+}
+
+static bool parseQualityMode(const char *name, QualityMode &mode)
+{
+    static const char *names[]{"full", "mono", "half", "cheap", "auto"};
+
+    for(int i = 0; i <= int(QualityMode::Auto); i++)
+    {
+        if(strcmp(name, names[i]) == 0)
+        {
+            mode = QualityMode(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static StreamPipeline pipeline;
+
+static SimResult simulate(const std::string &filename, const Schedule &schedule, double maxSeconds)
+{
+    SimResult result;
+
+    if(faultBackend)
+    {
+        faultBackend->clearReads();
+        faultBackend->setTime(0.0);
+        faultBackend->takeLatencyUs();
+    }
+
+    if(!pipeline.load(filename))
+        return result;
+
+    auto stream = &pipeline;
+
+    result.loaded = true;
+
+    // near the end the decoder runs out and the headroom drains naturally, don't count that
+    int totalSamples = static_cast<int64_t>(stream->getDurationMs()) * 22050 / 1000;
+    const int tailSamples = 1152 * 8;
+
+    result.durationMs = stream->getDurationMs();
+
+    auto &channel = blit::channels[0];
+
+    auto playStart = std::chrono::steady_clock::now();
+    stream->play(0);
+    result.startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - playStart).count() * std::max(schedule.cpuScale, 1.0);
+
+    // reads for loading and the initial decode happen before the clock starts
+    if(faultBackend)
+        result.loadReadLatencyMs = faultBackend->takeLatencyUs() / 1000.0;
+
+    std::mt19937 rng(schedule.seed);
+    std::uniform_real_distribution<double> jitter(-schedule.jitterMs, schedule.jitterMs);
+
+    double loopTimeMs = 0.0, nextUpdateMs = 0.0, lastUpdateMs = 0.0;
+    uint64_t callbackIndex = 0;
+    bool inUnderrun = false;
+
+    // runs every callback due up to time
+    auto runCallbacks = [&](double timeMs)
+    {
+        while(channel.adsr_phase != blit::ADSRPhase::OFF && samplesToMs(callbackIndex * callbackSamples) <= timeMs)
+        {
+            int bufferedBefore = stream->getBufferedSamples();
+
+            channel.wave_buffer_callback(channel);
+            callbackIndex++;
+            result.callbacks++;
+
+            // the stream turns the channel off at the end
+            if(channel.adsr_phase == blit::ADSRPhase::OFF)
+                break;
+
+            // same as the sink's count: less than a whole callback buffered and nothing played
+            // (the last partial block of the track is still played)
+            bool empty = bufferedBefore < callbackSamples && stream->getBufferedSamples() == bufferedBefore;
+
+            if(empty)
+            {
+                result.underruns++;
+                if(!inUnderrun)
+                    result.underrunEvents++;
+            }
+
+            inUnderrun = empty;
+
+            int buffered = stream->getBufferedSamples();
+            if(stream->getCurrentSample() + buffered < totalSamples - tailSamples)
+            {
+                if(result.minHeadroom == -1 || buffered < result.minHeadroom)
+                    result.minHeadroom = buffered;
+
+                result.headroom.add(samplesToMs(buffered));
+            }
+        }
+    };
+
+    bool timeLimited = false;
+
+    for(int frame = 0; channel.adsr_phase != blit::ADSRPhase::OFF; frame++)
+    {
+        if(maxSeconds > 0.0 && loopTimeMs > maxSeconds * 1000.0)
+        {
+            timeLimited = true;
+            break;
+        }
+
+        runCallbacks(loopTimeMs);
+
+        // catch up on updates, the engine only checks the time once per frame
+        double frameStartMs = loopTimeMs;
+
+        while(nextUpdateMs <= frameStartMs)
+        {
+            double gap = loopTimeMs - lastUpdateMs;
+            if(result.updates)
+            {
+                result.updateGap.add(gap);
+                result.maxUpdateGapMs = std::max(result.maxUpdateGapMs, gap);
+            }
+
+            lastUpdateMs = loopTimeMs;
+
+            if(faultBackend)
+                faultBackend->setTime(loopTimeMs);
+
+            auto start = std::chrono::steady_clock::now();
+            stream->update();
+            auto end = std::chrono::steady_clock::now();
+
+            result.updates++;
+            nextUpdateMs += schedule.updateMs;
+
+            double updateMs = std::chrono::duration<double, std::milli>(end - start).count() * schedule.cpuScale;
+
+            if(faultBackend)
+                updateMs += faultBackend->takeLatencyUs() / 1000.0;
+
+            // callbacks that would have happened during the update run after it,
+            // so they see the decoded data slightly early
+            if(updateMs > 0.0)
+            {
+                loopTimeMs += updateMs;
+                runCallbacks(loopTimeMs);
+            }
+        }
+
+        // render
+        double frameMs = schedule.frameMs;
+
+        if(schedule.heavyEvery && frame % schedule.heavyEvery == schedule.heavyEvery - 1)
+            frameMs = schedule.heavyMs;
+
+        if(schedule.dropEvery && frame % schedule.dropEvery == schedule.dropEvery - 1)
+            frameMs += schedule.frameMs * schedule.dropCount;
+
+        if(schedule.jitterMs > 0.0)
+            frameMs = std::max(0.0, frameMs + jitter(rng));
+
+        loopTimeMs += frameMs;
+        result.frames++;
+    }
+
+    result.audioMs = samplesToMs(static_cast<double>(result.callbacks) * callbackSamples);
+
+    // the last callback can be partly padding
+    result.endedEarly = !timeLimited && result.audioMs + samplesToMs(callbackSamples) < result.durationMs;
+    result.quality = stream->getStats().qualityMode;
+
+    if(faultBackend)
+    {
+        for(auto &read : faultBackend->getReads())
+        {
+            result.reads++;
+
+            if(read.result < 0)
+                result.readErrors++;
+            else if(static_cast<uint32_t>(read.result) < read.length)
+                result.shortReads++; // includes reads at the end of the file
+
+            result.maxReadLatencyUs = std::max(result.maxReadLatencyUs, read.latencyUs);
+            result.totalReadLatencyMs += read.latencyUs / 1000.0;
+        }
+    }
+
+    // stop the stream from being called again
+    channel.off();
+
+    return result;
+}
+
+static void printResult(const std::string &filename, const SimResult &result)
+{
+    printf("%s\n", filename.c_str());
+
+    if(!result.loaded)
+    {
+        printf("  failed to load\n\n");
+        return;
+    }
+
+    printf("  %.1fs audio (%.1fs expected), %i callbacks, %i updates, %i frames\n", result.audioMs / 1000.0, result.durationMs / 1000.0, result.callbacks, result.updates, result.frames);
+
+    if(result.endedEarly)
+        printf("  ENDED EARLY\n");
+    printf("  underruns: %i callbacks (%.1fms) in %i events\n", result.underruns, samplesToMs(result.underruns * callbackSamples), result.underrunEvents);
+
+    if(result.minHeadroom >= 0)
+        printf("  min headroom: %i samples (%.1fms)\n", result.minHeadroom, samplesToMs(result.minHeadroom));
+
+    printf("  start latency: %.2fms\n", result.startMs);
+    printf("  max update gap: %.1fms\n", result.maxUpdateGapMs);
+    printf("  quality at the end: %s\n", getQualityModeName(result.quality));
+
+    if(faultBackend)
+    {
+        printf("  reads: %i, %i short, %i errors, %.1fms total latency (max %.1fms), %.1fms before playback\n", result.reads, result.shortReads, result.readErrors,
+            result.totalReadLatencyMs, result.maxReadLatencyUs / 1000.0, result.loadReadLatencyMs);
+    }
+
+    result.headroom.print("headroom after each callback (ms)");
+    result.updateGap.print("time between updates (ms)");
+    printf("\n");
+}
+
+static bool parseDouble(const char *str, double &out)
+{
+    char *end;
+    out = strtod(str, &end);
+    return end != str && *end == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> files;
+    Schedule schedule;
+    FaultConfig faultConfig;
+    const char *readLogPath = nullptr;
+    double maxSeconds = 0.0;
+    QualityMode quality = QualityMode::Auto;
+    bool ok = true;
+
+    for(int i = 1; i < argc && ok; i++)
+    {
+        double value = 0.0;
+        bool hasValue = i + 1 < argc && parseDouble(argv[i + 1], value);
+
+        if(argv[i][0] != '-')
+        {
+            files.push_back(argv[i]);
+            continue;
+        }
+
+        if(strcmp(argv[i], "--read-log") == 0 && i + 1 < argc)
+        {
+            readLogPath = argv[++i];
+            continue;
+        }
+
+        if(strcmp(argv[i], "--quality") == 0 && i + 1 < argc)
+        {
+            ok = parseQualityMode(argv[++i], quality);
+            continue;
+        }
+
+        if(!hasValue)
+            ok = false;
+        else if(strcmp(argv[i], "--fps") == 0 && value > 0.0)
+            schedule.frameMs = 1000.0 / value;
+        else if(strcmp(argv[i], "--update-ms") == 0 && value > 0.0)
+            schedule.updateMs = value;
+        else if(strcmp(argv[i], "--jitter-ms") == 0)
+            schedule.jitterMs = value;
+        else if(strcmp(argv[i], "--heavy-every") == 0)
+            schedule.heavyEvery = value;
+        else if(strcmp(argv[i], "--heavy-ms") == 0)
+            schedule.heavyMs = value;
+        else if(strcmp(argv[i], "--drop-every") == 0)
+            schedule.dropEvery = value;
+        else if(strcmp(argv[i], "--drop-count") == 0)
+            schedule.dropCount = value;
+        else if(strcmp(argv[i], "--cpu-scale") == 0)
+            schedule.cpuScale = value;
+        else if(strcmp(argv[i], "--read-latency-us") == 0)
+            faultConfig.latencyUs = value;
+        else if(strcmp(argv[i], "--read-us-per-kb") == 0)
+            faultConfig.usPerKB = value;
+        else if(strcmp(argv[i], "--read-tail-chance") == 0)
+            faultConfig.tailChance = value;
+        else if(strcmp(argv[i], "--read-tail-us") == 0 && value > 0.0)
+            faultConfig.tailMeanUs = value;
+        else if(strcmp(argv[i], "--short-read-chance") == 0)
+            faultConfig.shortReadChance = value;
+        else if(strcmp(argv[i], "--read-error-chance") == 0)
+            faultConfig.errorChance = value;
+        else if(strcmp(argv[i], "--seed") == 0)
+            schedule.seed = faultConfig.seed = value;
+        else if(strcmp(argv[i], "--seconds") == 0)
+            maxSeconds = value;
+        else
+            ok = false;
+
+        i++;
+    }
+
+    if(!ok || files.empty())
+    {
+        fprintf(stderr, "usage: %s [options] <file>...\n", argv[0]);
+        fprintf(stderr, "  --fps n          render rate (default 60)\n");
+        fprintf(stderr, "  --update-ms n    fixed update interval (default 10)\n");
+        fprintf(stderr, "  --jitter-ms n    random +/- variation in frame time\n");
+        fprintf(stderr, "  --heavy-every n  every nth frame is a heavy one...\n");
+        fprintf(stderr, "  --heavy-ms n     ...that takes this long\n");
+        fprintf(stderr, "  --drop-every n   every nth frame is followed by...\n");
+        fprintf(stderr, "  --drop-count n   ...this many dropped frames\n");
+        fprintf(stderr, "  --cpu-scale n    update() takes n times as long as it does on this machine (default 0, instant)\n");
+        fprintf(stderr, "  --seed n         seed for the jitter/read faults\n");
+        fprintf(stderr, "  --quality full|mono|half|cheap|auto  decode quality (default auto)\n");
+        fprintf(stderr, "read faults (simulated SD card behaviour):\n");
+        fprintf(stderr, "  --read-latency-us n    latency for every read\n");
+        fprintf(stderr, "  --read-us-per-kb n     transfer time\n");
+        fprintf(stderr, "  --read-tail-chance n   chance (0-1) of a read getting an extra delay...\n");
+        fprintf(stderr, "  --read-tail-us n       ...exponentially distributed with this mean\n");
+        fprintf(stderr, "  --short-read-chance n  chance of a read returning less than requested\n");
+        fprintf(stderr, "  --read-error-chance n  chance of a read failing\n");
+        fprintf(stderr, "  --read-log file        write every read to a CSV file\n");
+        fprintf(stderr, "  --seconds n      stop after this much virtual time\n");
+        fprintf(stderr, "exits with 3 if any file failed to load or ended early, otherwise 2 if any file had underruns\n");
+        return 1;
+    }
+
+    printf("schedule: %.1ffps, update every %.1fms", 1000.0 / schedule.frameMs, schedule.updateMs);
+    if(schedule.jitterMs > 0.0)
+        printf(", +/-%.1fms jitter", schedule.jitterMs);
+    if(schedule.heavyEvery)
+        printf(", every %i frames takes %.1fms", schedule.heavyEvery, schedule.heavyMs);
+    if(schedule.dropEvery)
+        printf(", %i frames dropped every %i", schedule.dropCount, schedule.dropEvery);
+    if(schedule.cpuScale > 0.0)
+        printf(", update cost x%.1f", schedule.cpuScale);
+    printf("\n\n");
+
+    FaultFileBackend backend(faultConfig);
+    FILE *readLog = nullptr;
+
+    if(faultConfig.isEnabled() || readLogPath)
+    {
+        faultBackend = &backend;
+        StreamFile::setBackend(&backend);
+    }
+
+    if(readLogPath)
+    {
+        readLog = fopen(readLogPath, "w");
+        if(!readLog)
+        {
+            fprintf(stderr, "failed to open %s\n", readLogPath);
+            return 1;
+        }
+
+        FaultFileBackend::writeLogHeader(readLog);
+    }
+
+    // decode times measured by the streams should match the simulated ones
+    if(schedule.cpuScale > 0.0)
+        clockScale = schedule.cpuScale;
+
+    pipeline.setQualityMode(quality);
+
+    int totalUnderruns = 0;
+    bool incomplete = false;
+
+    for(auto &file : files)
+    {
+        auto result = simulate(file, schedule, maxSeconds);
+        printResult(file, result);
+        totalUnderruns += result.underruns;
+        incomplete = incomplete || !result.loaded || result.endedEarly;
+
+        if(readLog)
+            backend.writeLog(readLog, file);
+    }
+
+    if(readLog)
+        fclose(readLog);
+
+    StreamFile::setBackend(nullptr);
+
+    if(incomplete)
+        return 3;
+
+    return totalUnderruns ? 2 : 0;
+}
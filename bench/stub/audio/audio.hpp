@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// just enough of blit::AudioChannel for the streams to drive
+
+namespace blit
+{
+    enum Waveform
+    {
+        NOISE = 128,
+        SQUARE = 64,
+        SAW = 32,
+        TRIANGLE = 16,
+        SINE = 8,
+        WAVE = 1
+    };
+
+    enum class ADSRPhase : uint8_t
+    {
+        ATTACK,
+        DECAY,
+        SUSTAIN,
+        RELEASE,
+        OFF
+    };
+
+    const int CHANNEL_COUNT = 8;
+
+    struct AudioChannel
+    {
+        uint8_t waveforms = 0;
+        uint16_t frequency = 660;
+        uint16_t volume = 0xFFFF;
+
+        uint32_t adsr = 0;
+        ADSRPhase adsr_phase = ADSRPhase::OFF;
+
+        int16_t wave_buffer[64]{};
+        uint8_t wave_buf_pos = 0;
+        void (*wave_buffer_callback)(AudioChannel &channel) = nullptr;
+        void *user_data = nullptr;
+
+        void trigger_attack() { adsr_phase = ADSRPhase::ATTACK; }
+        void trigger_decay() { adsr_phase = ADSRPhase::DECAY; }
+        void trigger_sustain() { adsr_phase = ADSRPhase::SUSTAIN; }
+        void trigger_release() { adsr_phase = ADSRPhase::RELEASE; }
+        void off() { adsr_phase = ADSRPhase::OFF; }
+    };
+
+    extern AudioChannel channels[CHANNEL_COUNT];
+}
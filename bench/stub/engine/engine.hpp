@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace blit
+{
+    uint32_t now();
+    uint32_t now_us();
+    uint32_t us_diff(uint32_t from, uint32_t to);
+}
+
+// multiplies the time from now/now_us, playback-sim sets this to its CPU scale so that the streams' own timing matches
+extern double clockScale;
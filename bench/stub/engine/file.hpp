@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// read-only blit::File on top of stdio, paths are host paths
+
+namespace blit
+{
+    enum OpenMode
+    {
+        read = 1 << 0,
+        write = 1 << 1
+    };
+
+    class File final
+    {
+    public:
+        File() = default;
+        File(const std::string &filename, int mode = OpenMode::read) { open(filename, mode); }
+        File(const File &) = delete;
+        ~File() { close(); }
+
+        File &operator=(const File &) = delete;
+
+        bool open(const std::string &filename, int mode = OpenMode::read);
+        int32_t read(uint32_t offset, uint32_t length, char *buffer);
+        int32_t write(uint32_t offset, uint32_t length, const char *buffer);
+        void close();
+
+        uint32_t get_length();
+        bool is_open() const;
+
+    private:
+        FILE *fh = nullptr;
+        uint32_t length = 0;
+    };
+
+    bool file_exists(const std::string &path);
+}
+
+// counters for the benchmark
+struct FileStats
+{
+    uint64_t readCalls = 0, readBytes = 0, readNs = 0;
+};
+
+extern FileStats fileStats;
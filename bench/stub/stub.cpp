@@ -0,0 +1,108 @@
+#include <chrono>
+
+#include "audio/audio.hpp"
+#include "engine/engine.hpp"
+#include "engine/file.hpp"
+
+FileStats fileStats;
+double clockScale = 1.0;
+
+static uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t scaledNowNs()
+{
+    return nowNs() * clockScale;
+}
+
+namespace blit
+{
+    AudioChannel channels[CHANNEL_COUNT];
+
+    uint32_t now()
+    {
+        return scaledNowNs() / 1000000;
+    }
+
+    uint32_t now_us()
+    {
+        return scaledNowNs() / 1000;
+    }
+
+    uint32_t us_diff(uint32_t from, uint32_t to)
+    {
+        return to - from;
+    }
+
+    bool File::open(const std::string &filename, int mode)
+    {
+        close();
+
+        // the index/saves shouldn't be written (or read back) during a benchmark
+        if(mode != OpenMode::read)
+            return false;
+
+        fh = fopen(filename.c_str(), "rb");
+
+        if(!fh)
+            return false;
+
+        fseek(fh, 0, SEEK_END);
+        length = ftell(fh);
+
+        return true;
+    }
+
+    int32_t File::read(uint32_t offset, uint32_t length, char *buffer)
+    {
+        if(!fh)
+            return -1;
+
+        auto start = nowNs();
+
+        fseek(fh, offset, SEEK_SET);
+        auto ret = fread(buffer, 1, length, fh);
+
+        fileStats.readNs += nowNs() - start;
+        fileStats.readCalls++;
+        fileStats.readBytes += ret;
+
+        return ret;
+    }
+
+    int32_t File::write(uint32_t offset, uint32_t length, const char *buffer)
+    {
+        return -1;
+    }
+
+    void File::close()
+    {
+        if(fh)
+            fclose(fh);
+
+        fh = nullptr;
+        length = 0;
+    }
+
+    uint32_t File::get_length()
+    {
+        return length;
+    }
+
+    bool File::is_open() const
+    {
+        return fh != nullptr;
+    }
+
+    bool file_exists(const std::string &path)
+    {
+        auto fh = fopen(path.c_str(), "rb");
+
+        if(fh)
+            fclose(fh);
+
+        return fh != nullptr;
+    }
+}
@@ -0,0 +1,228 @@
+#include <cmath>
+#include <cstring>
+
+#include "dynamics.hpp"
+#include "trace.hpp"
+
+#ifdef PROFILER
+#include "engine/profiler.hpp"
+extern blit::ProfilerProbe *profilerDynamicsProbe;
+#endif
+
+static const float sampleRate = 22050.0f;
+
+// log2(1 + i / 32), Q16
+static const int32_t log2Table[33]
+{
+        0,  2909,  5732,  8473, 11136, 13727, 16248, 18704, 21098, 23433, 25711, 27936, 30109, 32234, 34312, 36346,
+    38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207, 52911, 54584, 56229, 57845, 59434, 60997, 62534, 64047,
+    65536
+};
+
+// 2^(i / 32), Q15
+static const int32_t exp2Table[33]
+{
+    32768, 33486, 34219, 34968, 35734, 36516, 37316, 38133, 38968, 39821, 40693, 41584, 42495, 43425, 44376, 45348,
+    46341, 47356, 48393, 49452, 50535, 51642, 52773, 53928, 55109, 56316, 57549, 58809, 60097, 61413, 62757, 64132,
+    65536
+};
+
+static int countLeadingZeros(uint32_t v)
+{
+#ifdef __GNUC__
+    return __builtin_clz(v);
+#else
+    int count = 0;
+    for(; !(v & (1u << 31)); v <<= 1)
+        count++;
+
+    return count;
+#endif
+}
+
+// log2(v / 2^fracBits), Q16
+static int32_t fixedLog2(uint32_t v, int fracBits)
+{
+    if(!v)
+        return -(32 << 16);
+
+    int lz = countLeadingZeros(v);
+    uint32_t mantissa = v << lz; // leading one at the top
+
+    int index = (mantissa >> 26) & 31;
+    int32_t interp = (mantissa >> 10) & 0xFFFF;
+    int32_t frac = log2Table[index] + (((log2Table[index + 1] - log2Table[index]) * interp) >> 16);
+
+    return ((31 - lz - fracBits) << 16) + frac;
+}
+
+// 2^(v / 2^16), Q15
+static int32_t fixedExp2(int32_t v)
+{
+    int shift = v >> 16;
+
+    if(shift < -15)
+        return 0;
+
+    // 2^15 is plenty of gain
+    if(shift > 14)
+        shift = 14;
+
+    int index = (v >> 11) & 31;
+    int32_t interp = v & 0x7FF;
+    int32_t mantissa = exp2Table[index] + (((exp2Table[index + 1] - exp2Table[index]) * interp) >> 11);
+
+    return shift < 0 ? mantissa >> -shift : mantissa << shift;
+}
+
+// one-pole coefficient for a time constant, Q15
+static int32_t timeCoeff(float ms)
+{
+    return static_cast<int32_t>(expf(-1000.0f / (ms * sampleRate)) * 32768.0f);
+}
+
+Dynamics::Dynamics()
+{
+    compAttack = timeCoeff(5.0f);
+    compRelease = timeCoeff(150.0f);
+    limRelease = timeCoeff(80.0f);
+
+    setLimiterThreshold(-1.0f);
+    reset();
+}
+
+void Dynamics::setPreset(Preset preset)
+{
+    switch(preset)
+    {
+        case Preset::Headphones:
+            setCompressor(false);
+            setLimiterThreshold(-1.0f);
+            break;
+
+        case Preset::Speaker:
+            // squash everything up to where the speaker can be heard
+            setCompressor(true, -30.0f, 3.0f, 10.0f);
+            setLimiterThreshold(-1.0f);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void Dynamics::setCompressor(bool enabled, float thresholdDb, float ratio, float makeupDb)
+{
+    compressorEnabled = enabled;
+
+    // work in Q16 log2 units, 1.0 = ~6.02dB
+    const float dbToLog2 = 65536.0f / 6.0206f;
+    compThresholdLog2 = static_cast<int32_t>(thresholdDb * dbToLog2);
+    compSlope = static_cast<int32_t>((1.0f - 1.0f / ratio) * 32768.0f);
+    compMakeupLog2 = static_cast<int32_t>(makeupDb * dbToLog2);
+}
+
+void Dynamics::setLimiterThreshold(float thresholdDb)
+{
+    limThreshold = static_cast<int32_t>(powf(10.0f, thresholdDb / 20.0f) * 32767.0f);
+}
+
+void Dynamics::reset()
+{
+    compEnvelope = 0;
+    compGain = 0x8000;
+
+    limEnvelope = 0;
+    limGain = 0x8000;
+    limHold = 0;
+
+    memset(delayLine, 0, sizeof(delayLine));
+    delayPos = 0;
+}
+
+void Dynamics::process(int16_t *samples, int count)
+{
+#ifdef PROFILER
+    blit::ScopedProfilerProbe scopedProbe(profilerDynamicsProbe);
+#endif
+    TRACE_SCOPE("Dynamics");
+
+    // the compressor feeds the limiter directly, so the makeup gain can't clip before it
+    if(compressorEnabled)
+        compress(samples, count);
+    else
+    {
+        for(int i = 0; i < count; i++)
+            samples[i] = limit(samples[i]);
+    }
+}
+
+void Dynamics::compress(int16_t *samples, int count)
+{
+    for(int i = 0; i < count; i += compressorStep)
+    {
+        int stepLen = count - i < compressorStep ? count - i : compressorStep;
+
+        // envelope follower, extra 8 bits of precision
+        for(int j = 0; j < stepLen; j++)
+        {
+            int32_t level = samples[i + j] < 0 ? -samples[i + j] : samples[i + j];
+            level <<= 8;
+
+            int32_t coeff = level > compEnvelope ? compAttack : compRelease;
+            compEnvelope = level + static_cast<int32_t>((static_cast<int64_t>(compEnvelope - level) * coeff) >> 15);
+        }
+
+        // gain for the end of this step
+        int32_t levelLog2 = fixedLog2(compEnvelope, 15 + 8);
+        int32_t over = levelLog2 - compThresholdLog2;
+        int32_t gainLog2 = compMakeupLog2 - (over > 0 ? (static_cast<int64_t>(over) * compSlope) >> 15 : 0);
+
+        int32_t targetGain = fixedExp2(gainLog2);
+
+        // ramp to it
+        int32_t gainStep = (targetGain - compGain) / stepLen;
+
+        for(int j = 0; j < stepLen; j++)
+        {
+            compGain += gainStep;
+            samples[i + j] = limit((static_cast<int64_t>(samples[i + j]) * compGain) >> 15);
+        }
+
+        compGain = targetGain;
+    }
+}
+
+int16_t Dynamics::limit(int32_t in)
+{
+    // attack should get close to the target within the look-ahead
+    const int attackShift = 4;
+
+    // input can be over full scale after the compressor's makeup gain
+    int32_t level = in < 0 ? -in : in;
+
+    // peak hold for the look-ahead, then release
+    if(level >= limEnvelope)
+    {
+        limEnvelope = level;
+        limHold = lookAhead;
+    }
+    else if(limHold)
+        limHold--;
+    else
+        limEnvelope = level + ((static_cast<int64_t>(limEnvelope - level) * limRelease) >> 15);
+
+    int32_t targetGain = limEnvelope > limThreshold ? (static_cast<int64_t>(limThreshold) << 15) / limEnvelope : 0x8000;
+
+    if(targetGain < limGain)
+        limGain += (targetGain - limGain) >> attackShift;
+    else
+        limGain = targetGain + (((limGain - targetGain) * limRelease) >> 15);
+
+    // output the delayed sample
+    int32_t out = (static_cast<int64_t>(delayLine[delayPos]) * limGain) >> 15;
+    delayLine[delayPos] = in;
+    delayPos = (delayPos + 1) % lookAhead;
+
+    return out > 32767 ? 32767 : (out < -32768 ? -32768 : out);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+
+#include "audio-processor.hpp"
+
+// optional compressor followed by a look-ahead peak limiter
+class Dynamics final : public AudioProcessor
+{
+public:
+    enum class Preset : uint8_t
+    {
+        Headphones = 0, // limiter only
+        Speaker, // heavy compression for a small, quiet speaker
+
+        Count
+    };
+
+    Dynamics();
+
+    void setPreset(Preset preset);
+
+    void setCompressor(bool enabled, float thresholdDb = -24.0f, float ratio = 2.0f, float makeupDb = 0.0f);
+    void setLimiterThreshold(float thresholdDb);
+
+    void reset() override;
+    void process(int16_t *samples, int count) override;
+
+private:
+    void compress(int16_t *samples, int count);
+    int16_t limit(int32_t in);
+
+    // ~2.9ms
+    static const int lookAhead = 64;
+
+    // gain is recalculated this often and interpolated in between
+    static const int compressorStep = 16;
+
+    // compressor
+    bool compressorEnabled = false;
+    int32_t compThresholdLog2 = 0, compMakeupLog2 = 0; // Q16 log2
+    int32_t compSlope = 0; // Q15
+
+    int32_t compEnvelope = 0; // Q15 << 8
+    int32_t compGain = 0x8000; // Q15
+    int32_t compAttack, compRelease;
+
+    // limiter
+    int32_t limThreshold = 0x8000;
+    int32_t limEnvelope = 0, limGain = 0x8000;
+    int limHold = 0;
+    int32_t limRelease;
+
+    int32_t delayLine[lookAhead]; // compressed samples, can be over full scale
+    int delayPos = 0;
+};
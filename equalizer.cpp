@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cmath>
+
+#include "equalizer.hpp"
+#include "trace.hpp"
+
+#if defined(__ARM_FEATURE_SIMD32) && defined(__ARM_FEATURE_SAT)
+#include <arm_acle.h>
+#define EQ_USE_SIMD32
+#endif
+
+#ifdef PROFILER
+#include "engine/profiler.hpp"
+extern blit::ProfilerProbe *profilerEQProbe;
+#endif
+
+static const float pi = 3.14159265358979f;
+static const float sampleRate = 22050.0f;
+
+static inline uint32_t pack16x2(int32_t lo, int32_t hi)
+{
+    return (static_cast<uint32_t>(lo) & 0xFFFF) | (static_cast<uint32_t>(hi) << 16);
+}
+
+static inline int16_t saturate16(int64_t v)
+{
+    return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+}
+
+const char *Equalizer::getPresetName(Preset preset)
+{
+    switch(preset)
+    {
+        case Preset::Flat:
+            return "Flat";
+        case Preset::BassBoost:
+            return "Bass";
+        case Preset::Speaker:
+            return "Speaker";
+        default:
+            return "?";
+    }
+}
+
+void Equalizer::setPreset(Preset preset)
+{
+    clearBands();
+
+    switch(preset)
+    {
+        case Preset::Flat:
+            setPreamp(0.0f);
+            break;
+
+        case Preset::BassBoost:
+            addBand(BandType::LowShelf, 120.0f, 6.0f, 0.707f);
+            addBand(BandType::Peak, 60.0f, 2.0f, 1.0f);
+            setPreamp(-7.0f);
+            break;
+
+        case Preset::Speaker:
+            // the speaker can't do anything below ~200Hz, so cut that and shelve up what it can do
+            addBand(BandType::HighPass, 150.0f, 0.0f, 0.707f);
+            addBand(BandType::LowShelf, 400.0f, 6.0f, 0.707f);
+            addBand(BandType::Peak, 900.0f, 2.0f, 1.2f);
+            addBand(BandType::Peak, 3000.0f, -2.0f, 1.0f);
+            addBand(BandType::HighShelf, 7000.0f, -3.0f, 0.707f);
+            setPreamp(-6.0f);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void Equalizer::clearBands()
+{
+    numBands = 0;
+}
+
+bool Equalizer::addBand(BandType type, float freq, float gainDb, float q)
+{
+    if(numBands == maxBands)
+        return false;
+
+    bands[numBands++] = {type, freq, gainDb, q};
+    updateCoefficients();
+
+    return true;
+}
+
+void Equalizer::setPreamp(float gainDb)
+{
+    preampDb = gainDb;
+    updateCoefficients();
+}
+
+void Equalizer::reset()
+{
+    for(int i = 0; i < numBands; i++)
+        stages[i].x12 = stages[i].y12 = 0;
+}
+
+void Equalizer::process(int16_t *samples, int count)
+{
+    processedBands = numBands;
+
+    if(!numBands)
+        return;
+
+#ifdef PROFILER
+    blit::ScopedProfilerProbe scopedProbe(profilerEQProbe);
+#endif
+    TRACE_SCOPE("EQ");
+
+    // one stage at a time over the whole block
+    for(int s = 0; s < numBands; s++)
+    {
+        auto &stage = stages[s];
+
+        auto x12 = stage.x12, y12 = stage.y12;
+        const auto b0 = stage.b0;
+        const auto b12 = stage.b12, a12 = stage.a12;
+        const int shift = stage.shift;
+        const int64_t round = 1 << (shift - 1);
+
+        for(int i = 0; i < count; i++)
+        {
+            int32_t x0 = samples[i];
+
+#ifdef EQ_USE_SIMD32
+            int64_t acc = round + x0 * b0;
+            acc = __smlald(x12, b12, acc);
+            acc = __smlald(y12, a12, acc);
+
+            int32_t y0 = __ssat(static_cast<int32_t>(acc >> shift), 16);
+#else
+            int32_t x1 = static_cast<int16_t>(x12), x2 = static_cast<int16_t>(x12 >> 16);
+            int32_t y1 = static_cast<int16_t>(y12), y2 = static_cast<int16_t>(y12 >> 16);
+
+            int64_t acc = round + x0 * b0;
+            acc += x1 * static_cast<int16_t>(b12);
+            acc += x2 * static_cast<int16_t>(b12 >> 16);
+            acc += y1 * static_cast<int16_t>(a12);
+            acc += y2 * static_cast<int16_t>(a12 >> 16);
+
+            int32_t y0 = saturate16(acc >> shift);
+#endif
+
+            // shift the new samples into the low halves
+            x12 = pack16x2(x0, x12);
+            y12 = pack16x2(y0, y12);
+
+            samples[i] = y0;
+        }
+
+        stage.x12 = x12;
+        stage.y12 = y12;
+    }
+}
+
+void Equalizer::updateCoefficients()
+{
+    for(int i = 0; i < numBands; i++)
+    {
+        auto &band = bands[i];
+
+        // RBJ cookbook
+        float a = powf(10.0f, band.gainDb / 40.0f);
+        float w0 = 2.0f * pi * band.freq / sampleRate;
+        float cosW0 = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * band.q);
+        float sqrtA2Alpha = 2.0f * sqrtf(a) * alpha;
+
+        float b[3], aCoeffs[3];
+
+        switch(band.type)
+        {
+            case BandType::LowShelf:
+                b[0] = a * ((a + 1.0f) - (a - 1.0f) * cosW0 + sqrtA2Alpha);
+                b[1] = 2.0f * a * ((a - 1.0f) - (a + 1.0f) * cosW0);
+                b[2] = a * ((a + 1.0f) - (a - 1.0f) * cosW0 - sqrtA2Alpha);
+                aCoeffs[0] = (a + 1.0f) + (a - 1.0f) * cosW0 + sqrtA2Alpha;
+                aCoeffs[1] = -2.0f * ((a - 1.0f) + (a + 1.0f) * cosW0);
+                aCoeffs[2] = (a + 1.0f) + (a - 1.0f) * cosW0 - sqrtA2Alpha;
+                break;
+
+            case BandType::Peak:
+                b[0] = 1.0f + alpha * a;
+                b[1] = -2.0f * cosW0;
+                b[2] = 1.0f - alpha * a;
+                aCoeffs[0] = 1.0f + alpha / a;
+                aCoeffs[1] = -2.0f * cosW0;
+                aCoeffs[2] = 1.0f - alpha / a;
+                break;
+
+            case BandType::HighShelf:
+                b[0] = a * ((a + 1.0f) + (a - 1.0f) * cosW0 + sqrtA2Alpha);
+                b[1] = -2.0f * a * ((a - 1.0f) + (a + 1.0f) * cosW0);
+                b[2] = a * ((a + 1.0f) + (a - 1.0f) * cosW0 - sqrtA2Alpha);
+                aCoeffs[0] = (a + 1.0f) - (a - 1.0f) * cosW0 + sqrtA2Alpha;
+                aCoeffs[1] = 2.0f * ((a - 1.0f) - (a + 1.0f) * cosW0);
+                aCoeffs[2] = (a + 1.0f) - (a - 1.0f) * cosW0 - sqrtA2Alpha;
+                break;
+
+            case BandType::HighPass:
+            default:
+                b[0] = (1.0f + cosW0) / 2.0f;
+                b[1] = -(1.0f + cosW0);
+                b[2] = (1.0f + cosW0) / 2.0f;
+                aCoeffs[0] = 1.0f + alpha;
+                aCoeffs[1] = -2.0f * cosW0;
+                aCoeffs[2] = 1.0f - alpha;
+                break;
+        }
+
+        // normalise, the first stage also gets the preamp
+        float scale = 1.0f / aCoeffs[0];
+        float bScale = i == 0 ? scale * powf(10.0f, preampDb / 20.0f) : scale;
+
+        float coeffs[5]{b[0] * bScale, b[1] * bScale, b[2] * bScale, -aCoeffs[1] * scale, -aCoeffs[2] * scale};
+
+        // pick the smallest shift that keeps everything in Q15 range
+        float maxCoeff = 0.0f;
+        for(auto &c : coeffs)
+            maxCoeff = std::max(maxCoeff, fabsf(c));
+
+        int coeffShift = 0;
+        while(maxCoeff >= 1.0f && coeffShift < 8)
+        {
+            maxCoeff /= 2.0f;
+            coeffShift++;
+        }
+
+        int32_t quantised[5];
+        for(int j = 0; j < 5; j++)
+            quantised[j] = static_cast<int32_t>(roundf(ldexpf(coeffs[j], 15 - coeffShift)));
+
+        // keep in int16 range after rounding
+        for(auto &q : quantised)
+            q = std::min(std::max(q, int32_t(-32768)), int32_t(32767));
+
+        auto &stage = stages[i];
+        auto b12 = pack16x2(quantised[1], quantised[2]), a12 = pack16x2(quantised[3], quantised[4]);
+
+        // keep the state if nothing changed (the same preset again), clearing it while playing can click
+        bool same = i < processedBands && stage.b0 == quantised[0] && stage.b12 == b12 && stage.a12 == a12 && stage.shift == 15 - coeffShift;
+
+        if(!same)
+            stage.x12 = stage.y12 = 0;
+
+        stage.b0 = quantised[0];
+        stage.b12 = b12;
+        stage.a12 = a12;
+        stage.shift = 15 - coeffShift;
+    }
+}
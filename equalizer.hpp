@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+
+#include "audio-processor.hpp"
+
+// cascade of Q15 biquads with 64-bit accumulation
+// uses SMLALD on cores with the DSP extension, the scalar path gives the same results
+class Equalizer final : public AudioProcessor
+{
+public:
+    enum class BandType : uint8_t
+    {
+        LowShelf,
+        Peak,
+        HighShelf,
+        HighPass,
+    };
+
+    enum class Preset : uint8_t
+    {
+        Flat = 0,
+        BassBoost,
+        Speaker,
+
+        Count
+    };
+
+    static const int maxBands = 10;
+
+    static const char *getPresetName(Preset preset);
+
+    void setPreset(Preset preset);
+
+    void clearBands();
+    bool addBand(BandType type, float freq, float gainDb, float q);
+
+    // folded into the first band, headroom for any boosts
+    void setPreamp(float gainDb);
+
+    void reset() override;
+    void process(int16_t *samples, int count) override;
+
+private:
+    struct Stage
+    {
+        // b0, (b1, b2), (-a1, -a2), pairs packed for SMLALD
+        int32_t b0;
+        uint32_t b12, a12;
+        int shift;
+
+        // (x[n-1], x[n-2]), (y[n-1], y[n-2])
+        uint32_t x12, y12;
+    };
+
+    struct Band
+    {
+        BandType type;
+        float freq, gainDb, q;
+    };
+
+    void updateCoefficients();
+
+    Band bands[maxBands];
+    int numBands = 0;
+    float preampDb = 0.0f;
+
+    Stage stages[maxBands];
+
+    // stages that process() has been running, the state of any after these is stale
+    int processedBands = 0;
+};
@@ -0,0 +1,53 @@
+#include <algorithm>
+
+#include "fade-ramp.hpp"
+
+void FadeRamp::reset(bool on)
+{
+    this->on = on;
+    gain = on ? fullGain : 0;
+}
+
+void FadeRamp::fadeIn()
+{
+    on = true;
+}
+
+void FadeRamp::fadeOut()
+{
+    on = false;
+}
+
+void FadeRamp::process(int16_t *samples, int count)
+{
+    int32_t target = on ? fullGain : 0;
+    int32_t curGain = gain;
+
+    // nothing to do most of the time
+    if(curGain == fullGain && target == fullGain)
+        return;
+
+    const int32_t step = fullGain / length;
+
+    for(int i = 0; i < count; i++)
+    {
+        if(curGain < target)
+            curGain = std::min(curGain + step, target);
+        else if(curGain > target)
+            curGain = std::max(curGain - step, target);
+
+        samples[i] = (samples[i] * curGain) >> 16;
+    }
+
+    gain = curGain;
+}
+
+bool FadeRamp::getOn() const
+{
+    return on;
+}
+
+bool FadeRamp::getSilent() const
+{
+    return !on && gain == 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// gain ramp in the audio callback, so that pausing, resuming, seeking and changing tracks don't click
+// the target is set from update(), the gain is only changed by the callback
+class FadeRamp final
+{
+public:
+    // samples to go from silence to full volume, about 12ms
+    static const int length = 256;
+
+    // jump straight to full volume or silence, only while the callback isn't running
+    void reset(bool on);
+
+    void fadeIn();
+    void fadeOut();
+
+    // in the audio callback, after the block has been filled
+    void process(int16_t *samples, int count);
+
+    // false after fadeOut(), even if it hasn't finished
+    bool getOn() const;
+
+    // faded out completely, the callback should stop taking samples until fadeIn()
+    bool getSilent() const;
+
+private:
+    static const int32_t fullGain = 1 << 16;
+
+    std::atomic<int32_t> gain{fullGain};
+    std::atomic<bool> on{true};
+};
@@ -0,0 +1,531 @@
+#include <algorithm>
+
+#include "flac-decoder.hpp"
+
+static const int sampleSizes[8]{0, 8, 12, 0, 16, 20, 24, 32};
+
+static int countLeadingZeros(uint64_t v)
+{
+#ifdef __GNUC__
+    return __builtin_clzll(v);
+#else
+    int count = 0;
+    for(; !(v & (uint64_t(1) << 63)); v <<= 1)
+        count++;
+
+    return count;
+#endif
+}
+
+// polynomial x^8 + x^2 + x + 1, for the frame header
+static uint8_t updateCRC8(uint8_t crc, uint8_t byte)
+{
+    crc ^= byte;
+
+    for(int i = 0; i < 8; i++)
+        crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+
+    return crc;
+}
+
+static int log2Ceil(int v)
+{
+    int ret = 0;
+    while((1 << ret) < v)
+        ret++;
+
+    return ret;
+}
+
+bool FlacDecoder::parseStreamInfo(const uint8_t *buf, StreamInfo &info)
+{
+    info.minBlockSize = buf[0] << 8 | buf[1];
+    info.maxBlockSize = buf[2] << 8 | buf[3];
+    info.maxFrameSize = buf[7] << 16 | buf[8] << 8 | buf[9];
+    info.sampleRate = buf[10] << 12 | buf[11] << 4 | buf[12] >> 4;
+    info.channels = ((buf[12] >> 1) & 7) + 1;
+    info.bitsPerSample = ((buf[12] & 1) << 4 | buf[13] >> 4) + 1;
+    info.totalSamples = static_cast<uint64_t>(buf[13] & 0xF) << 32 | static_cast<uint32_t>(buf[14] << 24 | buf[15] << 16 | buf[16] << 8 | buf[17]);
+
+    return info.maxBlockSize >= 16 && info.sampleRate;
+}
+
+bool FlacDecoder::init(StreamFile *file, const StreamInfo &info)
+{
+    if(info.channels > maxSupportedChannels || info.maxBlockSize > maxSupportedBlockSize || info.bitsPerSample < 4 || info.bitsPerSample > 24)
+        return false;
+
+    this->file = file;
+    this->info = info;
+
+    bufferOffset = 0;
+    bufferPos = bufferFilled = 0;
+    cache = 0;
+    cacheBits = 0;
+    endOfFile = false;
+
+    blockBuf.resize(info.channels * info.maxBlockSize);
+
+    return true;
+}
+
+void FlacDecoder::setOffset(uint32_t offset)
+{
+    cache = 0;
+    cacheBits = 0;
+    endOfFile = false;
+
+    // usually a failed sync, which is still in the buffer
+    if(offset >= bufferOffset && offset <= bufferOffset + bufferFilled)
+        bufferPos = offset - bufferOffset;
+    else
+    {
+        bufferOffset = offset;
+        bufferPos = bufferFilled = 0;
+    }
+}
+
+uint32_t FlacDecoder::getOffset() const
+{
+    return bufferOffset + bufferPos - cacheBits / 8;
+}
+
+int FlacDecoder::decodeFrame()
+{
+    int blockSize, channelMode, bits;
+
+    while(true)
+    {
+        alignToByte();
+        frameOffset = getOffset();
+
+        auto sync = readBits(8);
+
+        if(endOfFile)
+            return 0;
+
+        if(sync != 0xFF)
+            continue;
+
+        if(readFrameHeader(blockSize, channelMode, bits))
+        {
+            bool ok = true;
+
+            for(int c = 0; c < info.channels && ok; c++)
+            {
+                // the side channel has an extra bit
+                bool side = (channelMode == 8 && c == 1) || (channelMode == 9 && c == 0) || (channelMode == 10 && c == 1);
+                ok = readSubframe(blockBuf.data() + c * info.maxBlockSize, blockSize, bits + side);
+            }
+
+            if(ok)
+                break;
+        }
+
+        if(endOfFile)
+            return 0;
+
+        // false sync or a damaged frame, try again from the next byte
+        setOffset(frameOffset + 1);
+    }
+
+    // undo the stereo decorrelation
+    auto left = blockBuf.data(), right = left + info.maxBlockSize;
+
+    if(channelMode == 8)
+    {
+        for(int i = 0; i < blockSize; i++)
+            right[i] = left[i] - right[i];
+    }
+    else if(channelMode == 9)
+    {
+        for(int i = 0; i < blockSize; i++)
+            left[i] += right[i];
+    }
+    else if(channelMode == 10)
+    {
+        for(int i = 0; i < blockSize; i++)
+        {
+            int32_t mid = left[i] * 2 | (right[i] & 1);
+            int32_t side = right[i];
+            left[i] = (mid + side) >> 1;
+            right[i] = (mid - side) >> 1;
+        }
+    }
+
+    // footer CRC, not checked
+    alignToByte();
+    readBits(16);
+
+    frameBits = bits;
+
+    return blockSize;
+}
+
+const int32_t *FlacDecoder::getChannel(int channel) const
+{
+    return blockBuf.data() + channel * info.maxBlockSize;
+}
+
+int FlacDecoder::getFrameBits() const
+{
+    return frameBits;
+}
+
+uint64_t FlacDecoder::getFrameSample() const
+{
+    return frameSample;
+}
+
+uint32_t FlacDecoder::getFrameOffset() const
+{
+    return frameOffset;
+}
+
+bool FlacDecoder::readFrameHeader(int &blockSize, int &channelMode, int &bits)
+{
+    // the sync byte has already been read
+    uint8_t crc = updateCRC8(0, 0xFF);
+
+    auto nextByte = [this, &crc]()
+    {
+        auto byte = readBits(8);
+        crc = updateCRC8(crc, byte);
+        return byte;
+    };
+
+    auto byte = nextByte();
+    if((byte & 0xFE) != 0xF8)
+        return false;
+
+    bool variableBlockSize = byte & 1;
+
+    byte = nextByte();
+    int sizeCode = byte >> 4, rateCode = byte & 0xF;
+
+    byte = nextByte();
+    channelMode = byte >> 4;
+    int bitsCode = (byte >> 1) & 7;
+
+    if(!sizeCode || rateCode == 15 || channelMode > 10 || bitsCode == 3 || (byte & 1))
+        return false;
+
+    // frame/sample number, UTF-8 style
+    uint64_t number = nextByte();
+    int extraBytes = 0;
+
+    if(number & 0x80)
+    {
+        extraBytes = countLeadingZeros(~(number << 56)) - 1;
+
+        if(extraBytes < 1 || extraBytes > 6)
+            return false;
+
+        number &= 0x3F >> extraBytes;
+    }
+
+    for(int i = 0; i < extraBytes; i++)
+    {
+        byte = nextByte();
+        if((byte & 0xC0) != 0x80)
+            return false;
+
+        number = number << 6 | (byte & 0x3F);
+    }
+
+    if(sizeCode == 1)
+        blockSize = 192;
+    else if(sizeCode <= 5)
+        blockSize = 576 << (sizeCode - 2);
+    else if(sizeCode == 6)
+        blockSize = nextByte() + 1;
+    else if(sizeCode == 7)
+    {
+        blockSize = nextByte() << 8;
+        blockSize = (blockSize | nextByte()) + 1;
+    }
+    else
+        blockSize = 256 << (sizeCode - 8);
+
+    // the rate from STREAMINFO is used
+    if(rateCode == 12)
+        nextByte();
+    else if(rateCode == 13 || rateCode == 14)
+    {
+        nextByte();
+        nextByte();
+    }
+
+    bits = bitsCode ? sampleSizes[bitsCode] : info.bitsPerSample;
+
+    int expectedCRC = crc;
+    if(int(readBits(8)) != expectedCRC || endOfFile)
+        return false;
+
+    // anything that doesn't match the stream can't be decoded into the buffers
+    int channels = channelMode < 8 ? channelMode + 1 : 2;
+    if(channels != info.channels || blockSize > info.maxBlockSize || bits != info.bitsPerSample)
+        return false;
+
+    if(variableBlockSize)
+        frameSample = number;
+    else
+        frameSample = number * (info.minBlockSize == info.maxBlockSize ? info.maxBlockSize : blockSize);
+
+    return true;
+}
+
+bool FlacDecoder::readSubframe(int32_t *out, int blockSize, int bits)
+{
+    if(readBits(1))
+        return false;
+
+    int type = readBits(6);
+
+    int wastedBits = 0;
+    if(readBits(1))
+    {
+        wastedBits = readUnary() + 1;
+        bits -= wastedBits;
+
+        if(bits <= 0)
+            return false;
+    }
+
+    if(type == 0)
+    {
+        // constant
+        auto value = readSigned(bits);
+        std::fill(out, out + blockSize, value);
+    }
+    else if(type == 1)
+    {
+        // verbatim
+        for(int i = 0; i < blockSize; i++)
+            out[i] = readSigned(bits);
+    }
+    else if(type >= 8 && type <= 12)
+    {
+        // fixed predictor
+        int order = type - 8;
+        if(order > blockSize)
+            return false;
+
+        for(int i = 0; i < order; i++)
+            out[i] = readSigned(bits);
+
+        if(!readResidual(out, blockSize, order))
+            return false;
+
+        switch(order)
+        {
+            case 1:
+                for(int i = 1; i < blockSize; i++)
+                    out[i] += out[i - 1];
+                break;
+            case 2:
+                for(int i = 2; i < blockSize; i++)
+                    out[i] += 2 * out[i - 1] - out[i - 2];
+                break;
+            case 3:
+                for(int i = 3; i < blockSize; i++)
+                    out[i] += 3 * (out[i - 1] - out[i - 2]) + out[i - 3];
+                break;
+            case 4:
+                for(int i = 4; i < blockSize; i++)
+                    out[i] += 4 * (out[i - 1] + out[i - 3]) - 6 * out[i - 2] - out[i - 4];
+                break;
+        }
+    }
+    else if(type >= 32)
+    {
+        // LPC
+        int order = (type & 31) + 1;
+        if(order > blockSize)
+            return false;
+
+        for(int i = 0; i < order; i++)
+            out[i] = readSigned(bits);
+
+        int precision = readBits(4) + 1;
+        int shift = readSigned(5);
+
+        if(precision == 16 || shift < 0)
+            return false;
+
+        int32_t coefs[32];
+        for(int i = 0; i < order; i++)
+            coefs[i] = readSigned(precision);
+
+        if(!readResidual(out, blockSize, order))
+            return false;
+
+        // the sum only needs 64 bits for high precision coefficients/24-bit audio
+        if(bits + precision + log2Ceil(order) <= 32)
+        {
+            for(int i = order; i < blockSize; i++)
+            {
+                int32_t sum = 0;
+                for(int j = 0; j < order; j++)
+                    sum += coefs[j] * out[i - j - 1];
+
+                out[i] += sum >> shift;
+            }
+        }
+        else
+        {
+            for(int i = order; i < blockSize; i++)
+            {
+                int64_t sum = 0;
+                for(int j = 0; j < order; j++)
+                    sum += static_cast<int64_t>(coefs[j]) * out[i - j - 1];
+
+                out[i] += static_cast<int32_t>(sum >> shift);
+            }
+        }
+    }
+    else
+        return false;
+
+    if(wastedBits)
+    {
+        for(int i = 0; i < blockSize; i++)
+            out[i] *= 1 << wastedBits;
+    }
+
+    return !endOfFile;
+}
+
+bool FlacDecoder::readResidual(int32_t *out, int blockSize, int order)
+{
+    int method = readBits(2);
+    if(method > 1)
+        return false;
+
+    // 4 or 5 bit Rice parameters, the largest value means the partition is stored unencoded
+    int paramBits = method ? 5 : 4;
+    int escape = (1 << paramBits) - 1;
+
+    int partitionOrder = readBits(4);
+    int partitionSize = blockSize >> partitionOrder;
+
+    if((partitionSize << partitionOrder) != blockSize || partitionSize < order)
+        return false;
+
+    int i = order;
+
+    for(int partition = 0; partition < 1 << partitionOrder; partition++)
+    {
+        int end = (partition + 1) * partitionSize;
+        int param = readBits(paramBits);
+
+        if(param == escape)
+        {
+            int rawBits = readBits(5);
+
+            for(; i < end; i++)
+                out[i] = readSigned(rawBits);
+        }
+        else
+        {
+            for(; i < end; i++)
+            {
+                uint32_t value = readUnary() << param | readBits(param);
+                out[i] = static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+            }
+        }
+
+        if(endOfFile)
+            return false;
+    }
+
+    return true;
+}
+
+void FlacDecoder::refill()
+{
+    while(cacheBits <= 56)
+    {
+        if(bufferPos == bufferFilled)
+        {
+            bufferOffset += bufferFilled;
+            bufferPos = 0;
+
+            auto read = file->read(bufferOffset, bufferSize, reinterpret_cast<char *>(buffer));
+            bufferFilled = std::max(read, int32_t(0));
+
+            if(!bufferFilled)
+                return;
+        }
+
+        cache |= static_cast<uint64_t>(buffer[bufferPos++]) << (56 - cacheBits);
+        cacheBits += 8;
+    }
+}
+
+uint32_t FlacDecoder::readBits(int count)
+{
+    if(!count)
+        return 0;
+
+    if(cacheBits < count)
+    {
+        refill();
+
+        if(cacheBits < count)
+        {
+            endOfFile = true;
+            cache = 0;
+            cacheBits = 0;
+            return 0;
+        }
+    }
+
+    uint32_t ret = cache >> (64 - count);
+    cache <<= count;
+    cacheBits -= count;
+
+    return ret;
+}
+
+int32_t FlacDecoder::readSigned(int count)
+{
+    if(!count)
+        return 0;
+
+    // sign extend
+    return static_cast<int32_t>(readBits(count) << (32 - count)) >> (32 - count);
+}
+
+uint32_t FlacDecoder::readUnary()
+{
+    uint32_t count = 0;
+
+    // the unused bits at the bottom of the cache are always 0
+    while(!cache)
+    {
+        count += cacheBits;
+        cacheBits = 0;
+        refill();
+
+        if(!cacheBits)
+        {
+            endOfFile = true;
+            return 0;
+        }
+    }
+
+    int zeros = countLeadingZeros(cache);
+    cache <<= zeros;
+    cache <<= 1;
+    cacheBits -= zeros + 1;
+
+    return count + zeros;
+}
+
+void FlacDecoder::alignToByte()
+{
+    int extra = cacheBits & 7;
+    cache <<= extra;
+    cacheBits -= extra;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "stream-file.hpp"
+
+// integer-only FLAC frame decoder. reads through a small buffer, so the only memory that depends on the file is
+// the decoded block (channels * max block size)
+class FlacDecoder final
+{
+public:
+    // from STREAMINFO
+    struct StreamInfo
+    {
+        int minBlockSize = 0, maxBlockSize = 0;
+        uint32_t maxFrameSize = 0;
+        int sampleRate = 0, channels = 0, bitsPerSample = 0;
+        uint64_t totalSamples = 0; // per channel, 0 if unknown
+    };
+
+    // largest block that will be decoded, the reference encoder uses 4096
+    static const int maxSupportedBlockSize = 4608;
+    static const int maxSupportedChannels = 2;
+
+    // parses a 34 byte STREAMINFO block
+    static bool parseStreamInfo(const uint8_t *buf, StreamInfo &info);
+
+    // allocates the block buffers, returns false if the format isn't supported
+    bool init(StreamFile *file, const StreamInfo &info);
+
+    // continues from a byte offset, which can be anywhere before the next frame
+    void setOffset(uint32_t offset);
+
+    // offset of the next byte that hasn't been used
+    uint32_t getOffset() const;
+
+    // decodes the next frame, returns the number of samples per channel or 0 at the end of the file
+    int decodeFrame();
+
+    // from the last decodeFrame
+    const int32_t *getChannel(int channel) const;
+    int getFrameBits() const;
+    uint64_t getFrameSample() const;
+    uint32_t getFrameOffset() const;
+
+private:
+    // returns false if this isn't a valid frame header, which may just be a false sync
+    bool readFrameHeader(int &blockSize, int &channelMode, int &bits);
+    bool readSubframe(int32_t *out, int blockSize, int bits);
+    bool readResidual(int32_t *out, int blockSize, int order);
+
+    void refill();
+    uint32_t readBits(int count);
+    int32_t readSigned(int count);
+    uint32_t readUnary();
+    void alignToByte();
+
+    StreamFile *file = nullptr;
+    StreamInfo info;
+
+    static const int bufferSize = 4096;
+    uint8_t buffer[bufferSize];
+    uint32_t bufferOffset = 0; // file offset of buffer[0]
+    int bufferPos = 0, bufferFilled = 0;
+
+    // left aligned, bits that haven't been used yet
+    uint64_t cache = 0;
+    int cacheBits = 0;
+    bool endOfFile = false;
+
+    std::vector<int32_t> blockBuf;
+
+    int frameBits = 0;
+    uint64_t frameSample = 0;
+    uint32_t frameOffset = 0;
+};
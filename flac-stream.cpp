@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cstring>
+
+#include "flac-stream.hpp"
+#include "replay-gain.hpp"
+#include "stream-registry.hpp"
+
+#include "trace.hpp"
+
+static uint32_t getUint32LE(const uint8_t *buf)
+{
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | static_cast<uint32_t>(buf[3]) << 24;
+}
+
+static uint32_t getUint32BE(const uint8_t *buf)
+{
+    return static_cast<uint32_t>(buf[0]) << 24 | buf[1] << 16 | buf[2] << 8 | buf[3];
+}
+
+bool FlacStream::probe(const uint8_t *header, int length)
+{
+    return length >= 4 && memcmp(header, "fLaC", 4) == 0;
+}
+
+static StreamRegistry::Format format("FLAC", {".flac"}, &FlacStream::probe, []() -> AudioDecoder & {static FlacStream decoder; return decoder;});
+
+bool FlacStream::open(const std::string &filename, SourceInfo &sourceInfo, MusicTags &tags)
+{
+    frameCount = framePos = 0;
+    frameSample = 0;
+    info = FlacDecoder::StreamInfo();
+
+    if(!file.open(filename) || !parseMetadata(tags) || !decoder.init(&file, info))
+        return false;
+
+    decoder.setOffset(firstFrameOffset);
+
+    // instant, unless the encoder didn't know the length
+    sourceInfo.sampleRate = info.sampleRate;
+    sourceInfo.channels = info.channels;
+    sourceInfo.blockChannels = 1; // mixed before converting to 16-bit
+    sourceInfo.totalFrames = info.totalSamples;
+    sourceInfo.fileLength = file.get_length();
+
+    // the bitrate is much higher than a lossy file, but it's mostly Rice codes and short predictors
+    int durationMs = info.sampleRate ? info.totalSamples * 1000 / info.sampleRate : 0;
+    int bitrateKbps = durationMs ? uint64_t(file.get_length()) * 8 / durationMs : 0;
+    sourceInfo.cost = QualityGovernor::estimateCost(0.25f, info.sampleRate, info.channels, bitrateKbps);
+
+    // don't count the metadata reads
+    file.resetStats();
+
+    return true;
+}
+
+int FlacStream::decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels)
+{
+    // there's nothing to skip in the decode, only the resampler changes
+    if(framePos == frameCount)
+    {
+        frameCount = readFrame();
+        framePos = 0;
+
+        if(!frameCount)
+            return 0;
+    }
+
+    // a large block may be more than was asked for
+    int frames = std::min(frameCount - framePos, maxFrames);
+
+    // downmix and convert to 16-bit before resampling, the channels are added up so there's one more bit to remove
+    int shift = decoder.getFrameBits() - 16 + (info.channels - 1);
+    auto left = decoder.getChannel(0) + framePos;
+
+    if(info.channels == 1)
+    {
+        for(int i = 0; i < frames; i++)
+            out[i] = shift >= 0 ? left[i] >> shift : left[i] * (1 << -shift);
+    }
+    else
+    {
+        auto right = decoder.getChannel(1) + framePos;
+
+        for(int i = 0; i < frames; i++)
+        {
+            int32_t sum = left[i] + right[i];
+            out[i] = shift >= 0 ? sum >> shift : sum * (1 << -shift);
+        }
+    }
+
+    framePos += frames;
+
+    blockChannels = 1;
+    return frames;
+}
+
+bool FlacStream::parseMetadata(MusicTags &tags)
+{
+    uint8_t buf[34];
+    uint32_t fileLength = file.get_length();
+    uint32_t offset = 0;
+
+    if(file.read(0, 10, reinterpret_cast<char *>(buf)) != 10)
+        return false;
+
+    // some taggers add ID3v2 anyway
+    if(memcmp(buf, "ID3", 3) == 0)
+        offset = 10 + ((buf[6] & 0x7F) << 21 | (buf[7] & 0x7F) << 14 | (buf[8] & 0x7F) << 7 | (buf[9] & 0x7F));
+
+    if(file.read(offset, 4, reinterpret_cast<char *>(buf)) != 4 || memcmp(buf, "fLaC", 4) != 0)
+        return false;
+
+    offset += 4;
+
+    seekPoints.clear();
+
+    bool haveInfo = false, last = false;
+
+    while(!last)
+    {
+        if(file.read(offset, 4, reinterpret_cast<char *>(buf)) != 4)
+            return false;
+
+        last = buf[0] & 0x80;
+        int type = buf[0] & 0x7F;
+        uint32_t len = buf[1] << 16 | buf[2] << 8 | buf[3];
+
+        offset += 4;
+
+        if(offset + len > fileLength)
+            return false;
+
+        if(type == 0 && len >= 34)
+        {
+            if(file.read(offset, 34, reinterpret_cast<char *>(buf)) != 34)
+                return false;
+
+            haveInfo = FlacDecoder::parseStreamInfo(buf, info);
+        }
+        else if(type == 3)
+            parseSeekTable(offset, len);
+        else if(type == 4)
+            parseComments(offset, len, tags);
+
+        offset += len;
+    }
+
+    firstFrameOffset = offset;
+
+    return haveInfo;
+}
+
+void FlacStream::parseSeekTable(uint32_t offset, uint32_t len)
+{
+    const int pointSize = 18;
+    int numPoints = len / pointSize;
+
+    // keep every nth point if there are too many
+    int step = (numPoints + maxSeekPoints - 1) / maxSeekPoints;
+
+    seekPoints.reserve(std::min(numPoints, maxSeekPoints));
+
+    for(int i = 0; i < numPoints; i += step)
+    {
+        uint8_t buf[pointSize];
+        if(file.read(offset + i * pointSize, pointSize, reinterpret_cast<char *>(buf)) != pointSize)
+            break;
+
+        uint64_t sample = static_cast<uint64_t>(getUint32BE(buf)) << 32 | getUint32BE(buf + 4);
+        uint64_t pointOffset = static_cast<uint64_t>(getUint32BE(buf + 8)) << 32 | getUint32BE(buf + 12);
+
+        // placeholder
+        if(sample == ~uint64_t(0))
+            break;
+
+        if(pointOffset < file.get_length())
+            seekPoints.push_back({sample, static_cast<uint32_t>(pointOffset)});
+    }
+}
+
+void FlacStream::parseComments(uint32_t offset, uint32_t len, MusicTags &tags)
+{
+    auto end = offset + len;
+    uint8_t buf[4];
+
+    // skip the vendor string
+    if(file.read(offset, 4, reinterpret_cast<char *>(buf)) != 4)
+        return;
+
+    offset += 4 + getUint32LE(buf);
+
+    if(file.read(offset, 4, reinterpret_cast<char *>(buf)) != 4)
+        return;
+
+    uint32_t numComments = getUint32LE(buf);
+    offset += 4;
+
+    for(uint32_t i = 0; i < numComments && offset + 4 <= end; i++)
+    {
+        if(file.read(offset, 4, reinterpret_cast<char *>(buf)) != 4)
+            return;
+
+        uint32_t commentLen = getUint32LE(buf);
+        offset += 4;
+
+        // avoid reading huge strings (cover art)
+        if(commentLen < 1024)
+        {
+            std::string commentStr(commentLen, 0);
+            file.read(offset, commentLen, &commentStr[0]);
+
+            auto equals = commentStr.find('=');
+
+            if(equals != std::string::npos)
+            {
+                auto key = commentStr.substr(0, equals);
+                auto value = commentStr.substr(equals + 1);
+                std::for_each(key.begin(), key.end(), [](char &c) {c = toupper(c);});
+
+                if(key == "ALBUM")
+                    tags.album = value;
+                else if(key == "ARTIST")
+                    tags.artist = value;
+                else if(key == "TITLE")
+                    tags.title = value;
+                else if(key == "TRACKNUMBER" || key == "TRACK")
+                    tags.track = value;
+                else
+                    parseReplayGainTag(key, value.c_str(), tags);
+            }
+        }
+
+        offset += commentLen;
+    }
+}
+
+int FlacStream::readFrame()
+{
+    int frames = decoder.decodeFrame();
+
+    if(frames)
+        frameSample = decoder.getFrameSample();
+
+    return frames;
+}
+
+uint64_t FlacStream::seek(int ms)
+{
+    uint64_t target = static_cast<uint64_t>(ms) * info.sampleRate / 1000;
+
+    // the closest seek points either side of the target, or the start/end of the file
+    uint64_t lowSample = 0, highSample = info.totalSamples;
+    uint32_t lowOffset = 0, highOffset = file.get_length() - firstFrameOffset;
+
+    for(auto &point : seekPoints)
+    {
+        if(point.sample <= target)
+        {
+            lowSample = point.sample;
+            lowOffset = point.offset;
+        }
+        else
+        {
+            highSample = point.sample;
+            highOffset = point.offset;
+            break;
+        }
+    }
+
+    // guess from the average bitrate between them, starting a little early so that the frame containing the target is found
+    uint32_t guess = lowOffset;
+
+    if(highSample > target && highOffset > lowOffset)
+        guess += (highOffset - lowOffset) * (target - lowSample) / (highSample - lowSample);
+
+    uint32_t backoff = info.maxFrameSize ? info.maxFrameSize : 16384;
+    uint32_t offset = guess - std::min(guess - lowOffset, backoff);
+
+    decoder.setOffset(firstFrameOffset + offset);
+
+    // decode to the frame containing the target
+    while(true)
+    {
+        frameCount = readFrame();
+        framePos = 0;
+
+        if(!frameCount)
+            break;
+
+        // guessed too far, go back further (eventually to the seek point)
+        if(frameSample > target && offset != lowOffset)
+        {
+            backoff *= 4;
+            offset = guess - std::min(guess - lowOffset, backoff);
+            decoder.setOffset(firstFrameOffset + offset);
+            continue;
+        }
+
+        if(frameSample + frameCount > target)
+        {
+            framePos = std::max(target, frameSample) - frameSample;
+            break;
+        }
+    }
+
+    return frameSample + framePos;
+}
+
+uint32_t FlacStream::getInputPos() const
+{
+    return decoder.getOffset();
+}
+
+const StreamFile &FlacStream::getFile() const
+{
+    return file;
+}
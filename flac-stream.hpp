@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "stream-file.hpp"
+
+#include "audio-decoder.hpp"
+#include "flac-decoder.hpp"
+#include "music-tags.hpp"
+
+class FlacStream final : public AudioDecoder
+{
+public:
+    bool open(const std::string &filename, SourceInfo &sourceInfo, MusicTags &tags);
+
+    // looks at the start of a file, for StreamRegistry
+    static bool probe(const uint8_t *header, int length);
+
+    int decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels);
+
+    uint64_t seek(int ms);
+
+    uint32_t getInputPos() const;
+    const StreamFile &getFile() const;
+
+private:
+    // reads STREAMINFO, SEEKTABLE and VORBIS_COMMENT, returns false if there's no STREAMINFO
+    bool parseMetadata(MusicTags &tags);
+    void parseSeekTable(uint32_t offset, uint32_t len);
+    void parseComments(uint32_t offset, uint32_t len, MusicTags &tags);
+
+    // decodes the next frame, returns the number of samples
+    int readFrame();
+
+    StreamFile file;
+    uint32_t firstFrameOffset = 0;
+
+    struct SeekPoint
+    {
+        uint64_t sample;
+        uint32_t offset; // from firstFrameOffset
+    };
+
+    // at most maxSeekPoints, spread over the track
+    static const int maxSeekPoints = 256;
+    std::vector<SeekPoint> seekPoints;
+
+    FlacDecoder decoder;
+    FlacDecoder::StreamInfo info;
+
+    // the last frame is kept in the decoder, frameSample is the position of the first sample
+    int frameCount = 0, framePos = 0;
+    uint64_t frameSample = 0;
+};
@@ -0,0 +1,152 @@
+#include <cmath>
+#include <cstring>
+
+#include "loudness-meter.hpp"
+
+static const float pi = 3.14159265358979f;
+
+LoudnessMeter::LoudnessMeter()
+{
+    // K-weighting, re-derived for 22050Hz from the 48kHz filters in BS.1770
+    const float sampleRate = 22050.0f;
+
+    // high shelf
+    float k = tanf(pi * 1681.974450955533f / sampleRate);
+    float q = 0.7071752369554196f;
+    float vh = powf(10.0f, 3.999843853973347f / 20.0f);
+    float vb = powf(vh, 0.4996667741545416f);
+    float a0 = 1.0f + k / q + k * k;
+
+    shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf.b1 = 2.0f * (k * k - vh) / a0;
+    shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf.a1 = 2.0f * (k * k - 1.0f) / a0;
+    shelf.a2 = (1.0f - k / q + k * k) / a0;
+
+    // high pass
+    k = tanf(pi * 38.13547087602444f / sampleRate);
+    q = 0.5003270373238773f;
+    a0 = 1.0f + k / q + k * k;
+
+    highPass.b0 = 1.0f;
+    highPass.b1 = -2.0f;
+    highPass.b2 = 1.0f;
+    highPass.a1 = 2.0f * (k * k - 1.0f) / a0;
+    highPass.a2 = (1.0f - k / q + k * k) / a0;
+
+    reset();
+}
+
+void LoudnessMeter::reset()
+{
+    shelf.z1 = shelf.z2 = 0.0f;
+    highPass.z1 = highPass.z2 = 0.0f;
+
+    curEnergy = 0.0f;
+    curSubBlock = subBlockPos = numSubBlocks = 0;
+
+    memset(histogram, 0, sizeof(histogram));
+    numBlocks = 0;
+
+    peak = 0;
+    sourceChannels = 1;
+}
+
+void LoudnessMeter::setSourceChannels(int channels)
+{
+    sourceChannels = channels;
+}
+
+void LoudnessMeter::process(const int16_t *samples, int count)
+{
+    for(int i = 0; i < count; i++)
+    {
+        int32_t absSample = samples[i] < 0 ? -samples[i] : samples[i];
+        if(absSample > peak)
+            peak = absSample;
+
+        float filtered = highPass.process(shelf.process(samples[i] / 32768.0f));
+        curEnergy += filtered * filtered;
+
+        if(++subBlockPos < subBlockLen)
+            continue;
+
+        // end of a 100ms step
+        subBlockEnergy[curSubBlock] = curEnergy / subBlockLen;
+        curSubBlock = (curSubBlock + 1) % 4;
+        curEnergy = 0.0f;
+        subBlockPos = 0;
+
+        if(++numSubBlocks < 4)
+            continue;
+
+        // 400ms block with 75% overlap
+        float blockEnergy = (subBlockEnergy[0] + subBlockEnergy[1] + subBlockEnergy[2] + subBlockEnergy[3]) / 4.0f;
+
+        if(blockEnergy <= 0.0f)
+            continue;
+
+        float loudness = -0.691f + 10.0f * log10f(blockEnergy);
+
+        // absolute gate
+        if(loudness <= histogramMin)
+            continue;
+
+        int bin = static_cast<int>((loudness - histogramMin) / histogramStep);
+        histogram[bin < histogramBins ? bin : histogramBins - 1]++;
+        numBlocks++;
+    }
+}
+
+bool LoudnessMeter::getValid() const
+{
+    return numSubBlocks >= 4;
+}
+
+float LoudnessMeter::getIntegratedLoudness() const
+{
+    if(!numBlocks)
+        return histogramMin;
+
+    // energy of the middle of each bin
+    auto binEnergy = [](int bin)
+    {
+        return powf(10.0f, (histogramMin + (bin + 0.5f) * histogramStep + 0.691f) / 10.0f);
+    };
+
+    float energySum = 0.0f;
+    for(int i = 0; i < histogramBins; i++)
+        energySum += histogram[i] * binEnergy(i);
+
+    // relative gate
+    float gate = -0.691f + 10.0f * log10f(energySum / numBlocks) - 10.0f;
+    int gateBin = static_cast<int>(ceilf((gate - histogramMin) / histogramStep));
+
+    if(gateBin < 0)
+        gateBin = 0;
+
+    energySum = 0.0f;
+    uint32_t gatedBlocks = 0;
+
+    for(int i = gateBin; i < histogramBins; i++)
+    {
+        energySum += histogram[i] * binEnergy(i);
+        gatedBlocks += histogram[i];
+    }
+
+    if(!gatedBlocks)
+        return histogramMin;
+
+    float loudness = -0.691f + 10.0f * log10f(energySum / gatedBlocks);
+
+    // the output is a downmix, which for mostly correlated channels is about 3dB quieter than measuring them separately
+    if(sourceChannels == 2)
+        loudness += 3.0103f;
+
+    return loudness;
+}
+
+float LoudnessMeter::getPeak() const
+{
+    return peak / 32768.0f;
+}
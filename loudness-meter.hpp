@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+
+// BS.1770/EBU R128 style integrated loudness of the 22050Hz mono output
+class LoudnessMeter
+{
+public:
+    LoudnessMeter();
+
+    void reset();
+
+    // channels of the source before downmixing
+    void setSourceChannels(int channels);
+
+    void process(const int16_t *samples, int count);
+
+    // false if less than one 400ms block was measured
+    bool getValid() const;
+
+    float getIntegratedLoudness() const; // LUFS
+    float getPeak() const; // 1.0 = full scale
+
+private:
+    struct Biquad
+    {
+        float b0, b1, b2, a1, a2;
+        float z1, z2;
+
+        float process(float in)
+        {
+            float out = b0 * in + z1;
+            z1 = b1 * in - a1 * out + z2;
+            z2 = b2 * in - a2 * out;
+            return out;
+        }
+    };
+
+    // 100ms steps, a block is 4 of them
+    static const int subBlockLen = 2205;
+
+    // 0.2 LU bins from -70 to +5
+    static const int histogramBins = 375;
+    static constexpr float histogramMin = -70.0f, histogramStep = 0.2f;
+
+    Biquad shelf, highPass;
+
+    float subBlockEnergy[4];
+    float curEnergy = 0.0f;
+    int curSubBlock = 0, subBlockPos = 0, numSubBlocks = 0;
+
+    uint32_t histogram[histogramBins];
+    uint32_t numBlocks = 0;
+
+    int32_t peak = 0;
+
+    int sourceChannels = 1;
+};
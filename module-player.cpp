@@ -0,0 +1,1006 @@
+#include <algorithm>
+#include <cstring>
+
+#include "module-player.hpp"
+
+// Amiga periods (x4) for octave 0, each 1/8 semitone of finetune from -1 semitone. shifted right by the octave
+static const uint16_t amigaPeriods[12][16]
+{
+    {29021, 28812, 28605, 28399, 28195, 27992, 27790, 27590, 27392, 27195, 26999, 26805, 26612, 26421, 26231, 26042},
+    {27392, 27195, 26999, 26805, 26612, 26421, 26231, 26042, 25855, 25669, 25484, 25301, 25119, 24938, 24758, 24580},
+    {25855, 25669, 25484, 25301, 25119, 24938, 24758, 24580, 24403, 24228, 24054, 23881, 23709, 23538, 23369, 23201},
+    {24403, 24228, 24054, 23881, 23709, 23538, 23369, 23201, 23034, 22868, 22704, 22540, 22378, 22217, 22057, 21899},
+    {23034, 22868, 22704, 22540, 22378, 22217, 22057, 21899, 21741, 21585, 21429, 21275, 21122, 20970, 20819, 20670},
+    {21741, 21585, 21429, 21275, 21122, 20970, 20819, 20670, 20521, 20373, 20227, 20081, 19937, 19793, 19651, 19509},
+    {20521, 20373, 20227, 20081, 19937, 19793, 19651, 19509, 19369, 19230, 19091, 18954, 18818, 18682, 18548, 18414},
+    {19369, 19230, 19091, 18954, 18818, 18682, 18548, 18414, 18282, 18150, 18020, 17890, 17762, 17634, 17507, 17381},
+    {18282, 18150, 18020, 17890, 17762, 17634, 17507, 17381, 17256, 17132, 17008, 16886, 16765, 16644, 16524, 16405},
+    {17256, 17132, 17008, 16886, 16765, 16644, 16524, 16405, 16287, 16170, 16054, 15938, 15824, 15710, 15597, 15485},
+    {16287, 16170, 16054, 15938, 15824, 15710, 15597, 15485, 15373, 15263, 15153, 15044, 14936, 14828, 14721, 14616},
+    {15373, 15263, 15153, 15044, 14936, 14828, 14721, 14616, 14510, 14406, 14302, 14199, 14097, 13996, 13895, 13795},
+};
+
+// 2^(i/768) in 16.16, linear periods have 768 per octave
+static const uint32_t linearFrequencies[768]
+{
+     65536,  65595,  65654,  65714,  65773,  65832,  65892,  65951,  66011,  66071,  66130,  66190,
+     66250,  66309,  66369,  66429,  66489,  66549,  66609,  66670,  66730,  66790,  66850,  66911,
+     66971,  67032,  67092,  67153,  67213,  67274,  67335,  67395,  67456,  67517,  67578,  67639,
+     67700,  67761,  67823,  67884,  67945,  68007,  68068,  68129,  68191,  68252,  68314,  68376,
+     68438,  68499,  68561,  68623,  68685,  68747,  68809,  68871,  68933,  68996,  69058,  69120,
+     69183,  69245,  69308,  69370,  69433,  69496,  69558,  69621,  69684,  69747,  69810,  69873,
+     69936,  69999,  70062,  70126,  70189,  70252,  70316,  70379,  70443,  70507,  70570,  70634,
+     70698,  70762,  70825,  70889,  70953,  71017,  71082,  71146,  71210,  71274,  71339,  71403,
+     71468,  71532,  71597,  71661,  71726,  71791,  71856,  71920,  71985,  72050,  72115,  72181,
+     72246,  72311,  72376,  72442,  72507,  72573,  72638,  72704,  72769,  72835,  72901,  72967,
+     73032,  73098,  73164,  73230,  73297,  73363,  73429,  73495,  73562,  73628,  73695,  73761,
+     73828,  73894,  73961,  74028,  74095,  74162,  74229,  74296,  74363,  74430,  74497,  74564,
+     74632,  74699,  74766,  74834,  74902,  74969,  75037,  75105,  75172,  75240,  75308,  75376,
+     75444,  75512,  75581,  75649,  75717,  75786,  75854,  75922,  75991,  76060,  76128,  76197,
+     76266,  76335,  76404,  76473,  76542,  76611,  76680,  76749,  76819,  76888,  76957,  77027,
+     77096,  77166,  77236,  77305,  77375,  77445,  77515,  77585,  77655,  77725,  77795,  77866,
+     77936,  78006,  78077,  78147,  78218,  78288,  78359,  78430,  78501,  78572,  78642,  78713,
+     78785,  78856,  78927,  78998,  79069,  79141,  79212,  79284,  79355,  79427,  79499,  79571,
+     79642,  79714,  79786,  79858,  79930,  80003,  80075,  80147,  80220,  80292,  80365,  80437,
+     80510,  80582,  80655,  80728,  80801,  80874,  80947,  81020,  81093,  81166,  81240,  81313,
+     81386,  81460,  81533,  81607,  81681,  81754,  81828,  81902,  81976,  82050,  82124,  82198,
+     82273,  82347,  82421,  82496,  82570,  82645,  82719,  82794,  82869,  82944,  83019,  83093,
+     83169,  83244,  83319,  83394,  83469,  83545,  83620,  83696,  83771,  83847,  83923,  83998,
+     84074,  84150,  84226,  84302,  84378,  84454,  84531,  84607,  84683,  84760,  84836,  84913,
+     84990,  85066,  85143,  85220,  85297,  85374,  85451,  85528,  85606,  85683,  85760,  85838,
+     85915,  85993,  86070,  86148,  86226,  86304,  86382,  86460,  86538,  86616,  86694,  86772,
+     86851,  86929,  87008,  87086,  87165,  87244,  87322,  87401,  87480,  87559,  87638,  87717,
+     87796,  87876,  87955,  88034,  88114,  88194,  88273,  88353,  88433,  88513,  88592,  88672,
+     88752,  88833,  88913,  88993,  89073,  89154,  89234,  89315,  89396,  89476,  89557,  89638,
+     89719,  89800,  89881,  89962,  90043,  90125,  90206,  90288,  90369,  90451,  90532,  90614,
+     90696,  90778,  90860,  90942,  91024,  91106,  91188,  91271,  91353,  91436,  91518,  91601,
+     91684,  91766,  91849,  91932,  92015,  92098,  92181,  92265,  92348,  92431,  92515,  92598,
+     92682,  92766,  92849,  92933,  93017,  93101,  93185,  93269,  93354,  93438,  93522,  93607,
+     93691,  93776,  93860,  93945,  94030,  94115,  94200,  94285,  94370,  94455,  94541,  94626,
+     94711,  94797,  94882,  94968,  95054,  95140,  95226,  95312,  95398,  95484,  95570,  95656,
+     95743,  95829,  95916,  96002,  96089,  96176,  96263,  96350,  96436,  96524,  96611,  96698,
+     96785,  96873,  96960,  97048,  97135,  97223,  97311,  97399,  97487,  97575,  97663,  97751,
+     97839,  97928,  98016,  98104,  98193,  98282,  98370,  98459,  98548,  98637,  98726,  98815,
+     98905,  98994,  99083,  99173,  99262,  99352,  99442,  99531,  99621,  99711,  99801,  99891,
+     99982, 100072, 100162, 100253, 100343, 100434, 100524, 100615, 100706, 100797, 100888, 100979,
+    101070, 101162, 101253, 101344, 101436, 101527, 101619, 101711, 101803, 101895, 101987, 102079,
+    102171, 102263, 102356, 102448, 102540, 102633, 102726, 102818, 102911, 103004, 103097, 103190,
+    103283, 103377, 103470, 103564, 103657, 103751, 103844, 103938, 104032, 104126, 104220, 104314,
+    104408, 104502, 104597, 104691, 104786, 104880, 104975, 105070, 105165, 105260, 105355, 105450,
+    105545, 105640, 105736, 105831, 105927, 106022, 106118, 106214, 106310, 106406, 106502, 106598,
+    106694, 106791, 106887, 106984, 107080, 107177, 107274, 107371, 107468, 107565, 107662, 107759,
+    107856, 107954, 108051, 108149, 108246, 108344, 108442, 108540, 108638, 108736, 108834, 108932,
+    109031, 109129, 109228, 109326, 109425, 109524, 109623, 109722, 109821, 109920, 110019, 110119,
+    110218, 110317, 110417, 110517, 110617, 110716, 110816, 110917, 111017, 111117, 111217, 111318,
+    111418, 111519, 111619, 111720, 111821, 111922, 112023, 112124, 112226, 112327, 112428, 112530,
+    112631, 112733, 112835, 112937, 113039, 113141, 113243, 113345, 113448, 113550, 113653, 113755,
+    113858, 113961, 114064, 114167, 114270, 114373, 114476, 114580, 114683, 114787, 114890, 114994,
+    115098, 115202, 115306, 115410, 115514, 115618, 115723, 115827, 115932, 116036, 116141, 116246,
+    116351, 116456, 116561, 116667, 116772, 116877, 116983, 117088, 117194, 117300, 117406, 117512,
+    117618, 117724, 117831, 117937, 118043, 118150, 118257, 118363, 118470, 118577, 118684, 118792,
+    118899, 119006, 119114, 119221, 119329, 119437, 119544, 119652, 119760, 119869, 119977, 120085,
+    120194, 120302, 120411, 120519, 120628, 120737, 120846, 120955, 121065, 121174, 121283, 121393,
+    121502, 121612, 121722, 121832, 121942, 122052, 122162, 122272, 122383, 122493, 122604, 122715,
+    122825, 122936, 123047, 123158, 123270, 123381, 123492, 123604, 123715, 123827, 123939, 124051,
+    124163, 124275, 124387, 124500, 124612, 124725, 124837, 124950, 125063, 125176, 125289, 125402,
+    125515, 125628, 125742, 125855, 125969, 126083, 126197, 126310, 126425, 126539, 126653, 126767,
+    126882, 126996, 127111, 127226, 127341, 127456, 127571, 127686, 127801, 127917, 128032, 128148,
+    128263, 128379, 128495, 128611, 128727, 128844, 128960, 129076, 129193, 129310, 129426, 129543,
+    129660, 129777, 129894, 130012, 130129, 130247, 130364, 130482, 130600, 130718, 130836, 130954,
+};
+
+// the first half of a sine wave, for vibrato/tremolo
+static const uint8_t sineTable[32]
+{
+      0,  24,  49,  74,  97, 120, 141, 161, 180, 197, 212, 224, 235, 244, 250, 253,
+    255, 253, 250, 244, 235, 224, 212, 197, 180, 161, 141, 120,  97,  74,  49,  24,
+};
+
+static inline int32_t toSample(int8_t v)
+{
+    return v * 256;
+}
+
+static inline int32_t toSample(int16_t v)
+{
+    return v;
+}
+
+void ModulePlayer::init(const TrackerModule *module)
+{
+    this->module = module;
+
+    // about 1/sqrt(channels), a 4 channel MOD is at half volume
+    int root = 1;
+    while((root + 1) * (root + 1) <= module->channels * 256)
+        root++;
+
+    mixGain = (4096 * 16) / root;
+
+    visited.assign(module->orders.size() * 4, 0);
+
+    restart();
+}
+
+void ModulePlayer::restart()
+{
+    order = row = tick = 0;
+    speed = module->initialSpeed;
+    tempo = module->initialTempo;
+    globalVolume = module->initialGlobalVolume;
+    ended = false;
+
+    patternDelay = 0;
+    repeatingRow = false;
+    jump = orderJump = false;
+    jumpOrder = jumpRow = 0;
+    rowDataOrder = rowDataRow = -1;
+
+    std::fill(visited.begin(), visited.end(), 0);
+
+    for(auto &ch : channels)
+        ch = Channel();
+
+    tickSamplesFrac = 0;
+    tickSamples = 0;
+
+    while(order < int(module->orders.size()) && module->orders[order] == TrackerModule::skipOrder)
+        order++;
+
+    if(order == int(module->orders.size()) || module->orders[order] == TrackerModule::endOrder)
+        ended = true;
+    else
+        markVisited();
+}
+
+bool ModulePlayer::nextTick()
+{
+    if(ended)
+        return false;
+
+    for(int c = 0; c < module->channels; c++)
+        channels[c].periodOffset = channels[c].noteOffset = channels[c].volumeOffset = 0;
+
+    // during a pattern delay the effects keep going, but the notes aren't played again
+    if(tick == 0 && !repeatingRow)
+        processRow();
+    else
+        processTick();
+
+    for(int c = 0; c < module->channels; c++)
+        updateVoice(channels[c]);
+
+    // 2.5 / tempo seconds
+    uint32_t len = (uint32_t(outputRate) * 5 << 15) / tempo + tickSamplesFrac;
+    tickSamples = len >> 16;
+    tickSamplesFrac = len & 0xFFFF;
+
+    if(++tick >= speed)
+    {
+        tick = 0;
+
+        if(patternDelay)
+        {
+            patternDelay--;
+            repeatingRow = true;
+        }
+        else
+        {
+            repeatingRow = false;
+            nextRow();
+        }
+    }
+
+    return true;
+}
+
+int ModulePlayer::getTickSamples() const
+{
+    return tickSamples;
+}
+
+void ModulePlayer::mix(int16_t *out, int32_t *mixBuf, int count, Interpolation interpolation)
+{
+    memset(mixBuf, 0, count * sizeof(int32_t));
+
+    for(int c = 0; c < module->channels; c++)
+    {
+        auto &ch = channels[c];
+
+        if(!ch.active)
+            continue;
+
+        // silent channels still move along, without the mixing
+        if(!ch.mixVolume)
+            advanceVoice(ch, count);
+        else if(ch.sample->is16Bit)
+        {
+            if(interpolation == Interpolation::Linear)
+                mixVoice<int16_t, true>(ch, mixBuf, count);
+            else
+                mixVoice<int16_t, false>(ch, mixBuf, count);
+        }
+        else
+        {
+            if(interpolation == Interpolation::Linear)
+                mixVoice<int8_t, true>(ch, mixBuf, count);
+            else
+                mixVoice<int8_t, false>(ch, mixBuf, count);
+        }
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        int32_t v = ((mixBuf[i] >> 8) * mixGain) >> 12;
+        out[i] = std::min(std::max(v, -32768), 32767);
+    }
+}
+
+void ModulePlayer::skip(int count)
+{
+    for(int c = 0; c < module->channels; c++)
+    {
+        if(channels[c].active)
+            advanceVoice(channels[c], count);
+    }
+}
+
+void ModulePlayer::processRow()
+{
+    int pattern = module->orders[order];
+
+    // the row data carries on from the last row unless something jumped
+    if(order != rowDataOrder || row != rowDataRow)
+        rowData = module->getRowData(pattern, row);
+
+    ModuleNote notes[TrackerModule::maxChannels];
+    rowData = TrackerModule::unpackRow(rowData, notes, module->channels);
+
+    rowDataOrder = order;
+    rowDataRow = row + 1;
+
+    for(int c = 0; c < module->channels; c++)
+    {
+        auto &ch = channels[c];
+        ch.row = notes[c];
+
+        // note delay, triggered by tickEffects
+        bool delayed = ch.row.effect == ModuleEffect::Extended && (ch.row.param >> 4) == 0xD && (ch.row.param & 0x0F);
+
+        if(!delayed)
+            triggerNote(ch, ch.row);
+
+        rowEffects(ch, ch.row);
+    }
+}
+
+void ModulePlayer::processTick()
+{
+    for(int c = 0; c < module->channels; c++)
+        tickEffects(channels[c], channels[c].row);
+}
+
+void ModulePlayer::triggerNote(Channel &ch, const ModuleNote &note)
+{
+    using namespace ModuleEffect;
+
+    bool porta = note.effect == TonePorta || note.effect == TonePortaVolSlide || (note.volume >> 4) == 0xF;
+
+    if(note.instrument)
+        ch.instrument = note.instrument <= module->instruments.size() ? &module->instruments[note.instrument - 1] : nullptr;
+
+    if(note.effect == SampleOffset && (note.param || !module->effectMemory))
+        ch.sampleOffset = note.param;
+
+    const ModuleSample *sample = nullptr;
+
+    if(note.note == ModuleNote::noteOff)
+        releaseNote(ch);
+    else if(note.note)
+    {
+        if(ch.instrument)
+        {
+            auto index = ch.instrument->sampleMap[note.note - 1];
+            if(index < module->samples.size())
+                sample = &module->samples[index];
+        }
+
+        if(porta && ch.active)
+            ch.targetPeriod = getPeriod(note.note - 1 + ch.sample->relativeNote, ch.finetune);
+        else if(sample && sample->length)
+        {
+            ch.sample = sample;
+            ch.data = module->sampleData.data() + sample->dataOffset;
+            ch.note = note.note - 1 + sample->relativeNote;
+            ch.finetune = sample->finetune;
+            ch.period = ch.targetPeriod = getPeriod(ch.note, ch.finetune);
+
+            ch.active = true;
+            ch.backwards = false;
+            ch.pos = 0;
+
+            if(note.effect == SampleOffset)
+            {
+                uint32_t offset = ch.sampleOffset * 256;
+
+                if(offset < sample->length)
+                    ch.pos = int64_t(offset) << 16;
+                else if(sample->loop != ModuleSample::Loop::None)
+                    ch.pos = int64_t(sample->loopStart) << 16;
+                else
+                    ch.active = false;
+            }
+
+            // waveform bit 2 keeps the position
+            if(!(ch.vibratoWave & 4))
+                ch.vibratoPos = 0;
+            if(!(ch.tremoloWave & 4))
+                ch.tremoloPos = 0;
+
+            ch.retrigCount = 0;
+        }
+        else
+            ch.active = false;
+    }
+
+    // an instrument resets the volume and envelope
+    if(note.instrument && note.note != ModuleNote::noteOff && (sample || ch.sample))
+    {
+        ch.volume = (sample ? sample : ch.sample)->volume;
+        ch.keyOff = false;
+        ch.envelopeTick = 0;
+        ch.fadeVolume = 32768;
+    }
+
+    if(note.volume >= 0x10 && note.volume <= 0x50)
+        ch.volume = note.volume - 0x10;
+}
+
+void ModulePlayer::releaseNote(Channel &ch)
+{
+    ch.keyOff = true;
+
+    // nothing to release, stop
+    if(!ch.instrument || !ch.instrument->volumeEnvelope.enabled)
+        ch.volume = 0;
+}
+
+void ModulePlayer::rowEffects(Channel &ch, const ModuleNote &note)
+{
+    using namespace ModuleEffect;
+
+    int x = note.param >> 4, y = note.param & 0x0F;
+
+    // MOD effects don't remember their parameter
+    bool set = note.param || !module->effectMemory;
+
+    switch(note.volume >> 4)
+    {
+        case 0x8: // fine volume slide
+            ch.volume = std::max(ch.volume - (note.volume & 0x0F), 0);
+            break;
+        case 0x9:
+            ch.volume = std::min(ch.volume + (note.volume & 0x0F), 64);
+            break;
+
+        case 0xA: // vibrato speed
+            if(note.volume & 0x0F)
+                ch.vibratoSpeed = note.volume & 0x0F;
+            break;
+        case 0xB: // vibrato depth
+            if(note.volume & 0x0F)
+                ch.vibratoDepth = note.volume & 0x0F;
+            break;
+
+        case 0xF: // tone portamento
+            if(note.volume & 0x0F)
+                ch.tonePortaSpeed = (note.volume & 0x0F) << 4;
+            break;
+    }
+
+    switch(note.effect)
+    {
+        case PortaUp:
+            if(set)
+                ch.portaUp = note.param;
+            break;
+
+        case PortaDown:
+            if(set)
+                ch.portaDown = note.param;
+            break;
+
+        case TonePorta:
+            if(set)
+                ch.tonePortaSpeed = note.param;
+            break;
+
+        case Vibrato:
+            if(x)
+                ch.vibratoSpeed = x;
+            if(y)
+                ch.vibratoDepth = y;
+            break;
+
+        case TonePortaVolSlide:
+        case VibratoVolSlide:
+        case VolSlide:
+            if(set)
+                ch.volSlide = note.param;
+            break;
+
+        case Tremolo:
+            if(x)
+                ch.tremoloSpeed = x;
+            if(y)
+                ch.tremoloDepth = y;
+            break;
+
+        case PositionJump:
+            jump = orderJump = true;
+            jumpOrder = note.param;
+            break;
+
+        case SetVolume:
+            ch.volume = std::min(note.param, uint8_t(64));
+            break;
+
+        case PatternBreak:
+            // a position jump on the same row sets the order
+            if(!orderJump)
+                jumpOrder = order + 1;
+
+            jump = true;
+            jumpRow = x * 10 + y;
+            break;
+
+        case Extended:
+            switch(x)
+            {
+                case 0x1: // fine portamento
+                    if(y || !module->effectMemory)
+                        ch.finePortaUp = y;
+                    ch.period = std::max(ch.period - ch.finePortaUp * 4, minPeriod);
+                    break;
+                case 0x2:
+                    if(y || !module->effectMemory)
+                        ch.finePortaDown = y;
+                    ch.period = std::min(ch.period + ch.finePortaDown * 4, maxPeriod);
+                    break;
+
+                case 0x4:
+                    ch.vibratoWave = y;
+                    break;
+
+                case 0x6: // pattern loop
+                    if(!y)
+                        ch.loopRow = row;
+                    else if(!ch.loopCount || --ch.loopCount)
+                    {
+                        if(!ch.loopCount)
+                            ch.loopCount = y;
+
+                        jump = orderJump = true;
+                        jumpOrder = order;
+                        jumpRow = ch.loopRow;
+
+                        // these rows are played again, that isn't the song looping
+                        for(int r = ch.loopRow; r <= row; r++)
+                            visited[order * 4 + r / 64] &= ~(uint64_t(1) << (r % 64));
+                    }
+                    break;
+
+                case 0x7:
+                    ch.tremoloWave = y;
+                    break;
+
+                case 0xA: // fine volume slide
+                    if(y || !module->effectMemory)
+                        ch.fineVolUp = y;
+                    ch.volume = std::min(ch.volume + ch.fineVolUp, 64);
+                    break;
+                case 0xB:
+                    if(y || !module->effectMemory)
+                        ch.fineVolDown = y;
+                    ch.volume = std::max(ch.volume - ch.fineVolDown, 0);
+                    break;
+
+                case 0xC: // note cut
+                    if(!y)
+                        ch.volume = 0;
+                    break;
+
+                case 0xE: // pattern delay
+                    if(!patternDelay)
+                        patternDelay = y;
+                    break;
+            }
+            break;
+
+        case SpeedTempo:
+            if(note.param && note.param < 0x20)
+                speed = note.param;
+            else if(note.param)
+                tempo = note.param;
+            break;
+
+        case SetGlobalVolume:
+            globalVolume = std::min(note.param, uint8_t(64));
+            break;
+
+        case GlobalVolSlide:
+            if(set)
+                ch.globalVolSlide = note.param;
+            break;
+
+        case KeyOff:
+            if(!note.param)
+                releaseNote(ch);
+            break;
+
+        case MultiRetrig:
+            if(x)
+                ch.multiRetrig = (ch.multiRetrig & 0x0F) | x << 4;
+            if(y)
+                ch.multiRetrig = (ch.multiRetrig & 0xF0) | y;
+            break;
+
+        case ExtraFinePorta:
+            if(x == 1)
+            {
+                if(y)
+                    ch.extraFinePortaUp = y;
+                ch.period = std::max(ch.period - ch.extraFinePortaUp, minPeriod);
+            }
+            else if(x == 2)
+            {
+                if(y)
+                    ch.extraFinePortaDown = y;
+                ch.period = std::min(ch.period + ch.extraFinePortaDown, maxPeriod);
+            }
+            break;
+    }
+}
+
+void ModulePlayer::tickEffects(Channel &ch, const ModuleNote &note)
+{
+    using namespace ModuleEffect;
+
+    int x = note.param >> 4, y = note.param & 0x0F;
+
+    switch(note.volume >> 4)
+    {
+        case 0x6: // volume slide
+            ch.volume = std::max(ch.volume - (note.volume & 0x0F), 0);
+            break;
+        case 0x7:
+            ch.volume = std::min(ch.volume + (note.volume & 0x0F), 64);
+            break;
+
+        case 0xB:
+            vibrato(ch);
+            break;
+
+        case 0xF:
+            tonePorta(ch);
+            break;
+    }
+
+    switch(note.effect)
+    {
+        case Arpeggio:
+            if(note.param)
+            {
+                int step = tick % 3;
+                ch.noteOffset = step == 1 ? x : step == 2 ? y : 0;
+            }
+            break;
+
+        case PortaUp:
+            ch.period = std::max(ch.period - ch.portaUp * 4, minPeriod);
+            break;
+
+        case PortaDown:
+            ch.period = std::min(ch.period + ch.portaDown * 4, maxPeriod);
+            break;
+
+        case TonePorta:
+            tonePorta(ch);
+            break;
+
+        case Vibrato:
+            vibrato(ch);
+            break;
+
+        case TonePortaVolSlide:
+            tonePorta(ch);
+            volumeSlide(ch.volume, ch.volSlide);
+            break;
+
+        case VibratoVolSlide:
+            vibrato(ch);
+            volumeSlide(ch.volume, ch.volSlide);
+            break;
+
+        case Tremolo:
+            ch.volumeOffset = (waveform(ch.tremoloWave, ch.tremoloPos) * ch.tremoloDepth) >> 6;
+            ch.tremoloPos = (ch.tremoloPos + ch.tremoloSpeed) & 63;
+            break;
+
+        case VolSlide:
+            volumeSlide(ch.volume, ch.volSlide);
+            break;
+
+        case Extended:
+            switch(x)
+            {
+                case 0x9: // retrigger
+                    if(y && tick % y == 0 && ch.sample)
+                    {
+                        ch.pos = 0;
+                        ch.backwards = false;
+                        ch.active = true;
+                    }
+                    break;
+
+                case 0xC: // note cut
+                    if(tick == y)
+                        ch.volume = 0;
+                    break;
+
+                case 0xD: // note delay
+                    if(tick == y)
+                        triggerNote(ch, note);
+                    break;
+            }
+            break;
+
+        case GlobalVolSlide:
+            volumeSlide(globalVolume, ch.globalVolSlide);
+            break;
+
+        case KeyOff:
+            if(tick == note.param)
+                releaseNote(ch);
+            break;
+
+        case MultiRetrig:
+        {
+            int interval = ch.multiRetrig & 0x0F;
+
+            if(interval && ++ch.retrigCount >= interval && ch.sample)
+            {
+                ch.retrigCount = 0;
+                ch.pos = 0;
+                ch.backwards = false;
+                ch.active = true;
+
+                // volume change
+                static const int8_t add[16]{0, -1, -2, -4, -8, -16, 0, 0, 0, 1, 2, 4, 8, 16, 0, 0};
+                int change = ch.multiRetrig >> 4;
+
+                if(change == 6)
+                    ch.volume = ch.volume * 2 / 3;
+                else if(change == 7)
+                    ch.volume /= 2;
+                else if(change == 14)
+                    ch.volume = ch.volume * 3 / 2;
+                else if(change == 15)
+                    ch.volume *= 2;
+                else
+                    ch.volume += add[change];
+
+                ch.volume = std::min(std::max(ch.volume, 0), 64);
+            }
+            break;
+        }
+    }
+}
+
+void ModulePlayer::volumeSlide(int &volume, uint8_t param)
+{
+    if(param >> 4)
+        volume = std::min(volume + (param >> 4), 64);
+    else
+        volume = std::max(volume - (param & 0x0F), 0);
+}
+
+void ModulePlayer::tonePorta(Channel &ch)
+{
+    int speed = ch.tonePortaSpeed * 4;
+
+    if(ch.period < ch.targetPeriod)
+        ch.period = std::min(ch.period + speed, ch.targetPeriod);
+    else
+        ch.period = std::max(ch.period - speed, ch.targetPeriod);
+}
+
+void ModulePlayer::vibrato(Channel &ch)
+{
+    ch.periodOffset = (waveform(ch.vibratoWave, ch.vibratoPos) * ch.vibratoDepth) >> 5;
+    ch.vibratoPos = (ch.vibratoPos + ch.vibratoSpeed) & 63;
+}
+
+int ModulePlayer::waveform(int wave, int pos)
+{
+    switch(wave & 3)
+    {
+        case 0: // sine
+            return pos & 32 ? -sineTable[pos & 31] : sineTable[pos & 31];
+
+        case 1: // ramp down
+            return 255 - pos * 8;
+
+        default: // square
+            return pos & 32 ? -255 : 255;
+    }
+}
+
+void ModulePlayer::updateVoice(Channel &ch)
+{
+    if(!ch.active)
+    {
+        ch.mixVolume = 0;
+        return;
+    }
+
+    int32_t period = ch.period;
+
+    // arpeggio, relative to the current period in case there's also a portamento
+    if(ch.noteOffset)
+    {
+        if(module->linearPeriods)
+            period -= ch.noteOffset * 64;
+        else
+        {
+            int offset = ch.noteOffset;
+            if(offset >= 12)
+            {
+                period >>= 1;
+                offset -= 12;
+            }
+
+            period = period * amigaPeriods[offset][8] / amigaPeriods[0][8];
+        }
+    }
+
+    period = std::min(std::max(period + ch.periodOffset, minPeriod), maxPeriod);
+    ch.step = periodToStep(period);
+
+    int volume = std::min(std::max(ch.volume + ch.volumeOffset, 0), 64);
+    int envelope = envelopeVolume(ch);
+
+    // fade out after the envelope is released
+    if(ch.keyOff && ch.instrument && ch.instrument->volumeEnvelope.enabled)
+        ch.fadeVolume = std::max(ch.fadeVolume - ch.instrument->fadeout, 0);
+
+    ch.mixVolume = (((volume * envelope * globalVolume) >> 8) * ch.fadeVolume) >> 17;
+}
+
+int ModulePlayer::envelopeVolume(Channel &ch)
+{
+    if(!ch.instrument || !ch.instrument->volumeEnvelope.enabled)
+        return 64;
+
+    auto &envelope = ch.instrument->volumeEnvelope;
+    auto points = envelope.points;
+    int t = ch.envelopeTick;
+
+    int p = 0;
+    while(p < envelope.numPoints - 1 && points[p + 1].tick <= t)
+        p++;
+
+    int value;
+
+    if(p == envelope.numPoints - 1 || points[p + 1].tick == points[p].tick)
+        value = points[p].value;
+    else
+    {
+        int len = points[p + 1].tick - points[p].tick;
+        value = points[p].value + (points[p + 1].value - points[p].value) * (t - points[p].tick) / len;
+    }
+
+    // held at the sustain point until the key is released, then keeps going (or loops)
+    if(envelope.sustain && !ch.keyOff && t == points[envelope.sustainPoint].tick)
+        return value;
+
+    t++;
+
+    if(envelope.loop && t >= points[envelope.loopEnd].tick)
+        t = points[envelope.loopStart].tick;
+
+    ch.envelopeTick = std::min(t, int(points[envelope.numPoints - 1].tick));
+
+    return value;
+}
+
+int32_t ModulePlayer::getPeriod(int note, int finetune) const
+{
+    note = std::min(std::max(note, 0), 119);
+
+    // 64 per semitone, C-4 is 4608
+    if(module->linearPeriods)
+        return 7680 - note * 64 - finetune / 2;
+
+    return amigaPeriods[note % 12][(finetune + 128) >> 4] >> (note / 12);
+}
+
+int32_t ModulePlayer::periodToStep(int32_t period) const
+{
+    if(module->linearPeriods)
+    {
+        // 8363Hz at 4608, doubling every 768
+        int x = 4608 - period;
+        int octave = (x + 768 * 48) / 768 - 48;
+
+        uint64_t freq = uint64_t(8363) * linearFrequencies[x - octave * 768]; // 16.16
+        freq = octave >= 0 ? freq << octave : freq >> -octave;
+
+        return freq / outputRate;
+    }
+
+    return (uint64_t(14317056) << 16) / (uint64_t(period) * outputRate);
+}
+
+void ModulePlayer::nextRow()
+{
+    if(jump)
+    {
+        order = jumpOrder;
+        row = jumpRow;
+
+        jump = orderJump = false;
+        jumpRow = 0;
+    }
+    else if(++row >= module->patterns[module->orders[order]].rows)
+    {
+        order++;
+        row = 0;
+    }
+
+    auto &orders = module->orders;
+
+    while(order < int(orders.size()) && orders[order] == TrackerModule::skipOrder)
+        order++;
+
+    if(order >= int(orders.size()) || orders[order] == TrackerModule::endOrder)
+    {
+        ended = true;
+        return;
+    }
+
+    // breaking to a row past the end of the next pattern
+    if(row >= module->patterns[orders[order]].rows)
+        row = 0;
+
+    // back to somewhere that's already been played, the song is looping
+    if(!markVisited())
+        ended = true;
+}
+
+bool ModulePlayer::markVisited()
+{
+    auto &bits = visited[order * 4 + row / 64];
+    auto bit = uint64_t(1) << (row % 64);
+
+    if(bits & bit)
+        return false;
+
+    bits |= bit;
+    return true;
+}
+
+template<class T, bool linear>
+void ModulePlayer::mixVoice(Channel &ch, int32_t *out, int count)
+{
+    auto data = reinterpret_cast<const T *>(ch.data);
+    int32_t volume = ch.mixVolume;
+
+    while(count > 0 && ch.active)
+    {
+        // up to the end of the sample/loop
+        int n = samplesToBoundary(ch, count);
+
+        int64_t pos = ch.pos;
+        int32_t step = ch.backwards ? -ch.step : ch.step;
+
+        for(int i = 0; i < n; i++)
+        {
+            int32_t index = pos >> 16;
+            int32_t sample = toSample(data[index]);
+
+            // there's always one more sample after the end
+            if(linear)
+            {
+                int32_t next = toSample(data[index + 1]);
+                sample += ((next - sample) * int32_t((pos >> 1) & 0x7FFF)) >> 15;
+            }
+
+            out[i] += sample * volume;
+            pos += step;
+        }
+
+        ch.pos = pos;
+        out += n;
+        count -= n;
+
+        wrapVoice(ch);
+    }
+}
+
+void ModulePlayer::advanceVoice(Channel &ch, int count)
+{
+    auto &sample = *ch.sample;
+
+    // already in a forward loop, go straight to the end position
+    if(sample.loop == ModuleSample::Loop::Forward && ch.pos >= int64_t(sample.loopStart) << 16)
+    {
+        int64_t start = int64_t(sample.loopStart) << 16;
+        int64_t len = int64_t(sample.loopEnd - sample.loopStart) << 16;
+
+        ch.pos = start + (ch.pos - start + int64_t(ch.step) * count) % len;
+        return;
+    }
+
+    while(count > 0 && ch.active)
+    {
+        int n = samplesToBoundary(ch, count);
+
+        ch.pos += int64_t(ch.backwards ? -ch.step : ch.step) * n;
+        count -= n;
+
+        wrapVoice(ch);
+    }
+}
+
+int ModulePlayer::samplesToBoundary(const Channel &ch, int count)
+{
+    int64_t step = ch.step;
+    if(!step)
+        return count;
+
+    int64_t n;
+
+    if(ch.backwards)
+    {
+        int64_t start = int64_t(ch.sample->loopStart) << 16;
+        n = ch.pos < start ? 0 : (ch.pos - start) / step + 1;
+    }
+    else
+    {
+        int64_t end = int64_t(ch.sample->length) << 16;
+        n = ch.pos >= end ? 0 : (end - ch.pos + step - 1) / step;
+    }
+
+    return n < count ? n : count;
+}
+
+void ModulePlayer::wrapVoice(Channel &ch)
+{
+    auto &sample = *ch.sample;
+
+    int64_t start = int64_t(sample.loopStart) << 16;
+    int64_t end = int64_t(sample.length) << 16;
+
+    if(ch.backwards)
+    {
+        // ping-pong, back to forwards
+        if(ch.pos < start)
+        {
+            ch.pos = start + (start - ch.pos) % (end - start);
+            ch.backwards = false;
+        }
+    }
+    else if(ch.pos >= end)
+    {
+        if(sample.loop == ModuleSample::Loop::None)
+            ch.active = false;
+        else if(sample.loop == ModuleSample::Loop::Forward)
+            ch.pos = start + (ch.pos - end) % (end - start);
+        else
+        {
+            ch.pos = end - 1 - (ch.pos - end) % (end - start);
+            ch.backwards = true;
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "tracker-module.hpp"
+
+// plays a TrackerModule a tick at a time, mixing every channel to 22050Hz mono in fixed point
+class ModulePlayer final
+{
+public:
+    enum class Interpolation
+    {
+        Nearest,
+        Linear,
+    };
+
+    static const int outputRate = 22050;
+
+    // the longest tick (at 32 BPM)
+    static const int maxTickSamples = outputRate * 5 / (2 * 32) + 1;
+
+    void init(const TrackerModule *module);
+
+    // back to the start of the song
+    void restart();
+
+    // processes the next row/effects, returns false at the end of the song (which stops instead of looping)
+    bool nextTick();
+
+    // length of the tick from the last nextTick()
+    int getTickSamples() const;
+
+    // mixes the last tick, mixBuf needs space for count samples
+    void mix(int16_t *out, int32_t *mixBuf, int count, Interpolation interpolation);
+
+    // moves the voices along as if count samples had been mixed
+    void skip(int count);
+
+private:
+    // x4 Amiga periods or linear periods, both fit
+    static const int32_t minPeriod = 1, maxPeriod = 32000;
+
+    struct Channel
+    {
+        // voice, pos is 16.16 fixed point
+        const ModuleSample *sample = nullptr;
+        const int8_t *data = nullptr;
+        int64_t pos = 0;
+        int32_t step = 0;
+        bool active = false, backwards = false;
+        int32_t mixVolume = 0; // 0-256
+
+        const ModuleInstrument *instrument = nullptr;
+        ModuleNote row;
+
+        int note = 0; // 0-based, including the sample's relative note
+        int finetune = 0;
+        int32_t period = 0, targetPeriod = 0;
+        int volume = 0;
+
+        // volume envelope/fadeout
+        bool keyOff = false;
+        int envelopeTick = 0;
+        int32_t fadeVolume = 0; // 0-32768
+
+        // effect memory
+        uint8_t portaUp = 0, portaDown = 0, tonePortaSpeed = 0;
+        uint8_t finePortaUp = 0, finePortaDown = 0, extraFinePortaUp = 0, extraFinePortaDown = 0;
+        uint8_t volSlide = 0, fineVolUp = 0, fineVolDown = 0, globalVolSlide = 0;
+        uint8_t sampleOffset = 0, multiRetrig = 0;
+        uint8_t vibratoSpeed = 0, vibratoDepth = 0, vibratoPos = 0, vibratoWave = 0;
+        uint8_t tremoloSpeed = 0, tremoloDepth = 0, tremoloPos = 0, tremoloWave = 0;
+        int retrigCount = 0;
+        int loopRow = 0, loopCount = 0;
+
+        // from this tick's effects
+        int periodOffset = 0, noteOffset = 0, volumeOffset = 0;
+    };
+
+    void processRow();
+    void processTick();
+
+    // the note/instrument/volume column of a row
+    void triggerNote(Channel &ch, const ModuleNote &note);
+    void releaseNote(Channel &ch);
+    void rowEffects(Channel &ch, const ModuleNote &note);
+    void tickEffects(Channel &ch, const ModuleNote &note);
+
+    static void volumeSlide(int &volume, uint8_t param);
+    static void tonePorta(Channel &ch);
+    static void vibrato(Channel &ch);
+    static int waveform(int wave, int pos);
+
+    // sets the step/mix volume from the period/volume after this tick's effects
+    void updateVoice(Channel &ch);
+    int envelopeVolume(Channel &ch);
+
+    int32_t getPeriod(int note, int finetune) const;
+    int32_t periodToStep(int32_t period) const;
+
+    // moves to the next row, or wherever a jump/break said to go
+    void nextRow();
+    bool markVisited();
+
+    template<class T, bool linear>
+    static void mixVoice(Channel &ch, int32_t *out, int count);
+    static void advanceVoice(Channel &ch, int count);
+    static int samplesToBoundary(const Channel &ch, int count);
+    static void wrapVoice(Channel &ch);
+
+    const TrackerModule *module = nullptr;
+
+    Channel channels[TrackerModule::maxChannels];
+
+    int order = 0, row = 0, tick = 0;
+    int speed = 6, tempo = 125, globalVolume = 64;
+    bool ended = false;
+
+    // pattern delay (EEx), the row is played again this many times
+    int patternDelay = 0;
+    bool repeatingRow = false;
+
+    // set by Bxx/Dxx/E6x, used at the end of the row
+    bool jump = false, orderJump = false;
+    int jumpOrder = 0, jumpRow = 0;
+
+    // the row data follows on from the last row unless something jumps
+    const uint8_t *rowData = nullptr;
+    int rowDataOrder = -1, rowDataRow = -1;
+
+    // one bit per row for each order, the song ends when it gets to one it has already played
+    std::vector<uint64_t> visited;
+
+    // 16.16, with the remainder carried to the next tick
+    uint32_t tickSamplesFrac = 0;
+    int tickSamples = 0;
+
+    // Q12, scales down for modules with more channels
+    int32_t mixGain = 0;
+};
@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include "module-stream.hpp"
+#include "stream-registry.hpp"
+
+#include "trace.hpp"
+
+// the length of songs that never end (a pattern loop that keeps restarting) is cut off here
+static const uint32_t maxDurationSamples = ModulePlayer::outputRate * 60 * 60;
+
+bool ModuleStream::probe(const uint8_t *header, int length)
+{
+    return TrackerModule::probe(header, length);
+}
+
+static StreamRegistry::Format format("Tracker module", {".mod", ".s3m", ".xm"}, &ModuleStream::probe, []() -> AudioDecoder & {static ModuleStream decoder; return decoder;});
+
+bool ModuleStream::open(const std::string &filename, SourceInfo &info, MusicTags &tags)
+{
+    tickSamples = tickPos = 0;
+
+    if(!file.open(filename))
+        return false;
+
+    if(!module.load(file) || module.orders.empty())
+        return false;
+
+    tags.title = module.title;
+
+    player.init(&module);
+
+    // play through the song without mixing for the length, this also finds where it loops
+    uint32_t totalSamples = 0;
+
+    while(totalSamples < maxDurationSamples && player.nextTick())
+        totalSamples += player.getTickSamples();
+
+    player.restart();
+
+    // mixed to mono at the output rate, so there's nothing to convert
+    info.sampleRate = ModulePlayer::outputRate;
+    info.channels = info.blockChannels = 1;
+    info.totalFrames = totalSamples;
+    info.fileLength = file.get_length();
+
+    // roughly the cost of resampling each channel
+    info.cost = QualityGovernor::estimateCost(0.03f * module.channels, ModulePlayer::outputRate, 1, 0);
+
+    // everything is already in memory
+    file.close();
+    file.resetStats();
+
+    return true;
+}
+
+int ModuleStream::decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels)
+{
+    if(tickPos == tickSamples)
+    {
+        if(!player.nextTick())
+            return 0;
+
+        tickSamples = player.getTickSamples();
+        tickPos = 0;
+    }
+
+    int samples = std::min(tickSamples - tickPos, maxFrames);
+
+    auto interpolation = mode >= QualityMode::CheapResampler ? ModulePlayer::Interpolation::Nearest : ModulePlayer::Interpolation::Linear;
+
+    {
+        TRACE_SCOPE("Mix");
+        player.mix(out, mixBuf, samples, interpolation);
+    }
+
+    tickPos += samples;
+
+    blockChannels = 1;
+    return samples;
+}
+
+uint64_t ModuleStream::seek(int ms)
+{
+    // the state at any point depends on everything before it, so replay the song up to the target a tick at a time
+    // (the voices are moved along without mixing)
+    int target = static_cast<uint64_t>(ms) * ModulePlayer::outputRate / 1000;
+    int pos = 0;
+
+    player.restart();
+    tickSamples = tickPos = 0;
+
+    while(pos < target && player.nextTick())
+    {
+        player.skip(player.getTickSamples());
+        pos += player.getTickSamples();
+    }
+
+    return pos;
+}
+
+uint32_t ModuleStream::getInputPos() const
+{
+    // the whole file was read by open()
+    return 0;
+}
+
+const StreamFile &ModuleStream::getFile() const
+{
+    return file;
+}
+
+void ModuleStream::updateStats(StreamStats &stats) const
+{
+    // the source is mono, but this is more useful
+    stats.sourceChannels = module.channels;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+#include "stream-file.hpp"
+
+#include "audio-decoder.hpp"
+#include "module-player.hpp"
+#include "music-tags.hpp"
+
+// MOD/S3M/XM tracker modules, loaded into memory and mixed a tick at a time
+class ModuleStream final : public AudioDecoder
+{
+public:
+    bool open(const std::string &filename, SourceInfo &info, MusicTags &tags);
+
+    // looks at the start of a file, for StreamRegistry
+    static bool probe(const uint8_t *header, int length);
+
+    int decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels);
+
+    // replays the song up to ms without mixing
+    uint64_t seek(int ms);
+
+    uint32_t getInputPos() const;
+    const StreamFile &getFile() const;
+
+    void updateStats(StreamStats &stats) const;
+
+private:
+    StreamFile file;
+
+    TrackerModule module;
+    ModulePlayer player;
+
+    // the current tick, which may be mixed over more than one decode()
+    int tickSamples = 0, tickPos = 0;
+
+    int32_t mixBuf[ModulePlayer::maxTickSamples];
+};
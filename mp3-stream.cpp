@@ -1,22 +1,97 @@
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 
 #include "mp3-stream.hpp"
+#include "replay-gain.hpp"
+#include "stream-registry.hpp"
+
+// the cheaper quality modes skip parts of the decode. minimp3 has no options for that, so these calls are redirected to the
+// overloads below by appending a tag argument (the tag turns into an unused function pointer parameter on the real definitions)
+struct DecodeTag {};
+
+static void L3_antialias(float *grbuf, int nbands, DecodeTag);
+static void L3_imdct36(float *grbuf, float *overlap, const float *window, int nbands, DecodeTag);
+static void L3_imdct_short(float *grbuf, float *overlap, int nbands, DecodeTag);
+static void mp3d_synth_granule(float *qmf_state, float *grbuf, int nbands, int nch, int16_t *pcm, float *lins, DecodeTag);
+
+#define L3_antialias(...) L3_antialias(__VA_ARGS__, DecodeTag())
+#define L3_imdct36(...) L3_imdct36(__VA_ARGS__, DecodeTag())
+#define L3_imdct_short(...) L3_imdct_short(__VA_ARGS__, DecodeTag())
+#define mp3d_synth_granule(...) mp3d_synth_granule(__VA_ARGS__, DecodeTag())
 
 #define MINIMP3_IMPLEMENTATION
 #define MINIMP3_ONLY_MP3
 #include "minimp3.h"
 
-#include "audio/audio.hpp"
-#include "engine/engine.hpp"
-#include "engine/file.hpp"
+#undef L3_antialias
+#undef L3_imdct36
+#undef L3_imdct_short
+#undef mp3d_synth_granule
+
+#include "stream-file.hpp"
+#include "trace.hpp"
 
 #ifdef PROFILER
 #include "engine/profiler.hpp"
-extern blit::ProfilerProbe *profilerRefillProbe;
 extern blit::ProfilerProbe *profilerReadProbe;
-extern blit::ProfilerProbe *profilerDecProbe;
 #endif
 
+// set while decoding a frame in one of the cheaper modes
+static struct
+{
+    bool downmix = false;
+    bool halfBandwidth = false;
+} decodeLimits;
+
+static void L3_antialias(float *grbuf, int nbands, DecodeTag)
+{
+    if(decodeLimits.halfBandwidth)
+        nbands = std::min(nbands, 15);
+
+    L3_antialias(grbuf, nbands, nullptr);
+}
+
+// returns how many bands to transform, the ones above half the sample rate are cleared instead
+static int limitIMDCTBands(float *grbuf, float *overlap, int nbands)
+{
+    // this is the second call for mixed blocks, or the only call otherwise
+    if(!decodeLimits.halfBandwidth || nbands <= 16)
+        return nbands;
+
+    int keep = nbands - 16;
+    memset(grbuf + keep * 18, 0, 16 * 18 * sizeof(float));
+    memset(overlap + keep * 9, 0, 16 * 9 * sizeof(float));
+
+    return keep;
+}
+
+static void L3_imdct36(float *grbuf, float *overlap, const float *window, int nbands, DecodeTag)
+{
+    L3_imdct36(grbuf, overlap, window, limitIMDCTBands(grbuf, overlap, nbands), nullptr);
+}
+
+static void L3_imdct_short(float *grbuf, float *overlap, int nbands, DecodeTag)
+{
+    L3_imdct_short(grbuf, overlap, limitIMDCTBands(grbuf, overlap, nbands), nullptr);
+}
+
+static void mp3d_synth_granule(float *qmf_state, float *grbuf, int nbands, int nch, int16_t *pcm, float *lins, DecodeTag)
+{
+    // the synthesis is linear, so mixing the subbands first and only running it once gives the same mono output
+    // (joint stereo switches between L/R and M/S per frame, so the channels can't be skipped any earlier)
+    // the output for each granule is still the size of the stereo one, with the second half unused
+    if(decodeLimits.downmix && nch == 2)
+    {
+        for(int i = 0; i < 576; i++)
+            grbuf[i] = (grbuf[i] + grbuf[i + 576]) * 0.5f;
+
+        nch = 1;
+    }
+
+    mp3d_synth_granule(qmf_state, grbuf, nbands, nch, pcm, lins, nullptr);
+}
+
 // ID3v2 helpers
 
 static int getSynchsafe(char *buf)
@@ -31,7 +106,7 @@ static uint32_t getInt32(char *buf)
     return ubuf[3] | (ubuf[2] << 8) | (ubuf[1] << 16) | (ubuf[0] << 24);
 }
 
-static std::string readString(blit::File &file, uint32_t offset, char encoding, int32_t len)
+static std::string readString(StreamFile &file, uint32_t offset, char encoding, int32_t len)
 {
     std::string ret;
 
@@ -92,7 +167,7 @@ static std::string readString(blit::File &file, uint32_t offset, char encoding,
     return ret;
 }
 
-static std::string readTextTag(blit::File &file, uint32_t offset, int32_t len)
+static std::string readTextTag(StreamFile &file, uint32_t offset, int32_t len)
 {
     char encoding;
     file.read(offset, 1, &encoding);
@@ -100,6 +175,60 @@ static std::string readTextTag(blit::File &file, uint32_t offset, int32_t len)
     return readString(file, offset + 1, encoding, len);
 }
 
+// TXXX, which is where ReplayGain info lives
+static void readUserTextTag(StreamFile &file, uint32_t offset, uint32_t len, MusicTags &tags)
+{
+    // encoding + description + value, anything we care about is short
+    char buf[128];
+    if(len < 2 || len > sizeof(buf))
+        return;
+
+    file.read(offset, len, buf);
+
+    std::string strs[2];
+    int curStr = 0;
+    char encoding = buf[0];
+
+    if(encoding == 0 || encoding == 3)
+    {
+        // ISO-8859-1/UTF-8
+        for(uint32_t i = 1; i < len && curStr < 2; i++)
+        {
+            if(!buf[i])
+                curStr++;
+            else if((buf[i] & 0x80) == 0)
+                strs[curStr] += buf[i];
+        }
+    }
+    else if(encoding == 1 || encoding == 2)
+    {
+        // UTF-16, each string can have its own BOM
+        bool littleEndian = false;
+
+        for(uint32_t i = 1; i + 1 < len && curStr < 2; i += 2)
+        {
+            auto b0 = static_cast<uint8_t>(buf[i]), b1 = static_cast<uint8_t>(buf[i + 1]);
+
+            if(b0 == 0xFF && b1 == 0xFE)
+                littleEndian = true;
+            else if(b0 == 0xFE && b1 == 0xFF)
+                littleEndian = false;
+            else if(!b0 && !b1)
+                curStr++;
+            else
+            {
+                uint16_t c = littleEndian ? b0 | b1 << 8 : b1 | b0 << 8;
+
+                // "convert" by throwing away anything non-ascii
+                if(c < 0x80)
+                    strs[curStr] += c;
+            }
+        }
+    }
+
+    parseReplayGainTag(strs[0], strs[1].c_str(), tags);
+}
+
 MP3Stream::MP3Stream()
 {
     mp3dec = new mp3dec_t;
@@ -110,15 +239,26 @@ MP3Stream::~MP3Stream()
     delete mp3dec;
 }
 
-bool MP3Stream::load(std::string filename, bool doDurationCalc)
+bool MP3Stream::probe(const uint8_t *header, int length)
 {
-    if(channel != -1)
-        blit::channels[channel].off();
+    // an ID3v2 tag or a layer III frame header (the registry skips ID3v2 tags before probing)
+    if(length >= 3 && memcmp(header, "ID3", 3) == 0)
+        return true;
+
+    if(length < 4 || header[0] != 0xFF || (header[1] & 0xE0) != 0xE0)
+        return false;
 
-    currentSample = nullptr;
-    bufferedSamples = 0;
-    needConvert = false;
-    supported = true;
+    int version = (header[1] >> 3) & 3, layer = (header[1] >> 1) & 3;
+    int bitrate = header[2] >> 4, sampleRate = (header[2] >> 2) & 3;
+
+    return version != 1 && layer == 1 && bitrate != 15 && sampleRate != 3;
+}
+
+static StreamRegistry::Format format("MP3", {".mp3"}, &MP3Stream::probe, []() -> AudioDecoder & {static MP3Stream decoder; return decoder;});
+
+bool MP3Stream::open(const std::string &filename, SourceInfo &info, MusicTags &tags)
+{
+    frameCount = framePos = 0;
 
     if(!file.open(filename))
         return false;
@@ -131,28 +271,88 @@ bool MP3Stream::load(std::string filename, bool doDurationCalc)
     if(!fileBufferFilled)
         return false;
 
-    if(doDurationCalc)
-    {
-        mp3dec_init(static_cast<mp3dec_t *>(mp3dec));
-        durationMs = calcDuration();
-    }
-    else
-        durationMs = 0;
+    // for seeking
+    dataOffset = 0;
+    if(fileBufferFilled >= 10 && memcmp(fileBuffer, "ID3", 3) == 0)
+        dataOffset = 10 + getSynchsafe(reinterpret_cast<char *>(fileBuffer) + 6);
+
+    mp3dec_init(static_cast<mp3dec_t *>(mp3dec));
+    uint32_t totalFrames = calcDuration();
+
+    if(!sampleRate)
+        return false;
+
+    durationMs = static_cast<uint64_t>(totalFrames) * 1000 / sampleRate;
 
     // TODO: we're opening the file twice here
     tags = parseTags(filename);
 
+    info.sampleRate = sampleRate;
+    info.channels = info.blockChannels = channels;
+    info.totalFrames = totalFrames;
+    info.fileLength = file.get_length();
+    info.cost = QualityGovernor::estimateCost(1.0f, sampleRate, channels, bitrateKbps);
+
     // start the decoder
     mp3dec_init(static_cast<mp3dec_t *>(mp3dec));
 
+    // don't count the duration/tag scans
+    file.resetStats();
+
     return true;
 }
 
+int MP3Stream::decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels)
+{
+    if(framePos == frameCount)
+    {
+        frameCount = decodeFrame(mode);
+        framePos = 0;
+
+        if(!frameCount)
+            return 0;
+    }
+
+    // the rest of the frame may be more than was asked for
+    int frames = std::min(frameCount - framePos, maxFrames);
+    memcpy(out, frameBuf + framePos * frameChannels, frames * frameChannels * sizeof(int16_t));
+    framePos += frames;
+
+    blockChannels = frameChannels;
+    return frames;
+}
+
+uint64_t MP3Stream::seek(int ms)
+{
+    // assume a constant bitrate, minimp3 finds the next frame from there
+    uint64_t dataLength = file.get_length() - std::min(dataOffset, file.get_length());
+    fileOffset = dataOffset + dataLength * ms / durationMs;
+    fileBufferFilled = 0;
+    read(0);
+
+    frameCount = framePos = 0;
+
+    // the bit reservoir is lost, so the first frame or two may be quiet. that's under the fade in
+    mp3dec_init(static_cast<mp3dec_t *>(mp3dec));
+
+    return static_cast<uint64_t>(ms) * sampleRate / 1000;
+}
+
+uint32_t MP3Stream::getInputPos() const
+{
+    return fileOffset - fileBufferFilled;
+}
+
+const StreamFile &MP3Stream::getFile() const
+{
+    return file;
+}
+
 MusicTags MP3Stream::parseTags(std::string filename)
 {
     MusicTags ret;
 
-    blit::File file(filename);
+    StreamFile file(filename);
 
     if(!file.is_open())
         return ret;
@@ -202,6 +402,8 @@ MusicTags MP3Stream::parseTags(std::string filename)
             ret.artist = readTextTag(file, offset, frameSize);
         else if(id == "TRCK")
             ret.track = readTextTag(file, offset, frameSize);
+        else if(id == "TXXX")
+            readUserTextTag(file, offset, frameSize, ret);
         else
             printf("\t%s size %" PRIu32 " flags %x %x @%" PRIx32 "\n", id.c_str(), frameSize, buf[8], buf[9], offset);
 
@@ -211,231 +413,82 @@ MusicTags MP3Stream::parseTags(std::string filename)
     return ret;
 }
 
-void MP3Stream::play(int channel)
+int MP3Stream::decodeFrame(QualityMode mode)
 {
-    if(!fileBufferFilled)
-        return;
-
-    this->channel = channel;
-
-    if(!currentSample)
-    {
-        decode(0);
-        decode(1);
-
-        curAudioBuf = 0;
-        currentSample = audioBuf[0];
-        endSample = currentSample + dataSize[0];
-        blit::channels[channel].wave_buf_pos = 0;
-    }
-
-    blit::channels[channel].waveforms = blit::Waveform::WAVE;
-    blit::channels[channel].user_data = this;
-    blit::channels[channel].wave_buffer_callback = &MP3Stream::staticCallback;
-
-    //blit::channels[channel].trigger_attack();
-    blit::channels[channel].adsr = 0xFFFF00;
-    blit::channels[channel].trigger_sustain();
-}
-
-void MP3Stream::pause()
-{
-    blit::channels[channel].off();
-}
-
-bool MP3Stream::getPlaying() const
-{
-    return channel != -1 && blit::channels[channel].adsr_phase == blit::ADSRPhase::SUSTAIN;
-}
-
-void MP3Stream::update()
-{
-    if(!currentSample)
-        return;
-
-    // refill audio buffers
-    for(int i = 0; i < 2; i++)
-    {
-        if(!dataSize[i])
-            decode(i);
-    }    
-}
-
-int MP3Stream::getCurrentSample() const
-{
-    return bufferedSamples + blit::channels[channel].wave_buf_pos;
-}
-
-int MP3Stream::getDurationMs() const
-{
-    return durationMs;
-}
-
-const MusicTags &MP3Stream::getTags() const
-{
-    return tags;
-}
-
-bool MP3Stream::getFileSupported() const
-{
-    return supported;
-}
-
-void MP3Stream::decode(int bufIndex)
-{
-#ifdef PROFILER
-    blit::ScopedProfilerProbe scopedProbe(profilerRefillProbe);
-#endif
+    auto dec = static_cast<mp3dec_t *>(mp3dec);
 
     mp3dec_frame_info_t info = {};
 
-    int samples = 0;
-    int freqScale = 1;
+    // a stereo frame in a file that started as mono wouldn't fit in the block
+    bool downmix = mode >= QualityMode::Mono || channels == 1;
+
+    int frames = 0;
 
-    do
+    // frames without samples (tags, junk) are skipped
+    while(!frames)
     {
         if(fileBufferFilled == 0)
             break;
 
-#ifdef PROFILER
-        profilerDecProbe->start();
-#endif
+        decodeLimits.downmix = downmix;
+        decodeLimits.halfBandwidth = mode >= QualityMode::HalfBandwidth;
 
-        if(needConvert)
-        {
-            // attempt to convert to mono 22050Hz (badly)
-            int16_t tmpBuf[MINIMP3_MAX_SAMPLES_PER_FRAME];
-            int tmpSamples = mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), fileBuffer, fileBufferFilled, tmpBuf, &info);
-            
-            if(tmpSamples)
-            {
-                freqScale = info.hz / 22050;
-                int div = info.channels * freqScale;
-
-                for(int i = 0; i < tmpSamples * info.channels; i += div, samples++)
-                {
-                    int32_t tmp = 0;
-                    for(int j = 0; j < div; j++)
-                        tmp += tmpBuf[i + j];
-                    
-                    audioBuf[bufIndex][samples] = tmp / div;
-                }
-            }
-        }
-        else
-            samples += mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), fileBuffer, fileBufferFilled, audioBuf[bufIndex] + samples, &info);
+        frames = mp3dec_decode_frame(dec, fileBuffer, fileBufferFilled, frameBuf, &info);
 
-#ifdef PROFILER
-        profilerDecProbe->pause();
-#endif
+        decodeLimits.downmix = decodeLimits.halfBandwidth = false;
 
-        // switch conversion on and retry if needed
-        if(!needConvert && (info.channels != 1 || info.hz != 22050))
-        {
-            needConvert = true;
-            decode(bufIndex);
+        // nothing left that looks like a frame
+        if(!frames && !info.frame_bytes)
+            break;
 
-            supported = info.hz % 22050 == 0;
-            return;
-        }
-    
 #ifdef PROFILER
         profilerReadProbe->start();
 #endif
+        TRACE_BEGIN(readStart);
 
         read(info.frame_bytes);
 
 #ifdef PROFILER
         profilerReadProbe->pause();
 #endif
-
-        // / 2 because we only ever store mono
-    } while (samples + (MINIMP3_MAX_SAMPLES_PER_FRAME / (2 * freqScale)) <= audioBufSize);
-
-#ifdef PROFILER
-    profilerReadProbe->store_elapsed_us();
-    profilerDecProbe->store_elapsed_us();
-#endif
-
-    if(!samples)
-    {
-        dataSize[bufIndex] = -1;
-        return;
+        TRACE_END(readStart, "Read");
     }
 
-    dataSize[bufIndex] = samples;
-}
+    frameChannels = info.channels;
 
-void MP3Stream::staticCallback(blit::AudioChannel &channel)
-{
-    reinterpret_cast<MP3Stream *>(channel.user_data)->callback(channel);
-}
-
-void MP3Stream::callback(blit::AudioChannel &channel)
-{
-    if(!currentSample)
+    // only one channel was synthesised, move the second granule next to the first
+    if(frameChannels == 2 && downmix)
     {
-        channel.off();
-        return;
-    }
+        for(int i = 576; i < frames; i += 576)
+            memmove(frameBuf + i, frameBuf + i * 2, 576 * sizeof(int16_t));
 
-    // there was no buffer last time
-    if(currentSample == endSample)
-    {
-        if(dataSize[curAudioBuf])
-        {
-            // recover from underrun
-            endSample = audioBuf[curAudioBuf] + dataSize[curAudioBuf];
-        }
-        else
-        {
-            memset(channel.wave_buffer, 0, 64 * sizeof(int16_t));
-            return;
-        }
+        frameChannels = 1;
     }
 
-    auto out = channel.wave_buffer;
-
-    int i = 0;
-    for(; i < 64 /*&& currentSample != endSample*/; i++)
-        *(out++) = *(currentSample++);
-
-
-    // swap buffers
-    if(currentSample == endSample)
-    {
-        dataSize[curAudioBuf] = 0;
-        curAudioBuf = ++curAudioBuf % 2;
-
-        if(dataSize[curAudioBuf] == -1) // EOF
-            currentSample = endSample = nullptr;
-        else
-        {
-            currentSample = audioBuf[curAudioBuf];
-            endSample = currentSample + dataSize[curAudioBuf];
-
-            // if(currentSample == endSample)
-            // no more samples available - underrun
-        }
-    }
-
-    //for(; i < 64 && currentSample != endSample; i++)
-    //    *(out++) = *(currentSample++);
-
-    bufferedSamples += 64;
+    return frames;
 }
 
-int MP3Stream::calcDuration()
+uint32_t MP3Stream::calcDuration()
 {
     // decode entire file to get length
     unsigned int samples = 0;
 
     mp3dec_frame_info_t info = {};
+    sampleRate = channels = bitrateKbps = 0;
 
     //while(true)
     while(fileBufferFilled)
     {
-        samples += mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), fileBuffer, fileBufferFilled, nullptr, &info);
+        int frameSamples = mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), fileBuffer, fileBufferFilled, nullptr, &info);
+
+        if(frameSamples && !sampleRate)
+        {
+            sampleRate = info.hz;
+            channels = info.channels;
+            bitrateKbps = info.bitrate_kbps;
+        }
+
+        samples += frameSamples;
         read(info.frame_bytes);
     }
 
@@ -444,8 +497,7 @@ int MP3Stream::calcDuration()
     fileBufferFilled = 0;
     read(0);
 
-    int lenMs = (static_cast<uint64_t>(samples) * 1000) / info.hz;
-    return lenMs;
+    return samples;
 }
 
 void MP3Stream::read(int32_t len)
@@ -2,69 +2,57 @@
 
 #include <string>
 
-#include "audio/audio.hpp"
-#include "engine/file.hpp"
+#include "stream-file.hpp"
 
-#include "music-stream.hpp"
+#include "audio-decoder.hpp"
 #include "music-tags.hpp"
 
-class MP3Stream final : public MusicStream
+class MP3Stream final : public AudioDecoder
 {
 public:
     MP3Stream();
     ~MP3Stream();
 
-    bool load(std::string filename, bool doDurationCalc = false);
+    bool open(const std::string &filename, SourceInfo &info, MusicTags &tags);
 
-    MusicTags parseTags(std::string filename);
-
-    void play(int channel);
-    void pause();
+    // looks at the start of a file, for StreamRegistry
+    static bool probe(const uint8_t *header, int length);
 
-    bool getPlaying() const;
+    int decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels);
 
-    void update();
+    // assumes a constant bitrate
+    uint64_t seek(int ms);
 
-    int getCurrentSample() const;
-    int getDurationMs() const;
+    uint32_t getInputPos() const;
+    const StreamFile &getFile() const;
 
-    const MusicTags &getTags() const;
+private:
+    MusicTags parseTags(std::string filename);
 
-    bool getFileSupported() const;
+    // decodes the next frame into frameBuf, returns the number of samples
+    int decodeFrame(QualityMode mode);
 
-private:
-    void decode(int bufIndex);
-    int calcDuration();
+    // decodes the headers of the whole file for the length, and the format from the first frame
+    uint32_t calcDuration();
 
     void read(int32_t len);
 
-    static void staticCallback(blit::AudioChannel &channel);
-    void callback(blit::AudioChannel &channel);
-
     // file io
-    blit::File file;
+    StreamFile file;
     uint32_t fileOffset = 0;
+    uint32_t dataOffset = 0; // after any ID3v2 tag
 
     static const int fileBufferSize = 1024 * 4;
     uint8_t fileBuffer[fileBufferSize];
     int32_t fileBufferFilled = 0;
 
-    int channel = -1;
-
     // decoding
     void *mp3dec = nullptr;
-    bool needConvert = false;
 
-    static const int audioBufSize = 1152 * 4;
-    int16_t audioBuf[2][audioBufSize];
-    int16_t *currentSample = nullptr, *endSample = nullptr;
-    int dataSize[2]{};
-    int curAudioBuf = 0;
-
-    int bufferedSamples = 0;
+    int sampleRate = 0, channels = 0, bitrateKbps = 0;
     int durationMs = 0;
 
-    MusicTags tags;
-
-    bool supported = true;
-};
\ No newline at end of file
+    // the last frame, stereo before conversion
+    int16_t frameBuf[1152 * 2];
+    int frameCount = 0, framePos = 0, frameChannels = 0;
+};
@@ -2,9 +2,17 @@
 
 #include "assets.hpp"
 #include "control-icons.hpp"
+#include "dynamics.hpp"
+#include "equalizer.hpp"
 #include "file-browser.hpp"
-#include "mp3-stream.hpp"
-#include "vorbis-stream.hpp"
+#include "render-governor.hpp"
+#include "replay-gain.hpp"
+#include "sample-ring.hpp"
+#include "stream-pipeline.hpp"
+#include "stream-registry.hpp"
+#include "trace.hpp"
+#include "visualiser.hpp"
+#include "waveform.hpp"
 
 #ifdef PROFILER
 #include "engine/profiler.hpp"
@@ -14,23 +22,138 @@ blit::ProfilerProbe *profilerUpdateProbe;
 blit::ProfilerProbe *profilerRefillProbe;
 blit::ProfilerProbe *profilerReadProbe;
 blit::ProfilerProbe *profilerDecProbe;
+blit::ProfilerProbe *profilerEQProbe;
+blit::ProfilerProbe *profilerDynamicsProbe;
+blit::ProfilerProbe *profilerVisProbe;
 #endif
 
-MP3Stream mp3Stream;
-VorbisStream vorbisStream;
+StreamPipeline pipeline;
 MusicStream *musicStream;
 
+Equalizer equalizer;
+Dynamics dynamics;
+ProcessorChain processorChain;
+
+// EQ + dynamics combinations
+struct OutputProfile
+{
+    const char *name;
+    Equalizer::Preset eqPreset;
+    Dynamics::Preset dynamicsPreset;
+};
+
+const OutputProfile outputProfiles[]
+{
+    {"Phones", Equalizer::Preset::Flat, Dynamics::Preset::Headphones},
+    {"Phones+Bass", Equalizer::Preset::BassBoost, Dynamics::Preset::Headphones},
+    {"Speaker", Equalizer::Preset::Speaker, Dynamics::Preset::Speaker},
+};
+
+const int numOutputProfiles = sizeof(outputProfiles) / sizeof(outputProfiles[0]);
+
+Visualiser visualiser;
+
+// fall back to the VU meter if decoding is taking this much of each frame
+const uint32_t visDecodeBudgetUs = 8000;
+uint32_t avgUpdateUs = 0;
+bool visBusy = false;
+
+// y + left/right
+const int seekStepMs = 10000;
+
+// playback stats overlay, for finding the cause of stutters
+bool showStats = false;
+
+RenderGovernor renderGovernor;
+
+// cached waveform for the progress bar
+const int waveformW = 310, waveformH = 10;
+uint8_t waveformPixels[waveformW * waveformH * 4];
+blit::Surface waveformSurface(waveformPixels, blit::PixelFormat::RGBA, blit::Size(waveformW, waveformH));
+const Waveform *lastWaveform = nullptr;
+uint32_t lastWaveformVersion = 0;
+
 const blit::Font tallFont(asset_tall_font);
 duh::FileBrowser fileBrowser(tallFont);
+blit::Rect browserRect;
 
 std::string fileToLoad;
 bool renderedLoadMessage = false;
 
+// what's on screen from previous frames, render() only redraws the parts that changed
+struct DrawnState
+{
+    bool valid = false; // false to redraw everything
+    uint32_t fullRedrawTime = 0;
+
+    uint32_t buttons = 0;
+    bool stats = false;
+
+    uint32_t track = 0;
+    bool visualiser = false;
+    bool playing = false;
+
+    int progressX = -1, timeS = -1;
+    std::string gainLabel;
+};
+
+// the system menu can draw over the screen without render() knowing, so redraw everything now and then
+const uint32_t fullRedrawIntervalMs = 1000;
+
+DrawnState drawn;
+
+// incremented on every load, the tag text is built once per track
+uint32_t trackNumber = 0;
+std::string trackInfo;
+
+struct Settings
+{
+    uint8_t version = 4;
+    uint8_t volume = 100;
+    ReplayGainMode replayGainMode = ReplayGainMode::Track;
+    uint8_t outputProfile = 0;
+    Visualiser::Mode visualiserMode = Visualiser::Mode::Off;
+};
+
+Settings settings;
+
+void updateGain()
+{
+    if(musicStream)
+        musicStream->setGain(calcReplayGain(musicStream->getTags(), settings.replayGainMode, settings.volume));
+}
+
+void updateOutputProfile()
+{
+    auto &profile = outputProfiles[settings.outputProfile];
+    equalizer.setPreset(profile.eqPreset);
+    dynamics.setPreset(profile.dynamicsPreset);
+}
+
+void changeSettings()
+{
+    blit::write_save(settings);
+    updateGain();
+}
+
+#ifdef TRACE_ENABLED
+const char *traceFilename = "music-player-trace.json";
+
+void dumpTrace()
+{
+    if(traceDump(traceFilename))
+        printf("wrote trace to %s\n", traceFilename);
+}
+#endif
+
 void openMP3(std::string filename)
 {
-   // delay loading so that we can show the loading message
+   // delay loading so that we can show the loading message (and fade out the current track)
    renderedLoadMessage = false;
    fileToLoad = filename;
+
+   if(musicStream)
+       musicStream->pause();
 }
 
 void init()
@@ -39,7 +162,7 @@ void init()
 
 #ifdef PROFILER
     profiler.set_display_size(blit::screen.bounds.w, blit::screen.bounds.h);
-    profiler.set_rows(5);
+    profiler.set_rows(8);
     profiler.set_alpha(200);
     profiler.display_history(true);
 
@@ -52,10 +175,25 @@ void init()
     profilerRefillProbe = profiler.add_probe("Refill", 300);
     profilerReadProbe = profiler.add_probe("Read", 300);
     profilerDecProbe = profiler.add_probe("Decode", 300);
+    profilerEQProbe = profiler.add_probe("EQ", 300);
+    profilerDynamicsProbe = profiler.add_probe("Dynamics", 300);
+    profilerVisProbe = profiler.add_probe("Visualiser", 300);
 #endif
 
-    fileBrowser.set_extensions({".mp3", ".ogg", ".oga"});
-    fileBrowser.set_display_rect(blit::Rect(0, 0, blit::screen.bounds.w, blit::screen.bounds.h / 2 + 20));
+    Settings savedSettings;
+    if(blit::read_save(savedSettings) && savedSettings.version == settings.version && savedSettings.outputProfile < numOutputProfiles)
+        settings = savedSettings;
+
+    updateOutputProfile();
+
+    processorChain.add(&equalizer);
+    processorChain.add(&dynamics);
+    pipeline.setProcessor(&processorChain);
+
+    auto extensions = StreamRegistry::getExtensions();
+    fileBrowser.set_extensions({extensions.begin(), extensions.end()});
+    browserRect = blit::Rect(0, 0, blit::screen.bounds.w, blit::screen.bounds.h / 2 + 20);
+    fileBrowser.set_display_rect(browserRect);
     fileBrowser.set_on_file_open(openMP3);
     fileBrowser.init();
 
@@ -71,18 +209,145 @@ void init()
     }
 }
 
+// returns true if the waveform changed
+bool updateWaveformSurface(const Waveform &waveform)
+{
+    if(&waveform == lastWaveform && waveform.getVersion() == lastWaveformVersion)
+        return false;
+
+    lastWaveform = &waveform;
+    lastWaveformVersion = waveform.getVersion();
+
+    memset(waveformPixels, 0, sizeof(waveformPixels));
+
+    auto peaks = waveform.getPeaks(), rms = waveform.getRMS();
+    int filled = waveform.getFilledBuckets();
+
+    for(int x = 0; x < waveformW; x++)
+    {
+        int bucket = x * Waveform::numBuckets / waveformW;
+        if(bucket >= filled)
+            break;
+
+        // heights in half pixels from the center
+        int peakH = (peaks[bucket] * waveformH + 254) / 255;
+        int rmsH = (rms[bucket] * waveformH + 254) / 255;
+
+        for(int y = 0; y < waveformH; y++)
+        {
+            int dist = std::abs(y * 2 + 1 - waveformH);
+            auto pixel = waveformPixels + (x + y * waveformW) * 4;
+
+            if(dist < rmsH)
+            {
+                pixel[0] = pixel[1] = pixel[2] = 255;
+                pixel[3] = 255;
+            }
+            else if(dist < peakH)
+            {
+                pixel[0] = 160;
+                pixel[1] = 190;
+                pixel[2] = 255;
+                pixel[3] = 160;
+            }
+        }
+    }
+
+    return true;
+}
+
+void buildTrackInfo()
+{
+    auto &tags = musicStream->getTags();
+    trackInfo.clear();
+
+    if(!musicStream->getFileSupported())
+        trackInfo += "WARNING: unsupported file!\n\n";
+
+    if(!tags.artist.empty())
+        trackInfo += tags.artist + "\n";
+
+    if(!tags.title.empty())
+        trackInfo += tags.title + "\n";
+
+    if(!tags.album.empty())
+        trackInfo += tags.album;
+}
+
 void formatTime(int timeMs, char *buf, int bufLen)
 {
     snprintf(buf, bufLen, "%i:%02i", timeMs / 60000, (timeMs / 1000) % 60);
 }
 
+void renderStats()
+{
+    auto &stats = musicStream->getStats();
+
+    const int numLines = 9;
+    std::string lines[numLines];
+    char buf[100];
+
+    snprintf(buf, sizeof(buf), "Source: %iHz %ich, %ikbps (avg %i)", stats.sourceRate, stats.sourceChannels, stats.bitrate, stats.avgBitrate);
+    lines[0] = buf;
+
+    snprintf(buf, sizeof(buf), "Decode: %i.%ims avg, %i.%ims max (%i blocks)",
+        int(stats.getAvgDecodeUs() / 1000), int(stats.getAvgDecodeUs() / 100 % 10),
+        int(stats.maxDecodeUs / 1000), int(stats.maxDecodeUs / 100 % 10), int(stats.decodedBlocks));
+    lines[1] = buf;
+
+    int buffered = musicStream->getBufferedSamples();
+    int fill = stats.bufferSize ? buffered * 100 / stats.bufferSize : 0;
+    snprintf(buf, sizeof(buf), "Buffer: %i%% (%ims)", fill, buffered * 1000 / 22050);
+    lines[2] = buf;
+
+    snprintf(buf, sizeof(buf), "Underruns: %i (%ims)", int(stats.underruns), int(static_cast<uint64_t>(stats.underruns) * 64 * 1000 / 22050));
+    lines[3] = buf;
+
+    int hitRate = stats.getCacheHitRate();
+    snprintf(buf, sizeof(buf), "Read: %iKB in %i reads, cache ", int(stats.bytesRead / 1024), int(stats.reads));
+    lines[4] = buf + (hitRate < 0 ? std::string("-") : std::to_string(hitRate) + "%");
+
+    snprintf(buf, sizeof(buf), "Update: %i.%ims avg", int(avgUpdateUs / 1000), int(avgUpdateUs / 100 % 10));
+    lines[5] = buf;
+
+    lines[6] = std::string("Quality: ") + getQualityModeName(stats.qualityMode) + (stats.qualityAutomatic ? " (auto)" : "");
+
+    auto sinceChange = blit::now() - renderGovernor.getLastChangeTime();
+    snprintf(buf, sizeof(buf), "Render: %s %ims, %i changes (%i.%is ago), %i skipped", RenderGovernor::getModeName(renderGovernor.getMode()),
+        int(renderGovernor.getInterval()), int(renderGovernor.getChanges()), int(sinceChange / 1000), int(sinceChange / 100 % 10), int(renderGovernor.getSkippedFrames()));
+    lines[7] = buf;
+
+    // where the decode time goes
+    lines[8] = "Stages:";
+    for(int i = 0; i < int(PipelineStage::Count); i++)
+    {
+        auto stage = PipelineStage(i);
+        snprintf(buf, sizeof(buf), " %s %i%%", getPipelineStageName(stage), stats.getStagePercent(stage));
+        lines[8] += buf;
+    }
+
+    const int lineH = 10;
+    blit::screen.pen = blit::Pen(0, 0, 0, 200);
+    blit::screen.rectangle(blit::Rect(5, 5, blit::screen.bounds.w - 10, lineH * numLines + 6));
+
+    blit::screen.pen = blit::Pen(255, 255, 255);
+    for(int i = 0; i < numLines; i++)
+        blit::screen.text(lines[i], blit::minimal_font, blit::Point(9, 9 + i * lineH));
+}
+
 void render(uint32_t time_ms)
 {
+    TRACE_SCOPE("Render");
+
+    const blit::Pen background(20, 30, 40);
+
     blit::screen.alpha = 0xFF;
-    blit::screen.pen = blit::Pen(20, 30, 40);
-    blit::screen.clear();
 
 #ifdef PROFILER
+    blit::screen.pen = background;
+    blit::screen.clear();
+    drawn.valid = false;
+
     profiler.display_probe_overlay(1);
 
     if(musicStream)
@@ -91,13 +356,58 @@ void render(uint32_t time_ms)
 
     if(!fileToLoad.empty())
     {
+        blit::screen.pen = background;
+        blit::screen.clear();
+
         blit::screen.pen = blit::Pen(0xFF, 0xFF, 0xFF);
         blit::screen.text("Please wait...", blit::minimal_font, blit::Point(blit::screen.bounds.w / 2, blit::screen.bounds.h / 2), true, blit::TextAlign::center_center);
         renderedLoadMessage = true;
+        drawn.valid = false;
         return;
     }
 
-    fileBrowser.render();
+    // skip frames while idle, or to leave more time for decoding
+    static uint32_t lastButtons = 0;
+    bool input = blit::buttons || blit::buttons != lastButtons;
+    lastButtons = blit::buttons;
+
+    bool playing = musicStream && musicStream->getPlaying();
+    int buffered = musicStream ? musicStream->getBufferedSamples() : 0;
+
+    if(!renderGovernor.update(time_ms, input, playing, buffered))
+        return;
+
+    if(time_ms - drawn.fullRedrawTime >= fullRedrawIntervalMs)
+        drawn.valid = false;
+
+    bool full = !drawn.valid;
+
+    if(full)
+    {
+        blit::screen.pen = background;
+        blit::screen.clear();
+
+        drawn = DrawnState();
+        drawn.valid = true;
+        drawn.fullRedrawTime = time_ms;
+    }
+
+    // the browser only changes on input, the stats are drawn over it
+    bool showingStats = showStats && musicStream;
+
+    if(full || blit::buttons || blit::buttons != drawn.buttons || showingStats || drawn.stats)
+    {
+        blit::screen.pen = background;
+        blit::screen.rectangle(browserRect);
+
+        fileBrowser.render();
+
+        if(showingStats)
+            renderStats();
+
+        drawn.buttons = blit::buttons;
+        drawn.stats = showingStats;
+    }
 
     if(!musicStream)
         return;
@@ -108,59 +418,100 @@ void render(uint32_t time_ms)
     //float time = sampleOffset / 22050.0f;
     int time = (static_cast<uint64_t>(sampleOffset) * 1000) / 22050;
 
-    // format tag info
-    auto &tags = musicStream->getTags();
-    std::string info;
+    // size for 5 lines of text
+    blit::Rect infoRect(5, blit::screen.bounds.h / 2 + 25, blit::screen.bounds.w - 10, (tallFont.char_h + tallFont.spacing_y) * 5);
+    int centerH = blit::screen.bounds.h - 10; // center of progress bar
 
-    if(!musicStream->getFileSupported())
-        info += "WARNING: unsupported file!\n\n";
+    bool visualiserOn = settings.visualiserMode != Visualiser::Mode::Off;
 
-    if(!tags.artist.empty())
-        info += tags.artist + "\n";
+    // track info and play/pause, only on a new track or when the layout changes
+    if(full || drawn.track != trackNumber || drawn.visualiser != visualiserOn || drawn.playing != playing)
+    {
+        blit::screen.pen = background;
+        blit::screen.rectangle(infoRect);
 
-    if(!tags.title.empty())
-        info += tags.title + "\n";
+        blit::screen.pen = blit::Pen(255, 255, 255);
 
-    if(!tags.album.empty())
-        info += tags.album;
+        // shares the right side with the visualiser
+        blit::Rect textRect = infoRect;
+        if(visualiserOn)
+            textRect.w /= 2;
 
-    // size for 5 lines of text
-    blit::Rect infoRect(5, blit::screen.bounds.h / 2 + 25, blit::screen.bounds.w - 10, (tallFont.char_h + tallFont.spacing_y) * 5);
-    int centerH = blit::screen.bounds.h - 10; // center of progress bar
+        blit::screen.text(trackInfo, tallFont, textRect, true, blit::bottom_left);
 
-    // progress
-    float w = durationMs == 0 ? 0.0f : static_cast<float>(blit::screen.bounds.w - 10) / durationMs * time;
+        std::string playPauseLabel = playing ? "Pause" : "Play";
+        auto labelLen = blit::screen.measure_text(playPauseLabel, tallFont).w;
+        blit::screen.text(playPauseLabel, tallFont, infoRect, true, blit::top_right);
+        duh::draw_control_icon(&blit::screen, duh::Icon::X, infoRect.tr() - blit::Point(labelLen + 12 + 2, 0));
 
-    blit::screen.pen = blit::Pen(0, 0, 0);
-    blit::screen.rectangle(blit::Rect(5, centerH - 5, blit::screen.bounds.w - 10, 10));
+        drawn.track = trackNumber;
+        drawn.visualiser = visualiserOn;
+        drawn.playing = playing;
+    }
 
-    if(!musicStream->getFileSupported())
-        blit::screen.pen = blit::Pen(255, 0, 0);
-    else
-        blit::screen.pen = blit::Pen(255, 255, 255);
+    // visualiser, every frame
+    if(visualiserOn)
+    {
+        // cheapest one if decoding is struggling
+        auto mode = visBusy ? Visualiser::Mode::VU : settings.visualiserMode;
+
+        int16_t samples[512];
+        int count = musicStream->peekSamples(samples, 512);
+
+        int lineH = tallFont.char_h + tallFont.spacing_y;
+        blit::Rect visRect(infoRect.x + infoRect.w / 2, infoRect.y + lineH + 2, infoRect.w / 2, infoRect.h - lineH - 2);
 
-    blit::screen.rectangle(blit::Rect(5, centerH - 5, w, 10));
+        blit::screen.pen = background;
+        blit::screen.rectangle(visRect);
+
+        visualiser.render(blit::screen, visRect, mode, samples, count);
+    }
+
+    // progress/time/volume, when any of them have moved
+    int progressX = durationMs == 0 ? 0 : static_cast<int64_t>(blit::screen.bounds.w - 10) * time / durationMs;
+    bool waveformChanged = updateWaveformSurface(musicStream->getWaveform());
 
-    // time
     char buf[10];
-    formatTime(time, buf, 10);
-    blit::screen.text(buf, blit::minimal_font, blit::Point(5, centerH - 15));
+    snprintf(buf, 10, "%i%%", settings.volume);
+    std::string gainLabel = std::string("Vol ") + buf + " RG " + getReplayGainModeName(settings.replayGainMode) + " " + outputProfiles[settings.outputProfile].name;
+
+    if(full || waveformChanged || progressX != drawn.progressX || time / 1000 != drawn.timeS || gainLabel != drawn.gainLabel)
+    {
+        blit::screen.pen = background;
+        blit::screen.rectangle(blit::Rect(0, centerH - 15, blit::screen.bounds.w, 20));
 
-    // duration
-    formatTime(durationMs, buf, 10);
-    blit::screen.text(buf, blit::minimal_font, blit::Rect(0, centerH - 15, blit::screen.bounds.w - 5, 10), true, blit::TextAlign::top_right);
+        // progress
+        blit::screen.pen = blit::Pen(0, 0, 0);
+        blit::screen.rectangle(blit::Rect(5, centerH - 5, blit::screen.bounds.w - 10, 10));
 
-    // track info
-    blit::screen.text(info, tallFont, infoRect, true, blit::bottom_left);
+        if(!musicStream->getFileSupported())
+            blit::screen.pen = blit::Pen(255, 0, 0);
+        else
+            blit::screen.pen = blit::Pen(60, 90, 130);
+
+        blit::screen.rectangle(blit::Rect(5, centerH - 5, progressX, 10));
+
+        // waveform over the top
+        blit::screen.blit(&waveformSurface, blit::Rect(0, 0, waveformW, waveformH), blit::Point(5, centerH - 5));
+
+        blit::screen.pen = blit::Pen(255, 255, 255);
+        blit::screen.v_span(blit::Point(5 + progressX, centerH - 5), 10);
+
+        // time
+        formatTime(time, buf, 10);
+        blit::screen.text(buf, blit::minimal_font, blit::Point(5, centerH - 15));
 
-    // play/pause
-    std::string playPauseLabel = musicStream->getPlaying() ? "Pause" : "Play";
-    auto labelLen = blit::screen.measure_text(playPauseLabel, tallFont).w;
-    blit::screen.text(playPauseLabel, tallFont, infoRect, true, blit::top_right);
-    duh::draw_control_icon(&blit::screen, duh::Icon::X, infoRect.tr() - blit::Point(labelLen + 12 + 2, 0));
+        // duration
+        formatTime(durationMs, buf, 10);
+        blit::screen.text(buf, blit::minimal_font, blit::Rect(0, centerH - 15, blit::screen.bounds.w - 5, 10), true, blit::TextAlign::top_right);
 
-    //
-    //blit::screen.text(std::to_string(initTime) + " " + std::to_string(dataSize[0]), blit::minimal_font, blit::Point(0));
+        // volume/ReplayGain
+        blit::screen.text(gainLabel, blit::minimal_font, blit::Rect(0, centerH - 15, blit::screen.bounds.w, 10), true, blit::TextAlign::top_center);
+
+        drawn.progressX = progressX;
+        drawn.timeS = time / 1000;
+        drawn.gainLabel = gainLabel;
+    }
 }
 
 void update(uint32_t time_ms)
@@ -169,35 +520,58 @@ void update(uint32_t time_ms)
     profiler.set_graph_time(profilerUpdateProbe->elapsed_metrics().uMaxElapsedUs);
     blit::ScopedProfilerProbe scopedProbe(profilerUpdateProbe);
 #endif
+    TRACE_THREAD_NAME("Main");
+    TRACE_SCOPE("Update");
 
     static uint32_t lastButtonState = 0;
 
+    // set if another button was used while holding Y, so that releasing Y doesn't also change the ReplayGain mode
+    static bool yChord = false;
+
     fileBrowser.update(time_ms);
 
     // load file
-    if(!fileToLoad.empty() && renderedLoadMessage)
+    if(!fileToLoad.empty() && renderedLoadMessage && (!musicStream || musicStream->getSilent()))
     {
-        auto ext = fileToLoad.substr(fileToLoad.find_last_of('.'));
-        std::for_each(ext.begin(), ext.end(), [](char & c) {c = tolower(c);});
-
-        if(ext == ".mp3" && mp3Stream.load(fileToLoad, true))
-            musicStream = &mp3Stream;
-        else if((ext == ".ogg" || ext == ".oga") && vorbisStream.load(fileToLoad))
-            musicStream = &vorbisStream;
-        else
-            musicStream = nullptr;
+        // by the start of the file, so misnamed files still play
+        musicStream = pipeline.load(fileToLoad) ? &pipeline : nullptr;
 
         if(musicStream)
+        {
+            updateGain();
             musicStream->play(0);
 
+            trackNumber++;
+            buildTrackInfo();
+        }
+
         fileToLoad = "";
     }
 
     if(musicStream)
+    {
+        auto start = blit::now_us();
         musicStream->update();
 
+        avgUpdateUs = (avgUpdateUs * 7 + blit::us_diff(start, blit::now_us())) / 8;
+
+        // the stream ignores its time budget while the buffer is low, give it the time that rendering would use
+        bool bufferLow = musicStream->getPlaying() && musicStream->getBufferedSamples() < SampleRing::lowWater;
+
+        if(avgUpdateUs > visDecodeBudgetUs || bufferLow)
+            visBusy = true;
+        else if(avgUpdateUs < visDecodeBudgetUs * 3 / 4)
+            visBusy = false;
+    }
+
+    // y + x released, toggle stats
+    if((blit::buttons & blit::Button::Y) && (lastButtonState & blit::Button::X) && !(blit::buttons & blit::Button::X))
+    {
+        showStats = !showStats;
+        yChord = true;
+    }
     // x released
-    if(musicStream && (lastButtonState & blit::Button::X) && !(blit::buttons & blit::Button::X))
+    else if(musicStream && (lastButtonState & blit::Button::X) && !(blit::buttons & blit::Button::X))
     {
         if(musicStream->getPlaying())
             musicStream->pause();
@@ -205,5 +579,75 @@ void update(uint32_t time_ms)
             musicStream->play(0);
     }
 
+    // y + a released, cycle output profile (menu is taken by the system menu)
+    if((blit::buttons & blit::Button::Y) && (lastButtonState & blit::Button::A) && !(blit::buttons & blit::Button::A))
+    {
+        settings.outputProfile = (settings.outputProfile + 1) % numOutputProfiles;
+        updateOutputProfile();
+        changeSettings();
+        yChord = true;
+    }
+
+#ifdef TRACE_ENABLED
+    // y + b released, write the trace so far
+    if((blit::buttons & blit::Button::Y) && (lastButtonState & blit::Button::B) && !(blit::buttons & blit::Button::B))
+    {
+        dumpTrace();
+        yChord = true;
+    }
+#endif
+
+    // y released, cycle ReplayGain mode
+    if((lastButtonState & blit::Button::Y) && !(blit::buttons & blit::Button::Y))
+    {
+        if(!yChord)
+        {
+            int mode = (static_cast<int>(settings.replayGainMode) + 1) % static_cast<int>(ReplayGainMode::Count);
+            settings.replayGainMode = static_cast<ReplayGainMode>(mode);
+            changeSettings();
+        }
+
+        yChord = false;
+    }
+
+    // joystick released, cycle visualiser
+    if((lastButtonState & blit::Button::JOYSTICK) && !(blit::buttons & blit::Button::JOYSTICK))
+    {
+        int mode = (static_cast<int>(settings.visualiserMode) + 1) % static_cast<int>(Visualiser::Mode::Count);
+        settings.visualiserMode = static_cast<Visualiser::Mode>(mode);
+        changeSettings();
+    }
+
+    // y + left/right, seek
+    if(blit::buttons & blit::Button::Y)
+    {
+        int seekMs = 0;
+
+        if(!(lastButtonState & blit::Button::DPAD_LEFT) && (blit::buttons & blit::Button::DPAD_LEFT))
+            seekMs = -seekStepMs;
+        else if(!(lastButtonState & blit::Button::DPAD_RIGHT) && (blit::buttons & blit::Button::DPAD_RIGHT))
+            seekMs = seekStepMs;
+
+        if(seekMs && musicStream)
+        {
+            int timeMs = static_cast<uint64_t>(musicStream->getCurrentSample()) * 1000 / 22050;
+            musicStream->seek(timeMs + seekMs);
+        }
+
+        if(seekMs)
+            yChord = true;
+    }
+    // left/right, volume
+    else if(!(lastButtonState & blit::Button::DPAD_LEFT) && (blit::buttons & blit::Button::DPAD_LEFT) && settings.volume > 0)
+    {
+        settings.volume -= 5;
+        changeSettings();
+    }
+    else if(!(lastButtonState & blit::Button::DPAD_RIGHT) && (blit::buttons & blit::Button::DPAD_RIGHT) && settings.volume < 100)
+    {
+        settings.volume += 5;
+        changeSettings();
+    }
+
     lastButtonState = blit::buttons;
 }
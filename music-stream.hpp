@@ -1,26 +1,59 @@
 #pragma once
+#include <cstdint>
 #include <string>
 
+#include "audio-processor.hpp"
 #include "music-tags.hpp"
+#include "quality-governor.hpp"
+#include "stream-stats.hpp"
+#include "waveform.hpp"
 
 class MusicStream
 {
 public:
     virtual ~MusicStream(){}
 
-    //virtual bool load(std::string filename) = 0;
+    // stops anything playing and opens a new file, returns false if it can't be played
+    virtual bool load(std::string filename) = 0;
 
+    // both fade, pause() keeps the position so play() resumes from the same sample
     virtual void play(int channel) = 0;
     virtual void pause() = 0;
 
+    // fades out, jumps once the fade has finished (in update()) and fades back in if it was playing
+    virtual void seek(int ms) = 0;
+
     virtual bool getPlaying() const = 0;
 
+    // nothing is being output, the fade after pause() has finished or the track has ended
+    virtual bool getSilent() const = 0;
+
+    // Q15 gain applied to each decoded block (ReplayGain + volume)
+    virtual void setGain(int32_t gain) = 0;
+
+    // post-decode processing (EQ/dynamics), after the gain. not owned by the stream
+    virtual void setProcessor(AudioProcessor *processor) = 0;
+
+    // QualityMode::Auto (the default) adjusts the decode quality to keep up, anything else fixes it
+    virtual void setQualityMode(QualityMode mode) = 0;
+
     virtual void update() = 0;
 
     virtual int getCurrentSample() const = 0;
+
+    // copy the next samples to be played without consuming them, returns how many were available
+    virtual int peekSamples(int16_t *buf, int count) const = 0;
+
+    // decoded samples waiting to be played, 0 while playing is an underrun
+    virtual int getBufferedSamples() const = 0;
     virtual int getDurationMs() const = 0;
 
     virtual const MusicTags &getTags() const = 0;
 
+    // overview of the whole track, may only be partially filled in the first time it's played
+    virtual const Waveform &getWaveform() const = 0;
+
+    virtual const StreamStats &getStats() const = 0;
+
     virtual bool getFileSupported() const = 0;
 };
\ No newline at end of file
@@ -4,5 +4,14 @@
 struct MusicTags
 {
     std::string album, artist, title, track;
+
+    // ReplayGain, gain in dB, peak as a linear sample scale (1.0 = full scale)
+    bool hasTrackGain = false, hasAlbumGain = false;
+    float trackGain = 0.0f, trackPeak = 0.0f;
+    float albumGain = 0.0f, albumPeak = 0.0f;
+
+    // from a previous play, for files without ReplayGain tags
+    bool hasMeasuredLoudness = false;
+    float measuredLoudness = 0.0f, measuredPeak = 0.0f; // LUFS, linear
     //...
 };
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cstring>
+
+#include "qoa-stream.hpp"
+#include "stream-registry.hpp"
+
+#include "trace.hpp"
+
+// round((sf + 1) ^ 2.75) * {0.75, -0.75, 2.5, -2.5, 4.5, -4.5, 7, -7}
+static const int32_t dequantTable[16][8]
+{
+    {   1,    -1,    3,    -3,    5,    -5,     7,     -7},
+    {   5,    -5,   18,   -18,   32,   -32,    49,    -49},
+    {  16,   -16,   53,   -53,   95,   -95,   147,   -147},
+    {  34,   -34,  113,  -113,  203,  -203,   315,   -315},
+    {  63,   -63,  210,  -210,  378,  -378,   588,   -588},
+    { 104,  -104,  345,  -345,  621,  -621,   966,   -966},
+    { 158,  -158,  528,  -528,  950,  -950,  1477,  -1477},
+    { 228,  -228,  760,  -760, 1368, -1368,  2128,  -2128},
+    { 316,  -316, 1053, -1053, 1895, -1895,  2947,  -2947},
+    { 422,  -422, 1405, -1405, 2529, -2529,  3934,  -3934},
+    { 548,  -548, 1828, -1828, 3290, -3290,  5117,  -5117},
+    { 696,  -696, 2320, -2320, 4176, -4176,  6496,  -6496},
+    { 868,  -868, 2893, -2893, 5207, -5207,  8099,  -8099},
+    {1064, -1064, 3548, -3548, 6386, -6386,  9933,  -9933},
+    {1286, -1286, 4288, -4288, 7718, -7718, 12005, -12005},
+    {1536, -1536, 5120, -5120, 9216, -9216, 14336, -14336},
+};
+
+static uint32_t getUint16(const uint8_t *buf)
+{
+    return buf[0] << 8 | buf[1];
+}
+
+static uint32_t getUint32(const uint8_t *buf)
+{
+    return static_cast<uint32_t>(buf[0]) << 24 | buf[1] << 16 | buf[2] << 8 | buf[3];
+}
+
+static uint64_t getUint64(const uint8_t *buf)
+{
+    return static_cast<uint64_t>(getUint32(buf)) << 32 | getUint32(buf + 4);
+}
+
+bool QoaStream::probe(const uint8_t *header, int length)
+{
+    return length >= 8 && memcmp(header, "qoaf", 4) == 0;
+}
+
+static StreamRegistry::Format format("QOA", {".qoa"}, &QoaStream::probe, []() -> AudioDecoder & {static QoaStream decoder; return decoder;});
+
+bool QoaStream::open(const std::string &filename, SourceInfo &info, MusicTags &tags)
+{
+    frameSize = 0;
+    sliceCount = slicePos = 0;
+
+    if(!file.open(filename))
+        return false;
+
+    // file header and the first frame header
+    uint8_t buf[16];
+    if(file.read(0, 16, reinterpret_cast<char *>(buf)) != 16 || memcmp(buf, "qoaf", 4) != 0)
+        return false;
+
+    totalSamples = getUint32(buf + 4);
+    channels = buf[8];
+    sampleRate = buf[9] << 16 | getUint16(buf + 10);
+
+    if(!channels || channels > maxChannels || !sampleRate)
+        return false;
+
+    frameSize = 8 + channels * (16 + slicesPerFrame * 8);
+    fileOffset = 8;
+
+    // streaming files don't have the length
+    info.sampleRate = sampleRate;
+    info.channels = info.blockChannels = channels;
+    info.totalFrames = totalSamples;
+    info.fileLength = file.get_length();
+
+    // cheaper than anything but PCM, about 5 multiply-adds per sample
+    info.cost = QualityGovernor::estimateCost(0.15f, sampleRate, channels, 0);
+
+    file.resetStats();
+
+    return true;
+}
+
+int QoaStream::decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels)
+{
+    if(slicePos == sliceCount && !readFrame())
+        return 0;
+
+    // whole slices, there's always space for at least one
+    int count = std::min(sliceCount - slicePos, maxFrames / sliceLen);
+    int frames = std::min(count * sliceLen, frameSamples - slicePos * sliceLen);
+
+    decodeSlices(count, out);
+
+    blockChannels = channels;
+    return frames;
+}
+
+uint64_t QoaStream::seek(int ms)
+{
+    // every frame but the last has the same number of samples and size, so the frame is found directly
+    // and the slices before the target are decoded to get the predictor state
+    uint32_t target = std::min(static_cast<uint64_t>(ms) * sampleRate / 1000, uint64_t(totalSamples));
+    uint32_t frame = target / frameLen;
+
+    fileOffset = 8 + frame * frameSize;
+    sliceCount = slicePos = 0;
+
+    int skipSlices = (target % frameLen) / sliceLen;
+
+    if(readFrame())
+    {
+        int16_t skipBuf[sliceLen * maxChannels];
+
+        while(slicePos < std::min(skipSlices, sliceCount))
+            decodeSlices(1, skipBuf);
+    }
+
+    return static_cast<uint64_t>(frame) * frameLen + slicePos * sliceLen;
+}
+
+uint32_t QoaStream::getInputPos() const
+{
+    return fileOffset;
+}
+
+const StreamFile &QoaStream::getFile() const
+{
+    return file;
+}
+
+bool QoaStream::readFrame()
+{
+    TRACE_SCOPE("Read");
+
+    auto read = file.read(fileOffset, frameSize, reinterpret_cast<char *>(frameData));
+
+    if(read < 8 + channels * 16)
+        return false;
+
+    // the format can change between frames in a streaming file, which isn't supported
+    int frameChannels = frameData[0];
+    uint32_t size = getUint16(frameData + 6);
+    frameSamples = getUint16(frameData + 4);
+
+    if(frameChannels != channels || size > uint32_t(read) || !frameSamples || frameSamples > frameLen)
+        return false;
+
+    sliceCount = (frameSamples + sliceLen - 1) / sliceLen;
+    slicePos = 0;
+
+    if(size < 8 + channels * (16 + sliceCount * 8u))
+        return false;
+
+    for(int c = 0; c < channels; c++)
+    {
+        auto lmsData = frameData + 8 + c * 16;
+
+        for(int i = 0; i < 4; i++)
+        {
+            lms[c].history[i] = static_cast<int16_t>(getUint16(lmsData + i * 2));
+            lms[c].weights[i] = static_cast<int16_t>(getUint16(lmsData + 8 + i * 2));
+        }
+    }
+
+    fileOffset += size;
+
+    return true;
+}
+
+void QoaStream::decodeSlices(int count, int16_t *out)
+{
+    auto sliceData = frameData + 8 + channels * 16;
+
+    for(int s = slicePos; s < slicePos + count; s++)
+    {
+        // the last slice may be short
+        int sliceSamples = std::min(sliceLen, frameSamples - s * sliceLen);
+
+        for(int c = 0; c < channels; c++)
+        {
+            uint64_t slice = getUint64(sliceData + (s * channels + c) * 8);
+            auto table = dequantTable[slice >> 60];
+            auto &state = lms[c];
+
+            auto sliceOut = out + (s - slicePos) * sliceLen * channels + c;
+
+            for(int i = 0; i < sliceSamples; i++)
+            {
+                int32_t predicted = (state.history[0] * state.weights[0] + state.history[1] * state.weights[1] +
+                                     state.history[2] * state.weights[2] + state.history[3] * state.weights[3]) >> 13;
+
+                int32_t residual = table[(slice >> (57 - i * 3)) & 7];
+                int32_t sample = std::min(std::max(predicted + residual, -32768), 32767);
+
+                *sliceOut = sample;
+                sliceOut += channels;
+
+                // update the predictor
+                int32_t delta = residual >> 4;
+                for(int j = 0; j < 4; j++)
+                    state.weights[j] += state.history[j] < 0 ? -delta : delta;
+
+                state.history[0] = state.history[1];
+                state.history[1] = state.history[2];
+                state.history[2] = state.history[3];
+                state.history[3] = sample;
+            }
+        }
+    }
+
+    slicePos += count;
+}
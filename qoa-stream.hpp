@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+
+#include "stream-file.hpp"
+
+#include "audio-decoder.hpp"
+#include "music-tags.hpp"
+
+// QOA (Quite OK Audio), a few integer operations per sample and fixed size frames
+class QoaStream final : public AudioDecoder
+{
+public:
+    bool open(const std::string &filename, SourceInfo &info, MusicTags &tags);
+
+    // looks at the start of a file, for StreamRegistry
+    static bool probe(const uint8_t *header, int length);
+
+    int decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels);
+
+    uint64_t seek(int ms);
+
+    uint32_t getInputPos() const;
+    const StreamFile &getFile() const;
+
+private:
+    // reads the frame at fileOffset, returns false at the end of the file
+    bool readFrame();
+
+    // decodes count slices of every channel from slicePos, interleaved
+    void decodeSlices(int count, int16_t *out);
+
+    StreamFile file;
+    uint32_t fileOffset = 0; // of the next frame
+
+    // format, from the file/first frame header
+    static const int maxChannels = 2;
+    int channels = 0, sampleRate = 0;
+    uint32_t totalSamples = 0; // per channel, 0 if unknown
+
+    // every frame but the last is this size
+    static const int sliceLen = 20;
+    static const int slicesPerFrame = 256;
+    static const int frameLen = sliceLen * slicesPerFrame;
+    uint32_t frameSize = 0;
+
+    struct LMS
+    {
+        int32_t history[4];
+        int32_t weights[4];
+    };
+
+    // the current frame
+    static const int maxFrameSize = 8 + maxChannels * (16 + slicesPerFrame * 8);
+    uint8_t frameData[maxFrameSize];
+    LMS lms[maxChannels];
+    int frameSamples = 0;
+    int sliceCount = 0, slicePos = 0;
+};
@@ -0,0 +1,134 @@
+#include "quality-governor.hpp"
+#include "sample-ring.hpp"
+
+// decode time in each mode relative to Full, for stereo 44100Hz sources (measured with decode-bench --quality)
+static const float modeCost[]
+{
+    1.0f,  // Full
+    0.8f,  // Mono
+    0.75f, // HalfBandwidth
+    0.7f,  // CheapResampler
+};
+
+// tracks that are estimated to cost more than this start in a cheaper mode
+static const float maxStartCost = 4.5f;
+
+// step down if decoding takes more of the time than this...
+static const float stepDownLoad = 0.5f;
+// ...step back up if the next mode up would take less than this
+static const float stepUpLoad = 0.3f;
+
+// output samples to wait after a change before changing again
+static const uint32_t stepDownDelay = 22050 / 2;
+static const uint32_t stepUpDelay = 22050 * 5;
+
+const char *getQualityModeName(QualityMode mode)
+{
+    switch(mode)
+    {
+        case QualityMode::Full:
+            return "Full";
+        case QualityMode::Mono:
+            return "Mono";
+        case QualityMode::HalfBandwidth:
+            return "Half bandwidth";
+        case QualityMode::CheapResampler:
+            return "Cheap resampler";
+        case QualityMode::Auto:
+            return "Auto";
+    }
+
+    return "";
+}
+
+float QualityGovernor::estimateCost(float codecCost, int sourceRate, int channels, int bitrateKbps)
+{
+    // the second channel is cheaper than the first (shared bitstream parsing)
+    float cost = codecCost * sourceRate / 22050.0f * (channels > 1 ? 0.6f + channels * 0.4f : 1.0f);
+
+    // more bits to unpack
+    if(bitrateKbps > 128)
+        cost *= 1.0f + (bitrateKbps - 128) / 512.0f;
+
+    return cost;
+}
+
+void QualityGovernor::setMode(QualityMode mode)
+{
+    automatic = mode == QualityMode::Auto;
+
+    if(!automatic)
+        this->mode = mode;
+}
+
+void QualityGovernor::reset(float estimatedCost)
+{
+    load = 0.0f;
+    samplesSinceChange = 0;
+
+    if(!automatic)
+        return;
+
+    // cheapest mode if nothing is good enough
+    int newMode = 0;
+    while(newMode < int(QualityMode::Count) - 1 && estimatedCost * modeCost[newMode] > maxStartCost)
+        newMode++;
+
+    mode = QualityMode(newMode);
+}
+
+void QualityGovernor::addBlock(uint32_t decodeUs, int samples)
+{
+    if(samples <= 0)
+        return;
+
+    float blockLoad = decodeUs * 22050.0f / (samples * 1000000.0f);
+    load += (blockLoad - load) / 16.0f;
+
+    samplesSinceChange += samples;
+}
+
+bool QualityGovernor::update(int bufferedSamples)
+{
+    if(!automatic)
+        return false;
+
+    int curMode = int(mode);
+
+    // running out of buffer or struggling to keep up
+    if(curMode < int(QualityMode::Count) - 1 && samplesSinceChange >= stepDownDelay
+    && (bufferedSamples < SampleRing::lowWater || load > stepDownLoad))
+    {
+        changeMode(curMode + 1);
+        return true;
+    }
+
+    // plenty of time to spare
+    if(curMode > 0 && samplesSinceChange >= stepUpDelay && bufferedSamples >= SampleRing::lowWater
+    && load / modeCost[curMode] * modeCost[curMode - 1] < stepUpLoad)
+    {
+        changeMode(curMode - 1);
+        return true;
+    }
+
+    return false;
+}
+
+QualityMode QualityGovernor::getMode() const
+{
+    return mode;
+}
+
+bool QualityGovernor::getAutomatic() const
+{
+    return automatic;
+}
+
+void QualityGovernor::changeMode(int newMode)
+{
+    // expected load in the new mode, until it's been measured
+    load = load / modeCost[int(mode)] * modeCost[newMode];
+
+    mode = QualityMode(newMode);
+    samplesSinceChange = 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+
+// each mode is cheaper to decode than the one before it, and includes its savings
+enum class QualityMode : uint8_t
+{
+    Full = 0,
+    Mono,           // downmix before the MP3 synthesis/Vorbis IMDCT and only run it once
+    HalfBandwidth,  // skip the IMDCT for the upper half of the MP3 subbands, the same as Mono for Vorbis
+    CheapResampler, // nearest sample instead of averaging
+
+    Count,
+
+    Auto = Count // for setQualityMode, let the governor decide
+};
+
+const char *getQualityModeName(QualityMode mode);
+
+// picks the decode quality for a track, starting from an estimate and adjusting it from the measured decode time and buffer level
+class QualityGovernor final
+{
+public:
+    // relative cost of decoding a track at full quality, 22050Hz mono 128kbps MP3 is 1
+    // codecCost is the cost of the codec relative to MP3
+    static float estimateCost(float codecCost, int sourceRate, int channels, int bitrateKbps);
+
+    // Auto to adjust automatically, anything else to fix the mode
+    void setMode(QualityMode mode);
+
+    // start of a track
+    void reset(float estimatedCost);
+
+    // a decoded block of output samples
+    void addBlock(uint32_t decodeUs, int samples);
+
+    // once per update, with the samples that were waiting to be played before refilling. returns true if the mode changed
+    bool update(int bufferedSamples);
+
+    QualityMode getMode() const;
+    bool getAutomatic() const;
+
+private:
+    void changeMode(int newMode);
+
+    bool automatic = true;
+    QualityMode mode = QualityMode::Full;
+
+    // fraction of real time spent decoding, averaged over recent blocks
+    float load = 0.0f;
+
+    // output samples decoded since the last change
+    uint32_t samplesSinceChange = 0;
+};
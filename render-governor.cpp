@@ -0,0 +1,93 @@
+#include "render-governor.hpp"
+#include "sample-ring.hpp"
+
+// time between renders in each mode, 0 for every frame
+static const uint32_t modeIntervalMs[]
+{
+    0,   // Full
+    100, // Idle
+    250, // Throttled
+};
+
+// no input for this long while playing is idle
+static const uint32_t idleDelayMs = 3000;
+
+// throttle below the low water mark, until the buffer has recovered to twice that
+static const int throttleSamples = SampleRing::lowWater;
+static const int recoverSamples = SampleRing::lowWater * 2;
+
+const char *RenderGovernor::getModeName(Mode mode)
+{
+    switch(mode)
+    {
+        case Mode::Full:
+            return "Full";
+        case Mode::Idle:
+            return "Idle";
+        case Mode::Throttled:
+            return "Throttled";
+        case Mode::Count:
+            break;
+    }
+
+    return "";
+}
+
+bool RenderGovernor::update(uint32_t time, bool input, bool playing, int bufferedSamples)
+{
+    if(input)
+        lastInputTime = time;
+
+    auto newMode = Mode::Full;
+
+    if(playing && (bufferedSamples < throttleSamples || (mode == Mode::Throttled && bufferedSamples < recoverSamples)))
+        newMode = Mode::Throttled;
+    else if(playing && !input && time - lastInputTime >= idleDelayMs)
+        newMode = Mode::Idle;
+
+    if(newMode != mode)
+        changeMode(newMode, time);
+
+    // back to full rate straight away on input
+    if(!rendered || time - lastRenderTime >= getInterval() || (input && mode != Mode::Throttled))
+    {
+        lastRenderTime = time;
+        rendered = true;
+        return true;
+    }
+
+    skippedFrames++;
+    return false;
+}
+
+RenderGovernor::Mode RenderGovernor::getMode() const
+{
+    return mode;
+}
+
+uint32_t RenderGovernor::getInterval() const
+{
+    return modeIntervalMs[int(mode)];
+}
+
+uint32_t RenderGovernor::getChanges() const
+{
+    return changes;
+}
+
+uint32_t RenderGovernor::getLastChangeTime() const
+{
+    return lastChangeTime;
+}
+
+uint32_t RenderGovernor::getSkippedFrames() const
+{
+    return skippedFrames;
+}
+
+void RenderGovernor::changeMode(Mode newMode, uint32_t time)
+{
+    mode = newMode;
+    changes++;
+    lastChangeTime = time;
+}
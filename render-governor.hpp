@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+// lowers the render rate while nobody is looking at the screen, or while the decoder needs the time more
+class RenderGovernor final
+{
+public:
+    enum class Mode : uint8_t
+    {
+        Full = 0,  // every frame
+        Idle,      // playing with no input for a while
+        Throttled, // the buffer is running low
+
+        Count
+    };
+
+    static const char *getModeName(Mode mode);
+
+    // once per frame, returns false if this frame shouldn't be rendered
+    bool update(uint32_t time, bool input, bool playing, int bufferedSamples);
+
+    Mode getMode() const;
+    uint32_t getInterval() const;
+
+    // for the stats overlay
+    uint32_t getChanges() const;
+    uint32_t getLastChangeTime() const;
+    uint32_t getSkippedFrames() const;
+
+private:
+    void changeMode(Mode newMode, uint32_t time);
+
+    Mode mode = Mode::Full;
+
+    uint32_t lastInputTime = 0;
+    uint32_t lastRenderTime = 0;
+    bool rendered = false;
+
+    uint32_t changes = 0, lastChangeTime = 0;
+    uint32_t skippedFrames = 0;
+};
@@ -0,0 +1,148 @@
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "replay-gain.hpp"
+
+// +6dB, any more and sample * gain can overflow
+static const int32_t maxGain = unityGain * 2;
+
+// ReplayGain 2.0 reference level, for measured loudness
+static const float referenceLoudness = -18.0f;
+
+// the soft clip knee doesn't go below 0.75 full scale, so the largest gains can still hard clip the peaks
+static const int32_t minClipKnee = 24576;
+
+// quadratic from the knee (slope 1) to the largest gained sample (slope 0), which lands on full scale
+static inline int16_t softClip(int32_t v, int32_t knee, int32_t kneeLen)
+{
+    if(v > knee)
+    {
+        int64_t over = v - knee;
+        int64_t clipped = v - over * over / (kneeLen * 2);
+        return clipped > 32767 ? 32767 : clipped;
+    }
+    else if(v < -knee)
+    {
+        int64_t over = -knee - v;
+        int64_t clipped = v + over * over / (kneeLen * 2);
+        return clipped < -32768 ? -32768 : clipped;
+    }
+
+    return v;
+}
+
+static bool equalsIgnoreCase(const std::string &a, const char *b)
+{
+    auto len = strlen(b);
+
+    if(a.length() != len)
+        return false;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        if(toupper(a[i]) != toupper(b[i]))
+            return false;
+    }
+
+    return true;
+}
+
+const char *getReplayGainModeName(ReplayGainMode mode)
+{
+    switch(mode)
+    {
+        case ReplayGainMode::Off:
+            return "Off";
+        case ReplayGainMode::Track:
+            return "Track";
+        case ReplayGainMode::Album:
+            return "Album";
+        default:
+            return "?";
+    }
+}
+
+bool parseReplayGainTag(const std::string &key, const char *value, MusicTags &tags)
+{
+    // keys are case-insensitive in both Vorbis comments and (in practice) TXXX
+    // value is something like "-6.50 dB", strtof stops at the unit
+    if(equalsIgnoreCase(key, "REPLAYGAIN_TRACK_GAIN"))
+    {
+        tags.trackGain = strtof(value, nullptr);
+        tags.hasTrackGain = true;
+    }
+    else if(equalsIgnoreCase(key, "REPLAYGAIN_TRACK_PEAK"))
+        tags.trackPeak = strtof(value, nullptr);
+    else if(equalsIgnoreCase(key, "REPLAYGAIN_ALBUM_GAIN"))
+    {
+        tags.albumGain = strtof(value, nullptr);
+        tags.hasAlbumGain = true;
+    }
+    else if(equalsIgnoreCase(key, "REPLAYGAIN_ALBUM_PEAK"))
+        tags.albumPeak = strtof(value, nullptr);
+    else
+        return false;
+
+    return true;
+}
+
+int32_t calcReplayGain(const MusicTags &tags, ReplayGainMode mode, int volume)
+{
+    float gainDb = 0.0f, peak = 0.0f;
+
+    // album mode falls back to track gain if that's all we have, then to a measured gain
+    if(mode == ReplayGainMode::Album && tags.hasAlbumGain)
+    {
+        gainDb = tags.albumGain;
+        peak = tags.albumPeak;
+    }
+    else if(mode != ReplayGainMode::Off && tags.hasTrackGain)
+    {
+        gainDb = tags.trackGain;
+        peak = tags.trackPeak;
+    }
+    else if(mode != ReplayGainMode::Off && tags.hasMeasuredLoudness)
+    {
+        gainDb = referenceLoudness - tags.measuredLoudness;
+        peak = tags.measuredPeak;
+    }
+
+    float scale = powf(10.0f, gainDb / 20.0f) * volume / 100.0f;
+
+    // clip prevention
+    if(peak > 0.0f && scale * peak > 1.0f)
+        scale = 1.0f / peak;
+
+    auto gain = static_cast<int32_t>(scale * unityGain + 0.5f);
+
+    return gain > maxGain ? maxGain : gain;
+}
+
+void applyGain(int16_t *samples, int count, int32_t gain)
+{
+    if(gain == unityGain)
+        return;
+
+    auto end = samples + count;
+
+    if(gain < unityGain)
+    {
+        // can't clip, just scale
+        for(; samples != end; samples++)
+            *samples = (*samples * gain) >> 15;
+
+        return;
+    }
+
+    // only the samples that would go over full scale are squashed, so a small gain barely touches the peaks
+    int32_t peak = 32767 + (gain - unityGain);
+    int32_t knee = 2 * 32767 - peak;
+
+    if(knee < minClipKnee)
+        knee = minClipKnee;
+
+    for(; samples != end; samples++)
+        *samples = softClip((*samples * gain) >> 15, knee, peak - knee);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "music-tags.hpp"
+
+enum class ReplayGainMode : uint8_t
+{
+    Off = 0,
+    Track,
+    Album,
+
+    Count
+};
+
+// Q15, 0x8000 = 1.0
+static const int32_t unityGain = 0x8000;
+
+const char *getReplayGainModeName(ReplayGainMode mode);
+
+// parses REPLAYGAIN_(TRACK|ALBUM)_(GAIN|PEAK), returns false for any other key
+bool parseReplayGainTag(const std::string &key, const char *value, MusicTags &tags);
+
+// combined ReplayGain and volume (0-100) gain, limited by the peak if there is one
+// untagged files use the measured loudness if available
+int32_t calcReplayGain(const MusicTags &tags, ReplayGainMode mode, int volume);
+
+// scale a block of samples, anything that would be pushed over full scale is soft clipped
+void applyGain(int16_t *samples, int count, int32_t gain);
@@ -0,0 +1,102 @@
+#include "resampler.hpp"
+
+void Resampler::reset(int sourceRate)
+{
+    step = (static_cast<int64_t>(sourceRate) << 16) / 22050;
+    restart();
+}
+
+void Resampler::restart()
+{
+    remaining = step;
+    sum = sumCount = 0;
+    phase = 0;
+    prev = 0;
+}
+
+int Resampler::process(const int16_t *in, int frames, int channels, int16_t *out, Mode mode)
+{
+    int outCount = 0;
+
+    // averaging needs at least one source sample per output sample
+    if(mode == Mode::Average && step < one)
+        mode = Mode::Linear;
+
+    // nearest only drops samples, when upsampling it has to repeat them (which is the same loop as linear)
+    if(mode == Mode::Linear || (mode == Mode::Nearest && step < one))
+    {
+        for(int i = 0; i < frames; i++, in += channels)
+        {
+            int32_t sample = in[0];
+            for(int c = 1; c < channels; c++)
+                sample += in[c];
+
+            sample /= channels;
+
+            if(mode == Mode::Nearest)
+            {
+                for(; phase < one; phase += step)
+                    out[outCount++] = phase < one / 2 ? prev : sample;
+            }
+            else
+            {
+                for(; phase < one; phase += step)
+                    out[outCount++] = prev + (((sample - prev) * phase) >> 16);
+            }
+
+            phase -= one;
+            prev = sample;
+        }
+
+        return outCount;
+    }
+
+    for(int i = 0; i < frames; i++, in += channels)
+    {
+        if(mode == Mode::Average)
+        {
+            for(int c = 0; c < channels; c++)
+                sum += in[c];
+
+            sumCount += channels;
+        }
+
+        remaining -= one;
+
+        if(remaining > 0)
+            continue;
+
+        remaining += step;
+
+        if(mode == Mode::Average)
+        {
+            out[outCount++] = sum / sumCount;
+            sum = sumCount = 0;
+        }
+        else
+        {
+            int32_t sample = in[0];
+            for(int c = 1; c < channels; c++)
+                sample += in[c];
+
+            out[outCount++] = sample / channels;
+        }
+    }
+
+    return outCount;
+}
+
+int Resampler::getMaxOutput(int frames) const
+{
+    return (static_cast<int64_t>(frames) << 16) / step + 1;
+}
+
+int Resampler::getMaxInput(int maxOutput) const
+{
+    return (static_cast<int64_t>(maxOutput - 1) * step) >> 16;
+}
+
+bool Resampler::isPassthrough() const
+{
+    return step == one;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+
+// converts decoded audio to the 22050Hz mono that the player outputs, keeping state between blocks
+class Resampler final
+{
+public:
+    enum class Mode : uint8_t
+    {
+        Average, // mean of all the source samples covering each output sample, for downsampling
+        Linear,  // interpolated, for upsampling
+        Nearest, // cheapest, the closest source frame for each output sample
+    };
+
+    void reset(int sourceRate);
+
+    // drops anything carried over from the last block, after seeking
+    void restart();
+
+    // interleaved input, all channels are mixed. returns the number of samples written to out
+    // in and out can be the same buffer when downsampling
+    int process(const int16_t *in, int frames, int channels, int16_t *out, Mode mode);
+
+    // most output samples for an input block
+    int getMaxOutput(int frames) const;
+
+    // most input frames that can't produce more than maxOutput samples
+    int getMaxInput(int maxOutput) const;
+
+    // 22050Hz, nothing to do for mono
+    bool isPassthrough() const;
+
+private:
+    static const int32_t one = 1 << 16;
+
+    int32_t step = one; // source frames per output sample, 16.16
+
+    // Average/Nearest, how much of the current output sample is left and what's been added up for it so far
+    int32_t remaining = one;
+    int32_t sum = 0;
+    int sumCount = 0;
+
+    // Linear, position of the next output sample after the previous frame
+    int32_t phase = 0;
+    int32_t prev = 0;
+};
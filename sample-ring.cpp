@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstring>
+
+#include "sample-ring.hpp"
+
+void SampleRing::reset()
+{
+    readPos = 0;
+    writePos = 0;
+}
+
+int SampleRing::getFilled() const
+{
+    return writePos - readPos;
+}
+
+int SampleRing::getFree() const
+{
+    return size - getFilled();
+}
+
+bool SampleRing::wantBlock(uint32_t elapsedUs) const
+{
+    int filled = getFilled();
+
+    if(filled >= highWater)
+        return false;
+
+    // running low, keep going whatever it costs
+    if(filled < lowWater)
+        return true;
+
+    return elapsedUs < decodeBudgetUs;
+}
+
+bool SampleRing::write(const int16_t *samples, int count)
+{
+    if(count > getFree())
+        return false;
+
+    uint32_t pos = writePos;
+    int offset = pos & (size - 1);
+    int first = std::min(count, size - offset);
+
+    memcpy(data + offset, samples, first * sizeof(int16_t));
+    memcpy(data, samples + first, (count - first) * sizeof(int16_t));
+
+    // publish after the data is written
+    writePos = pos + count;
+
+    return true;
+}
+
+int16_t *SampleRing::beginWrite(int &count)
+{
+    int offset = writePos & (size - 1);
+    count = std::min(getFree(), size - offset);
+
+    return data + offset;
+}
+
+void SampleRing::endWrite(int count)
+{
+    writePos = writePos + count;
+}
+
+int SampleRing::read(int16_t *samples, int count)
+{
+    uint32_t pos = readPos;
+    count = std::min(count, static_cast<int>(writePos - pos));
+
+    copyOut(pos, samples, count);
+
+    readPos = pos + count;
+
+    return count;
+}
+
+int SampleRing::peek(int16_t *samples, int count) const
+{
+    // the callback may move on while this is copying, which just makes the samples slightly stale
+    // (only update() writes, and that doesn't happen at the same time as this)
+    uint32_t pos = readPos;
+    count = std::min(count, static_cast<int>(writePos - pos));
+
+    copyOut(pos, samples, count);
+
+    return count;
+}
+
+void SampleRing::copyOut(uint32_t pos, int16_t *samples, int count) const
+{
+    int offset = pos & (size - 1);
+    int first = std::min(count, size - offset);
+
+    memcpy(samples, data + offset, first * sizeof(int16_t));
+    memcpy(samples + first, data, (count - first) * sizeof(int16_t));
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// decoded samples on their way from update() to the audio callback
+// one writer and one reader, the positions are atomic as the callback runs in an interrupt (or the SDL audio thread)
+class SampleRing final
+{
+public:
+    static const int size = 8192; // must be a power of two
+
+    // the most that a stream writes at once
+    static const int maxBlock = 2048;
+
+    // update() stops decoding above this...
+    static const int highWater = size - maxBlock;
+    // ...or when it has used this much time, unless the ring is below this
+    static const uint32_t decodeBudgetUs = 2000;
+    static const int lowWater = size / 4;
+    // play() starts as soon as there's enough for the first audio callback, update() fills the rest
+    static const int startLevel = 64;
+
+    // only while nothing is reading
+    void reset();
+
+    int getFilled() const;
+    int getFree() const;
+
+    // whether update() should decode another block after spending elapsedUs decoding
+    bool wantBlock(uint32_t elapsedUs) const;
+
+    // all or nothing, returns false if there isn't space
+    bool write(const int16_t *samples, int count);
+
+    // for decoding straight into the ring, the free space after the write position (up to the end of the buffer)
+    int16_t *beginWrite(int &count);
+    // makes count samples written to beginWrite()'s buffer readable
+    void endWrite(int count);
+
+    // returns how many were read
+    int read(int16_t *samples, int count);
+
+    // copy the oldest samples without consuming them
+    int peek(int16_t *samples, int count) const;
+
+private:
+    void copyOut(uint32_t pos, int16_t *samples, int count) const;
+
+    int16_t data[size];
+
+    // free-running, wrapped when accessing data
+    std::atomic<uint32_t> readPos{0}, writePos{0};
+};
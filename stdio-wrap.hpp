@@ -1,18 +1,22 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
 #include <cstdio> // make sure stdio isn't included after this
 
-#include "engine/file.hpp"
+#include "stream-file.hpp"
 
-// wrap stdio funcs around blit:: funcs
+// wrap stdio funcs around blit:: funcs (through StreamFile)
 
 struct wrap_FILE
 {
-    blit::File file;
+    StreamFile file;
     uint32_t offset;
 
     uint8_t getc_buffer[512];
     int getc_buf_len, getc_buf_off;
+
+    // for stats, refills are misses
+    uint32_t getc_calls, getc_refills;
 };
 
 inline wrap_FILE *wrap_fopen(const char *filename, const char *mode)
@@ -23,6 +27,7 @@ inline wrap_FILE *wrap_fopen(const char *filename, const char *mode)
     ret->offset = 0;
 
     ret->getc_buf_len = ret->getc_buf_off = 0;
+    ret->getc_calls = ret->getc_refills = 0;
 
     if(!ret->file.is_open())
     {
@@ -56,19 +61,33 @@ inline size_t wrap_fread(void *buffer, size_t size, size_t count, wrap_FILE *fil
         file->getc_buf_off = file->getc_buf_len = 0;
     }
 
-    auto ret = file->file.read(file->offset, size * count, (char *)buffer);
-    file->offset += ret;
+    // keep going after a short read, like stdio would
+    uint32_t total = 0, length = size * count;
+
+    while(total < length)
+    {
+        auto ret = file->file.read(file->offset, length - total, (char *)buffer + total);
+
+        if(ret <= 0)
+            break;
 
-    return ret < 0 ? 0 : ret / size;
+        file->offset += ret;
+        total += ret;
+    }
+
+    return total / size;
 }
 
 inline int wrap_fgetc(wrap_FILE *file)
 {
+    file->getc_calls++;
+
     // refill getc buffer
     if(file->getc_buf_off >= file->getc_buf_len)
     {
+        file->getc_refills++;
         file->offset += file->getc_buf_off;
-        file->getc_buf_len = file->file.read(file->offset, 512, (char*)file->getc_buffer);
+        file->getc_buf_len = std::max(file->file.read(file->offset, 512, (char*)file->getc_buffer), int32_t(0));
         file->getc_buf_off = 0;
     }
 
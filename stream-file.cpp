@@ -0,0 +1,8 @@
+#include "stream-file.hpp"
+
+FileBackend *StreamFile::backend = nullptr;
+
+void StreamFile::setBackend(FileBackend *backend)
+{
+    StreamFile::backend = backend;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "engine/engine.hpp"
+#include "engine/file.hpp"
+
+#include "trace.hpp"
+
+// blit::File for the streams, reads can be redirected through a backend to add latency/faults or log them
+
+class FileBackend
+{
+public:
+    virtual ~FileBackend() = default;
+
+    // called for every stream read instead of reading the file directly
+    virtual int32_t read(blit::File &file, uint32_t offset, uint32_t length, char *buffer) = 0;
+};
+
+class StreamFile final
+{
+public:
+    StreamFile() = default;
+    StreamFile(const std::string &filename) {open(filename);}
+
+    bool open(const std::string &filename)
+    {
+        resetStats();
+        return file.open(filename);
+    }
+
+    void close() {file.close();}
+
+    int32_t read(uint32_t offset, uint32_t length, char *buffer)
+    {
+        TRACE_SCOPE("File read");
+
+        auto start = blit::now_us();
+        int32_t ret;
+
+        // an SD card can fail the odd read, the streams would take that as the end of the file
+        for(int attempt = 0;; attempt++)
+        {
+            ret = backend ? backend->read(file, offset, length, buffer) : file.read(offset, length, buffer);
+            reads++;
+
+            if(ret >= 0 || attempt == maxRetries)
+                break;
+        }
+
+        if(ret > 0)
+            bytesRead += ret;
+
+        readUs += blit::us_diff(start, blit::now_us());
+
+        return ret;
+    }
+
+    uint32_t get_length() {return file.get_length();}
+    bool is_open() const {return file.is_open();}
+
+    // since the file was opened or resetStats was called, for the stats overlay
+    uint32_t getReads() const {return reads;}
+    uint32_t getBytesRead() const {return bytesRead;}
+    uint32_t getReadUs() const {return readUs;}
+
+    void resetStats() {reads = bytesRead = readUs = 0;}
+
+    // used by every stream, nullptr to read directly
+    static void setBackend(FileBackend *backend);
+
+private:
+    static const int maxRetries = 3;
+
+    blit::File file;
+
+    uint32_t reads = 0, bytesRead = 0, readUs = 0;
+
+    static FileBackend *backend;
+};
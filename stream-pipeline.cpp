@@ -0,0 +1,356 @@
+#include <algorithm>
+
+#include "stream-pipeline.hpp"
+#include "replay-gain.hpp"
+#include "stream-registry.hpp"
+
+#include "engine/engine.hpp"
+#include "trace.hpp"
+
+#ifdef PROFILER
+#include "engine/profiler.hpp"
+extern blit::ProfilerProbe *profilerRefillProbe;
+extern blit::ProfilerProbe *profilerReadProbe;
+extern blit::ProfilerProbe *profilerDecProbe;
+#endif
+
+bool StreamPipeline::load(std::string filename)
+{
+    sink.reset();
+    seekPending = false;
+    supported = true;
+
+    if(processor)
+        processor->reset();
+
+    tags = MusicTags();
+    info = AudioDecoder::SourceInfo();
+
+    // by the start of the file, so misnamed files still play
+    decoder = StreamRegistry::findDecoder(filename);
+
+    if(!decoder || !decoder->open(filename, info, tags))
+    {
+        decoder = nullptr;
+        return false;
+    }
+
+    // a block has to fit in frameBuf
+    if(info.sampleRate <= 0 || info.blockChannels <= 0 || frameBufSize / info.blockChannels < AudioDecoder::minBlockFrames)
+    {
+        decoder = nullptr;
+        return false;
+    }
+
+    resampler.reset(info.sampleRate);
+    supported = info.sampleRate >= 8000;
+
+    durationMs = info.totalFrames * 1000 / info.sampleRate;
+
+    // use the loudness/waveform from a previous play, or measure it this time
+    analyser.load(filename, info.fileLength, info.totalFrames * 22050 / info.sampleRate, tags);
+    analyser.setSourceChannels(info.channels);
+
+    governor.reset(info.cost);
+
+    stats.reset(SampleRing::size);
+    stats.sourceRate = info.sampleRate;
+    stats.sourceChannels = info.channels;
+    decoder->updateStats(stats);
+
+    return true;
+}
+
+void StreamPipeline::play(int channel)
+{
+    if(!decoder)
+        return;
+
+    // resume after the seek instead
+    if(seekPending)
+    {
+        resumeAfterSeek = true;
+        return;
+    }
+
+    // a block is enough to start, the first update() fills the rest
+    if(!sink.getStarted())
+        while(sink.getFilled() < SampleRing::startLevel && decodeBlock());
+
+    sink.play(channel);
+}
+
+void StreamPipeline::pause()
+{
+    if(sink.getChannel() == -1)
+        return;
+
+    if(seekPending)
+    {
+        resumeAfterSeek = false;
+        return;
+    }
+
+    sink.fadeOut();
+}
+
+void StreamPipeline::seek(int ms)
+{
+    if(!sink.getStarted() || !durationMs)
+        return;
+
+    if(!seekPending)
+        resumeAfterSeek = getPlaying();
+
+    seekPending = true;
+    seekMs = std::max(0, std::min(ms, durationMs));
+
+    sink.fadeOut();
+}
+
+bool StreamPipeline::getPlaying() const
+{
+    if(seekPending)
+        return resumeAfterSeek;
+
+    return sink.getPlaying();
+}
+
+bool StreamPipeline::getSilent() const
+{
+    return sink.getSilent();
+}
+
+void StreamPipeline::setGain(int32_t gain)
+{
+    this->gain = gain;
+}
+
+void StreamPipeline::setProcessor(AudioProcessor *processor)
+{
+    this->processor = processor;
+}
+
+void StreamPipeline::setQualityMode(QualityMode mode)
+{
+    governor.setMode(mode);
+}
+
+void StreamPipeline::update()
+{
+    stats.underruns = sink.getUnderruns();
+
+    // the callback has stopped taking samples, safe to reset everything
+    if(seekPending && getSilent())
+    {
+        applySeek();
+
+        seekPending = false;
+
+        if(resumeAfterSeek)
+            play(sink.getChannel());
+    }
+
+    if(!sink.getStarted() || sink.getEnded() || !sink.wantBlock(0))
+        return;
+
+#ifdef PROFILER
+    blit::ScopedProfilerProbe scopedProbe(profilerRefillProbe);
+#endif
+    TRACE_SCOPE("Refill");
+
+    // how low the ring got since the last update, it's always refilled past the low water mark below
+    int filled = sink.getFilled();
+
+    // a block at a time until the ring is full enough or this update has used its share of time
+    auto start = blit::now_us();
+
+    while(sink.wantBlock(blit::us_diff(start, blit::now_us())) && decodeBlock());
+
+    governor.update(filled);
+
+#ifdef PROFILER
+    profilerReadProbe->store_elapsed_us();
+    profilerDecProbe->store_elapsed_us();
+#endif
+}
+
+int StreamPipeline::getCurrentSample() const
+{
+    return sink.getPosition();
+}
+
+int StreamPipeline::peekSamples(int16_t *buf, int count) const
+{
+    if(!sink.getStarted())
+        return 0;
+
+    return sink.peek(buf, count);
+}
+
+int StreamPipeline::getBufferedSamples() const
+{
+    if(!sink.getStarted())
+        return 0;
+
+    return sink.getFilled();
+}
+
+int StreamPipeline::getDurationMs() const
+{
+    return durationMs;
+}
+
+const MusicTags &StreamPipeline::getTags() const
+{
+    return tags;
+}
+
+const Waveform &StreamPipeline::getWaveform() const
+{
+    return analyser.getWaveform();
+}
+
+const StreamStats &StreamPipeline::getStats() const
+{
+    return stats;
+}
+
+bool StreamPipeline::getFileSupported() const
+{
+    return supported;
+}
+
+bool StreamPipeline::decodeBlock()
+{
+    auto start = blit::now_us();
+    auto mode = governor.getMode();
+
+    auto &file = decoder->getFile();
+    auto inputPos = decoder->getInputPos();
+    auto readUs = file.getReadUs();
+
+    // mono at the output rate is decoded straight into the ring, unless the space before the end of it is too small
+    bool convert = info.blockChannels != 1 || !resampler.isPassthrough();
+    bool direct = false;
+
+    int16_t *out;
+    int maxFrames;
+
+    if(convert)
+    {
+        out = frameBuf;
+        maxFrames = std::min(frameBufSize / info.blockChannels, resampler.getMaxInput(SampleRing::maxBlock));
+    }
+    else
+    {
+        int count;
+        out = sink.beginWrite(count);
+
+        direct = count >= AudioDecoder::minBlockFrames;
+        if(!direct)
+            out = blockBuf;
+
+        maxFrames = direct ? std::min(count, SampleRing::maxBlock) : SampleRing::maxBlock;
+    }
+
+    // decode
+    int channels = info.blockChannels;
+
+#ifdef PROFILER
+    profilerDecProbe->start();
+#endif
+    TRACE_BEGIN(decodeStart);
+
+    int frames = decoder->decode(out, maxFrames, mode, channels);
+
+#ifdef PROFILER
+    profilerDecProbe->pause();
+#endif
+    TRACE_END(decodeStart, "Decode");
+
+    auto decodeEnd = blit::now_us();
+
+    // the reads happen inside the decoder, split them out
+    uint32_t decodeUs = blit::us_diff(start, decodeEnd);
+    uint32_t blockReadUs = std::min(file.getReadUs() - readUs, decodeUs);
+
+    stats.addStageTime(PipelineStage::Read, blockReadUs);
+    stats.addStageTime(PipelineStage::Decode, decodeUs - blockReadUs);
+
+    if(!frames)
+    {
+        // reached the end, cache the loudness/waveform for next time
+        analyser.finish();
+
+        sink.setEnded();
+        return false;
+    }
+
+    // convert to 22050Hz mono
+    int samples = frames;
+
+    if(convert)
+    {
+        TRACE_SCOPE("Convert");
+
+        auto resampleMode = mode >= QualityMode::CheapResampler ? Resampler::Mode::Nearest : Resampler::Mode::Average;
+        samples = resampler.process(frameBuf, frames, channels, blockBuf, resampleMode);
+        out = blockBuf;
+    }
+
+    auto convertEnd = blit::now_us();
+    stats.addStageTime(PipelineStage::Convert, blit::us_diff(decodeEnd, convertEnd));
+
+    // process
+    {
+        TRACE_SCOPE("Process");
+
+        analyser.process(out, samples);
+
+        applyGain(out, samples, gain);
+
+        if(processor)
+            processor->process(out, samples);
+    }
+
+    auto processEnd = blit::now_us();
+    stats.addStageTime(PipelineStage::Process, blit::us_diff(convertEnd, processEnd));
+
+    // output
+    if(direct)
+        sink.endWrite(samples);
+    else
+        sink.write(out, samples);
+
+    auto end = blit::now_us();
+    stats.addStageTime(PipelineStage::Output, blit::us_diff(processEnd, end));
+
+    auto blockUs = blit::us_diff(start, end);
+    governor.addBlock(blockUs, samples);
+
+    stats.qualityMode = mode;
+    stats.qualityAutomatic = governor.getAutomatic();
+    stats.addBlock(blockUs, decoder->getInputPos() - inputPos, samples);
+    stats.reads = file.getReads();
+    stats.bytesRead = file.getBytesRead();
+    decoder->updateStats(stats);
+
+    return true;
+}
+
+void StreamPipeline::applySeek()
+{
+    auto frame = decoder->seek(seekMs);
+
+    resampler.restart();
+
+    // the EQ history and the limiter's look-ahead would play pre-seek audio under the fade in
+    if(processor)
+        processor->reset();
+
+    sink.restart(frame * 22050 / info.sampleRate);
+
+    // the loudness/waveform would only cover part of the track
+    analyser.stop();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+
+#include "audio-decoder.hpp"
+#include "audio-sink.hpp"
+#include "music-stream.hpp"
+#include "music-tags.hpp"
+#include "quality-governor.hpp"
+#include "resampler.hpp"
+#include "sample-ring.hpp"
+#include "track-analyser.hpp"
+
+// plays a file through the decoder for its format (from StreamRegistry), pulling blocks through each stage:
+// decode (at the source rate) -> convert (downmix/resample to 22050Hz mono) -> process (analyser, gain, EQ/dynamics) -> the sink
+// each stage is timed separately in the stats
+class StreamPipeline final : public MusicStream
+{
+public:
+    bool load(std::string filename);
+
+    void play(int channel);
+    void pause();
+
+    void seek(int ms);
+
+    bool getPlaying() const;
+    bool getSilent() const;
+
+    void setGain(int32_t gain);
+    void setProcessor(AudioProcessor *processor);
+    void setQualityMode(QualityMode mode);
+
+    void update();
+
+    int getCurrentSample() const;
+    int peekSamples(int16_t *buf, int count) const;
+    int getBufferedSamples() const;
+    int getDurationMs() const;
+
+    const MusicTags &getTags() const;
+    const Waveform &getWaveform() const;
+    const StreamStats &getStats() const;
+
+    bool getFileSupported() const;
+
+private:
+    // pulls one block through the pipeline into the sink, returns false at the end of the file
+    bool decodeBlock();
+
+    // jumps to seekMs, the callback must be silent
+    void applySeek();
+
+    AudioDecoder *decoder = nullptr;
+    AudioDecoder::SourceInfo info;
+
+    // decoded frames at the source rate, when they need converting
+    static const int frameBufSize = 4096;
+    int16_t frameBuf[frameBufSize];
+
+    // converted samples, or decoded ones if there isn't enough space before the end of the ring
+    int16_t blockBuf[SampleRing::maxBlock];
+
+    Resampler resampler;
+    QualityGovernor governor;
+
+    AudioSink sink;
+
+    // set by seek(), handled by update() once faded out
+    bool seekPending = false;
+    bool resumeAfterSeek = false;
+    int seekMs = 0;
+    int32_t gain = 0x8000;
+    AudioProcessor *processor = nullptr;
+    int durationMs = 0;
+
+    MusicTags tags;
+
+    TrackAnalyser analyser;
+
+    StreamStats stats;
+
+    bool supported = true;
+};
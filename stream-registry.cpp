@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstring>
+
+#include "stream-registry.hpp"
+#include "stream-file.hpp"
+
+// constant initialised, so it's valid before any of the static Formats are constructed
+StreamRegistry::Format *StreamRegistry::first = nullptr;
+
+static std::string getExtension(const std::string &filename)
+{
+    auto dot = filename.find_last_of('.');
+    if(dot == std::string::npos)
+        return "";
+
+    auto ext = filename.substr(dot);
+    std::for_each(ext.begin(), ext.end(), [](char &c) {c = tolower(c);});
+    return ext;
+}
+
+StreamRegistry::Format::Format(const char *name, std::initializer_list<const char *> extensions, ProbeFunc probe, DecoderFunc getDecoder)
+    : name(name), probe(probe), getDecoder(getDecoder)
+{
+    int i = 0;
+    for(auto ext : extensions)
+    {
+        if(i < maxExtensions)
+            this->extensions[i++] = ext;
+    }
+
+    next = first;
+    first = this;
+}
+
+bool StreamRegistry::Format::hasExtension(const std::string &ext) const
+{
+    for(auto e : extensions)
+    {
+        if(e && ext == e)
+            return true;
+    }
+
+    return false;
+}
+
+AudioDecoder *StreamRegistry::findDecoder(const std::string &filename)
+{
+    StreamFile file;
+    if(!file.open(filename))
+        return nullptr;
+
+    uint8_t header[probeSize];
+    int length = std::max(0, int(file.read(0, probeSize, reinterpret_cast<char *>(header))));
+
+    // ID3v2 tags (MP3, sometimes FLAC) can be any size, probe what comes after
+    if(length >= 10 && memcmp(header, "ID3", 3) == 0)
+    {
+        uint32_t tagSize = (header[6] & 0x7F) << 21 | (header[7] & 0x7F) << 14 | (header[8] & 0x7F) << 7 | (header[9] & 0x7F);
+        length = std::max(0, int(file.read(10 + tagSize, probeSize, reinterpret_cast<char *>(header))));
+    }
+
+    file.close();
+
+    auto ext = getExtension(filename);
+
+    const Format *found = nullptr;
+
+    for(auto format = first; format && !found; format = format->next)
+    {
+        if(format->hasExtension(ext) && format->probe(header, length))
+            found = format;
+    }
+
+    // misnamed
+    for(auto format = first; format && !found; format = format->next)
+    {
+        if(format->probe(header, length))
+            found = format;
+    }
+
+    // unrecognised, let the stream for the extension try anyway
+    for(auto format = first; format && !found; format = format->next)
+    {
+        if(format->hasExtension(ext))
+            found = format;
+    }
+
+    if(!found)
+        return nullptr;
+
+    return &found->getDecoder();
+}
+
+std::vector<std::string> StreamRegistry::getExtensions()
+{
+    std::vector<std::string> ret;
+
+    for(auto format = first; format; format = format->next)
+    {
+        for(auto ext : format->extensions)
+        {
+            if(ext)
+                ret.push_back(ext);
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "audio-decoder.hpp"
+
+// the decoder for each format, each one registers itself from its own file with a probe for the start of a file
+class StreamRegistry final
+{
+public:
+    // looks at the first bytes of a file (after any ID3v2 tag), returns true if the stream can load it
+    using ProbeFunc = bool (*)(const uint8_t *header, int length);
+
+    // the decoder for the format, created on first use
+    using DecoderFunc = AudioDecoder &(*)();
+
+    // enough for the MOD tag at 1080, everything else is in the first few bytes
+    static const int probeSize = 1084;
+
+    static const int maxExtensions = 3;
+
+    // declare one of these statically to add a format
+    struct Format
+    {
+        Format(const char *name, std::initializer_list<const char *> extensions, ProbeFunc probe, DecoderFunc getDecoder);
+
+        bool hasExtension(const std::string &ext) const;
+
+        const char *name;
+        const char *extensions[maxExtensions]{}; // lowercase, with the dot
+        ProbeFunc probe;
+        DecoderFunc getDecoder;
+
+        Format *next;
+    };
+
+    // picks the decoder from the start of the file, returns nullptr if there isn't one for the extension either
+    // a file that looks like the format for its extension uses that, otherwise any format that recognises it,
+    // and if nothing does, the extension
+    static AudioDecoder *findDecoder(const std::string &filename);
+
+    // every registered extension, for the file browser
+    static std::vector<std::string> getExtensions();
+
+private:
+    static Format *first;
+};
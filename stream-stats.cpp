@@ -0,0 +1,69 @@
+#include "stream-stats.hpp"
+
+const char *getPipelineStageName(PipelineStage stage)
+{
+    switch(stage)
+    {
+        case PipelineStage::Read:
+            return "Read";
+        case PipelineStage::Decode:
+            return "Decode";
+        case PipelineStage::Convert:
+            return "Convert";
+        case PipelineStage::Process:
+            return "Process";
+        case PipelineStage::Output:
+            return "Output";
+        case PipelineStage::Count:
+            break;
+    }
+
+    return "";
+}
+
+void StreamStats::reset(int bufferSize)
+{
+    *this = StreamStats();
+    this->bufferSize = bufferSize;
+}
+
+void StreamStats::addBlock(uint32_t decodeUs, uint32_t inputBytes, int samples)
+{
+    decodedBlocks++;
+    lastDecodeUs = decodeUs;
+    totalDecodeUs += decodeUs;
+
+    if(decodeUs > maxDecodeUs)
+        maxDecodeUs = decodeUs;
+
+    if(samples <= 0)
+        return;
+
+    totalInputBytes += inputBytes;
+    totalSamples += samples;
+
+    // bits * samples per second / samples / 1000
+    bitrate = static_cast<uint64_t>(inputBytes) * 8 * 22050 / samples / 1000;
+    avgBitrate = totalInputBytes * 8 * 22050 / totalSamples / 1000;
+}
+
+void StreamStats::addStageTime(PipelineStage stage, uint32_t us)
+{
+    stageUs[int(stage)] += us;
+}
+
+uint32_t StreamStats::getAvgDecodeUs() const
+{
+    return decodedBlocks ? totalDecodeUs / decodedBlocks : 0;
+}
+
+int StreamStats::getStagePercent(PipelineStage stage) const
+{
+    return totalDecodeUs ? stageUs[int(stage)] * 100 / totalDecodeUs : 0;
+}
+
+int StreamStats::getCacheHitRate() const
+{
+    uint32_t total = cacheHits + cacheMisses;
+    return total ? static_cast<uint64_t>(cacheHits) * 100 / total : -1;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+
+#include "quality-governor.hpp"
+
+// the parts of StreamPipeline::decodeBlock that are timed separately
+enum class PipelineStage : uint8_t
+{
+    Read = 0, // file reads, inside the decoder
+    Decode,
+    Convert,  // downmix/resample
+    Process,  // analyser, gain, EQ/dynamics
+    Output,   // into the ring
+
+    Count
+};
+
+const char *getPipelineStageName(PipelineStage stage);
+
+// live numbers from a stream for the stats overlay, reset on load
+struct StreamStats
+{
+    // before conversion to 22050Hz mono
+    int sourceRate = 0, sourceChannels = 0;
+
+    QualityMode qualityMode = QualityMode::Full;
+    bool qualityAutomatic = true;
+
+    // kbps, the last decoded block and the whole track so far
+    int bitrate = 0, avgBitrate = 0;
+
+    uint32_t decodedBlocks = 0;
+    uint32_t lastDecodeUs = 0, maxDecodeUs = 0;
+    uint64_t totalDecodeUs = 0;
+
+    // the whole track so far, about the same total as totalDecodeUs (the end of the file is only in these)
+    uint64_t stageUs[int(PipelineStage::Count)]{};
+
+    // samples, the size of the sink's ring
+    int bufferSize = 0;
+
+    // audio callbacks that had nothing to play
+    uint32_t underruns = 0;
+
+    uint32_t reads = 0, bytesRead = 0;
+
+    // reads served from a buffer in the stream, both 0 if there isn't one
+    uint32_t cacheHits = 0, cacheMisses = 0;
+
+    void reset(int bufferSize);
+
+    // a decoded block of 22050Hz output, inputBytes is the compressed data it used
+    void addBlock(uint32_t decodeUs, uint32_t inputBytes, int samples);
+
+    void addStageTime(PipelineStage stage, uint32_t us);
+
+    uint32_t getAvgDecodeUs() const;
+
+    // percent of the decode time
+    int getStagePercent(PipelineStage stage) const;
+
+    // percent, -1 without a cache
+    int getCacheHitRate() const;
+
+private:
+    uint64_t totalInputBytes = 0, totalSamples = 0;
+};
@@ -0,0 +1,101 @@
+#include "trace.hpp"
+
+#ifdef TRACE_ENABLED
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+struct TraceEvent
+{
+    const char *name;
+    uint64_t start; // ns
+    uint32_t duration;
+    uint32_t thread;
+};
+
+// the last ~64k events, the audio callback runs on another thread so the index is atomic
+static const uint32_t ringSize = 1 << 16;
+static TraceEvent ring[ringSize];
+static std::atomic<uint32_t> nextEvent(0);
+
+static const int maxThreads = 8;
+static const char *threadNames[maxThreads]{};
+static std::atomic<uint32_t> nextThread(0);
+
+static uint32_t getThreadId()
+{
+    thread_local uint32_t id = nextThread++;
+    return id;
+}
+
+uint64_t traceTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void traceEvent(const char *name, uint64_t start)
+{
+    auto end = traceTime();
+    auto &event = ring[nextEvent++ % ringSize];
+
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    event.thread = getThreadId();
+}
+
+void traceThreadName(const char *name)
+{
+    auto id = getThreadId();
+
+    if(id < maxThreads && !threadNames[id])
+        threadNames[id] = name;
+}
+
+bool traceDump(const char *filename)
+{
+    auto file = fopen(filename, "w");
+    if(!file)
+        return false;
+
+    uint32_t end = nextEvent;
+    uint32_t start = end > ringSize ? end - ringSize : 0;
+
+    fprintf(file, "{\"traceEvents\":[");
+
+    const char *separator = "\n";
+
+    for(uint32_t i = 0; i < maxThreads; i++)
+    {
+        if(!threadNames[i])
+            continue;
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%" PRIu32 ",\"args\":{\"name\":\"%s\"}}", separator, i, threadNames[i]);
+        separator = ",\n";
+    }
+
+    // relative to the first event so the numbers stay readable
+    // (events are added when they end, so that isn't necessarily the oldest in the ring)
+    uint64_t base = ~uint64_t(0);
+    for(uint32_t i = start; i < end; i++)
+        base = std::min(base, ring[i % ringSize].start);
+
+    for(uint32_t i = start; i < end; i++)
+    {
+        auto &event = ring[i % ringSize];
+        auto ts = static_cast<double>(event.start - base) / 1000.0;
+        auto dur = static_cast<double>(event.duration) / 1000.0;
+
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,\"dur\":%.3f}", separator, event.name, event.thread, ts, dur);
+        separator = ",\n";
+    }
+
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(file);
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+// timeline of what the player is doing, dumped as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+// only if MUSIC_PLAYER_TRACE is defined (the CMake option of the same name, for host builds), the ring is too big for the device
+// otherwise the macros do nothing
+
+#ifdef MUSIC_PLAYER_TRACE
+#define TRACE_ENABLED
+#endif
+
+#ifdef TRACE_ENABLED
+
+uint64_t traceTime();
+
+// records a complete event from start to now
+void traceEvent(const char *name, uint64_t start);
+
+// names the calling thread in the trace, only the first call for each thread does anything
+void traceThreadName(const char *name);
+
+// writes everything still in the ring, returns false if the file couldn't be opened
+bool traceDump(const char *filename);
+
+class TraceScope final
+{
+public:
+    TraceScope(const char *name) : name(name), start(traceTime()) {}
+    ~TraceScope() {traceEvent(name, start);}
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_BEGIN(var) uint64_t var = traceTime()
+#define TRACE_END(var, name) traceEvent(name, var)
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_BEGIN(var)
+#define TRACE_END(var, name)
+#define TRACE_THREAD_NAME(name)
+
+#endif
@@ -0,0 +1,67 @@
+#include "track-analyser.hpp"
+#include "track-index.hpp"
+
+void TrackAnalyser::load(const std::string &filename, uint32_t fileLength, uint32_t totalSamples, MusicTags &tags)
+{
+    this->filename = filename;
+    this->fileLength = fileLength;
+
+    loudnessMeter.reset();
+    waveform.reset(totalSamples);
+
+    TrackInfo info;
+    measuring = !lookupTrackInfo(filename, fileLength, info);
+
+    if(measuring)
+        return;
+
+    tags.hasMeasuredLoudness = true;
+    tags.measuredLoudness = info.loudness;
+    tags.measuredPeak = info.peak;
+
+    waveform.setData(info.waveformPeak, info.waveformRMS);
+}
+
+void TrackAnalyser::setSourceChannels(int channels)
+{
+    loudnessMeter.setSourceChannels(channels);
+}
+
+void TrackAnalyser::process(const int16_t *samples, int count)
+{
+    if(!measuring)
+        return;
+
+    loudnessMeter.process(samples, count);
+    waveform.process(samples, count);
+}
+
+void TrackAnalyser::finish()
+{
+    if(!measuring || !loudnessMeter.getValid())
+        return;
+
+    waveform.finish();
+
+    TrackInfo info;
+    info.loudness = loudnessMeter.getIntegratedLoudness();
+    info.peak = loudnessMeter.getPeak();
+
+    auto peaks = waveform.getPeaks(), rms = waveform.getRMS();
+    std::copy(peaks, peaks + Waveform::numBuckets, info.waveformPeak);
+    std::copy(rms, rms + Waveform::numBuckets, info.waveformRMS);
+
+    storeTrackInfo(filename, fileLength, info);
+
+    measuring = false;
+}
+
+void TrackAnalyser::stop()
+{
+    measuring = false;
+}
+
+const Waveform &TrackAnalyser::getWaveform() const
+{
+    return waveform;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "loudness-meter.hpp"
+#include "music-tags.hpp"
+#include "waveform.hpp"
+
+// loudness and waveform of a track, measured from the decoded output the first time it's played
+// and cached in the track index after that
+class TrackAnalyser final
+{
+public:
+    // fills in the measured loudness in tags if the track is already in the index
+    void load(const std::string &filename, uint32_t fileLength, uint32_t totalSamples, MusicTags &tags);
+
+    // channels of the source before downmixing
+    void setSourceChannels(int channels);
+
+    // decoded samples, before any gain/processing
+    void process(const int16_t *samples, int count);
+
+    // end of the track, stores the results
+    void finish();
+
+    // the stream skipped part of the track (seeking), so the results won't be stored
+    void stop();
+
+    const Waveform &getWaveform() const;
+
+private:
+    std::string filename;
+    uint32_t fileLength = 0;
+
+    bool measuring = false;
+
+    LoudnessMeter loudnessMeter;
+    Waveform waveform;
+};
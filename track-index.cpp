@@ -0,0 +1,118 @@
+#include <cstring>
+
+#include "engine/file.hpp"
+
+#include "track-index.hpp"
+
+static const char *indexPath = "/music-player.idx";
+
+// bump if the entry format changes, the index gets rebuilt
+static const char indexMagic[4]{'M', 'P', 'I', '2'};
+
+// on-disk entry
+struct IndexEntry
+{
+    uint32_t pathHash;
+    uint32_t fileLength;
+    int16_t loudness; // 1/100 LU
+    uint16_t peak; // Q15
+
+    uint8_t waveformPeak[Waveform::numBuckets];
+    uint8_t waveformRMS[Waveform::numBuckets];
+};
+
+static uint32_t hashPath(const std::string &filename)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261;
+
+    for(auto c : filename)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
+static bool checkMagic(blit::File &file)
+{
+    char magic[4];
+    return file.read(0, 4, magic) == 4 && memcmp(magic, indexMagic, 4) == 0;
+}
+
+// returns offset of the entry or the end of the file if not found
+// only reads the key
+static uint32_t findEntry(blit::File &file, uint32_t hash, uint32_t fileLength)
+{
+    auto indexLength = file.get_length();
+    uint32_t offset = sizeof(indexMagic);
+
+    for(; offset + sizeof(IndexEntry) <= indexLength; offset += sizeof(IndexEntry))
+    {
+        uint32_t key[2];
+        if(file.read(offset, sizeof(key), reinterpret_cast<char *>(key)) != sizeof(key))
+            break;
+
+        if(key[0] == hash && key[1] == fileLength)
+            return offset;
+    }
+
+    return indexLength;
+}
+
+bool lookupTrackInfo(const std::string &filename, uint32_t fileLength, TrackInfo &info)
+{
+    blit::File file(indexPath);
+
+    if(!file.is_open() || !checkMagic(file))
+        return false;
+
+    auto offset = findEntry(file, hashPath(filename), fileLength);
+
+    IndexEntry entry;
+
+    if(offset == file.get_length() || file.read(offset, sizeof(IndexEntry), reinterpret_cast<char *>(&entry)) != sizeof(IndexEntry))
+        return false;
+
+    info.loudness = entry.loudness / 100.0f;
+    info.peak = entry.peak / 32768.0f;
+    memcpy(info.waveformPeak, entry.waveformPeak, sizeof(info.waveformPeak));
+    memcpy(info.waveformRMS, entry.waveformRMS, sizeof(info.waveformRMS));
+
+    return true;
+}
+
+void storeTrackInfo(const std::string &filename, uint32_t fileLength, const TrackInfo &info)
+{
+    blit::File file;
+
+    // read|write needs the file to exist already
+    if(blit::file_exists(indexPath))
+        file.open(indexPath, blit::OpenMode::read | blit::OpenMode::write);
+
+    // missing or old format, start again
+    if(!file.is_open() || !checkMagic(file))
+    {
+        file.close();
+        file.open(indexPath, blit::OpenMode::write);
+
+        if(!file.is_open())
+            return;
+
+        file.write(0, sizeof(indexMagic), indexMagic);
+    }
+
+    auto hash = hashPath(filename);
+    auto offset = findEntry(file, hash, fileLength);
+
+    IndexEntry entry;
+    entry.pathHash = hash;
+    entry.fileLength = fileLength;
+    entry.loudness = static_cast<int16_t>(info.loudness * 100.0f);
+    entry.peak = static_cast<uint16_t>((info.peak > 1.0f ? 1.0f : info.peak) * 32768.0f);
+    memcpy(entry.waveformPeak, info.waveformPeak, sizeof(entry.waveformPeak));
+    memcpy(entry.waveformRMS, info.waveformRMS, sizeof(entry.waveformRMS));
+
+    file.write(offset, sizeof(IndexEntry), reinterpret_cast<char *>(&entry));
+}
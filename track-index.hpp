@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "waveform.hpp"
+
+// analysis results cached between plays, keyed by path and file length
+struct TrackInfo
+{
+    float loudness = 0.0f; // LUFS
+    float peak = 0.0f;
+
+    uint8_t waveformPeak[Waveform::numBuckets];
+    uint8_t waveformRMS[Waveform::numBuckets];
+};
+
+bool lookupTrackInfo(const std::string &filename, uint32_t fileLength, TrackInfo &info);
+void storeTrackInfo(const std::string &filename, uint32_t fileLength, const TrackInfo &info);
@@ -0,0 +1,887 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "tracker-module.hpp"
+
+// everything is loaded into memory, larger modules aren't supported
+static const uint32_t maxSampleBytes = 256 * 1024;
+
+// ProtoTracker periods for the lowest octave, used to find the note of a MOD period
+static const uint16_t modPeriods[12]{1712, 1616, 1525, 1440, 1357, 1281, 1209, 1141, 1077, 1017, 961, 907};
+
+static uint16_t getUint16LE(const uint8_t *buf)
+{
+    return buf[0] | buf[1] << 8;
+}
+
+static uint32_t getUint32LE(const uint8_t *buf)
+{
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | static_cast<uint32_t>(buf[3]) << 24;
+}
+
+static uint16_t getUint16BE(const uint8_t *buf)
+{
+    return buf[0] << 8 | buf[1];
+}
+
+// fixed length, padded with spaces or nulls
+static std::string getString(const uint8_t *buf, int len)
+{
+    std::string ret(reinterpret_cast<const char *>(buf), strnlen(reinterpret_cast<const char *>(buf), len));
+
+    auto end = ret.find_last_not_of(' ');
+    ret.erase(end == std::string::npos ? 0 : end + 1);
+
+    return ret;
+}
+
+static int getMODChannels(const uint8_t *tag)
+{
+    if(!memcmp(tag, "M.K.", 4) || !memcmp(tag, "M!K!", 4) || !memcmp(tag, "M&K!", 4) || !memcmp(tag, "FLT4", 4) || !memcmp(tag, "N.T.", 4))
+        return 4;
+
+    if(!memcmp(tag, "OCTA", 4) || !memcmp(tag, "CD81", 4))
+        return 8;
+
+    auto isDigit = [](uint8_t c){return c >= '0' && c <= '9';};
+
+    // xCHN, xxCH, xxCN
+    if(isDigit(tag[0]) && !memcmp(tag + 1, "CHN", 3))
+        return tag[0] - '0';
+
+    if(isDigit(tag[0]) && isDigit(tag[1]) && (!memcmp(tag + 2, "CH", 2) || !memcmp(tag + 2, "CN", 2)))
+        return (tag[0] - '0') * 10 + tag[1] - '0';
+
+    return 0;
+}
+
+// S3M commands (A = 1) to XM effects
+static void convertS3MEffect(ModuleNote &note, uint8_t command, uint8_t param)
+{
+    using namespace ModuleEffect;
+
+    note.effect = 0;
+    note.param = 0;
+
+    switch(command + 'A' - 1)
+    {
+        case 'A': // speed
+            if(param)
+            {
+                note.effect = SpeedTempo;
+                note.param = std::min(param, uint8_t(0x1F));
+            }
+            break;
+
+        case 'B':
+            note.effect = PositionJump;
+            note.param = param;
+            break;
+
+        case 'C':
+            note.effect = PatternBreak;
+            note.param = param;
+            break;
+
+        case 'D': // volume slide, DxF/DFy are fine slides
+        case 'K':
+        case 'L':
+            if((param & 0x0F) == 0x0F && (param >> 4))
+            {
+                note.effect = Extended;
+                note.param = 0xA0 | param >> 4;
+            }
+            else if((param >> 4) == 0x0F && (param & 0x0F))
+            {
+                note.effect = Extended;
+                note.param = 0xB0 | (param & 0x0F);
+            }
+            else
+            {
+                note.effect = command == 'K' - 'A' + 1 ? VibratoVolSlide : command == 'L' - 'A' + 1 ? TonePortaVolSlide : VolSlide;
+                note.param = param;
+            }
+            break;
+
+        case 'E': // porta down, EFx/EEx are fine/extra fine
+        case 'F':
+        {
+            bool up = command == 'F' - 'A' + 1;
+
+            if((param >> 4) == 0x0F)
+            {
+                note.effect = Extended;
+                note.param = (up ? 0x10 : 0x20) | (param & 0x0F);
+            }
+            else if((param >> 4) == 0x0E)
+            {
+                note.effect = ExtraFinePorta;
+                note.param = (up ? 0x10 : 0x20) | (param & 0x0F);
+            }
+            else
+            {
+                note.effect = up ? PortaUp : PortaDown;
+                note.param = param;
+            }
+            break;
+        }
+
+        case 'G':
+            note.effect = TonePorta;
+            note.param = param;
+            break;
+
+        case 'H':
+            note.effect = Vibrato;
+            note.param = param;
+            break;
+
+        case 'J':
+            note.effect = Arpeggio;
+            note.param = param;
+            break;
+
+        case 'O':
+            note.effect = SampleOffset;
+            note.param = param;
+            break;
+
+        case 'Q':
+            note.effect = MultiRetrig;
+            note.param = param;
+            break;
+
+        case 'R':
+            note.effect = Tremolo;
+            note.param = param;
+            break;
+
+        case 'S':
+        {
+            // the ones with XM equivalents
+            static const uint8_t extended[16]{0, 0x3, 0x5, 0x4, 0x7, 0, 0, 0, 0, 0, 0, 0x6, 0xC, 0xD, 0xE, 0};
+
+            if(extended[param >> 4])
+            {
+                note.effect = Extended;
+                note.param = extended[param >> 4] << 4 | (param & 0x0F);
+            }
+            break;
+        }
+
+        case 'T':
+            if(param >= 0x20)
+            {
+                note.effect = SpeedTempo;
+                note.param = param;
+            }
+            break;
+
+        case 'U': // fine vibrato, a quarter of the depth
+            note.effect = Vibrato;
+            note.param = (param & 0xF0) | std::max((param & 0x0F) >> 2, (param & 0x0F) ? 1 : 0);
+            break;
+
+        case 'V':
+            note.effect = SetGlobalVolume;
+            note.param = std::min(param, uint8_t(64));
+            break;
+
+        case 'W':
+            note.effect = GlobalVolSlide;
+            note.param = param;
+            break;
+    }
+}
+
+// the loop is clamped to the sample, then anything after it is dropped as it can never be played
+static void trimToLoop(ModuleSample &sample)
+{
+    if(sample.loop == ModuleSample::Loop::None)
+        return;
+
+    sample.loopEnd = std::min(sample.loopEnd, sample.length);
+
+    if(sample.loopStart >= sample.loopEnd)
+        sample.loop = ModuleSample::Loop::None;
+    else
+        sample.length = sample.loopEnd;
+}
+
+bool TrackerModule::load(StreamFile &file)
+{
+    clear();
+
+    // enough for any of the headers (the MOD one is the largest)
+    uint8_t header[1084];
+    auto read = file.read(0, sizeof(header), reinterpret_cast<char *>(header));
+
+    bool ok = false;
+
+    if(getFormat(header, read, format))
+    {
+        if(format == Format::XM)
+            ok = loadXM(file, header);
+        else if(format == Format::S3M)
+            ok = loadS3M(file, header);
+        else
+            ok = loadMOD(file, header);
+    }
+
+    if(!ok || !channels || channels > maxChannels || orders.empty())
+    {
+        clear();
+        return false;
+    }
+
+    // orders can refer to patterns that don't exist, which are empty
+    for(auto &order : orders)
+    {
+        if(order == skipOrder || order == endOrder)
+            continue;
+
+        while(order >= patterns.size())
+        {
+            patterns.push_back({64, uint32_t(patternData.size())});
+            patternData.insert(patternData.end(), 64 * channels, 0);
+        }
+    }
+
+    return true;
+}
+
+bool TrackerModule::probe(const uint8_t *header, int length)
+{
+    Format format;
+    return getFormat(header, length, format);
+}
+
+void TrackerModule::clear()
+{
+    title.clear();
+    channels = 0;
+    initialSpeed = 6;
+    initialTempo = 125;
+    initialGlobalVolume = 64;
+    orders.clear();
+    patterns.clear();
+    patternData.clear();
+    instruments.clear();
+    samples.clear();
+
+    // actually free the (possibly large) buffers
+    patternData.shrink_to_fit();
+    sampleData.clear();
+    sampleData.shrink_to_fit();
+}
+
+const uint8_t *TrackerModule::unpackRow(const uint8_t *data, ModuleNote *row, int channels)
+{
+    for(int c = 0; c < channels; c++)
+    {
+        auto flags = *data++;
+        auto &note = row[c];
+
+        note.note = flags & 1 ? *data++ : 0;
+        note.instrument = flags & 2 ? *data++ : 0;
+        note.volume = flags & 4 ? *data++ : 0;
+        note.effect = flags & 8 ? *data++ : 0;
+        note.param = flags & 16 ? *data++ : 0;
+    }
+
+    return data;
+}
+
+const uint8_t *TrackerModule::getRowData(int pattern, int row) const
+{
+    auto data = patternData.data() + patterns[pattern].offset;
+
+    ModuleNote skipped[maxChannels];
+    for(int i = 0; i < row; i++)
+        data = unpackRow(data, skipped, channels);
+
+    return data;
+}
+
+bool TrackerModule::getFormat(const uint8_t *header, int length, Format &format)
+{
+    if(length >= 336 && !memcmp(header, "Extended Module: ", 17))
+        format = Format::XM;
+    else if(length >= 0x60 && !memcmp(header + 0x2C, "SCRM", 4))
+        format = Format::S3M;
+    else if(length >= 1084 && getMODChannels(header + 1080))
+        format = Format::MOD;
+    else
+        return false;
+
+    return true;
+}
+
+bool TrackerModule::loadMOD(StreamFile &file, const uint8_t *header)
+{
+    title = getString(header, 20);
+    channels = getMODChannels(header + 1080);
+    linearPeriods = false;
+    effectMemory = false;
+
+    int songLength = std::min(header[950], uint8_t(128));
+    orders.assign(header + 952, header + 952 + songLength);
+
+    // every pattern in the list is stored, even if it isn't used
+    int numPatterns = *std::max_element(header + 952, header + 952 + 128) + 1;
+
+    uint32_t patternSize = 64 * channels * 4;
+    uint32_t offset = 1084;
+
+    std::vector<uint8_t> buf(patternSize);
+
+    for(int p = 0; p < numPatterns; p++, offset += patternSize)
+    {
+        if(file.read(offset, patternSize, reinterpret_cast<char *>(buf.data())) != int32_t(patternSize))
+            return false;
+
+        patterns.push_back({64, uint32_t(patternData.size())});
+
+        for(uint32_t i = 0; i < patternSize; i += 4)
+        {
+            auto cell = buf.data() + i;
+            ModuleNote note;
+
+            note.instrument = (cell[0] & 0xF0) | cell[2] >> 4;
+            note.effect = cell[2] & 0x0F;
+            note.param = cell[3];
+
+            // closest note to the period
+            int period = (cell[0] & 0x0F) << 8 | cell[1];
+
+            if(period)
+            {
+                int bestDiff = INT32_MAX;
+
+                for(int n = 0; n < 60; n++)
+                {
+                    int diff = std::abs(period - (modPeriods[n % 12] >> (n / 12)));
+                    if(diff < bestDiff)
+                    {
+                        bestDiff = diff;
+                        note.note = n + 24 + 1;
+                    }
+                }
+            }
+
+            packNote(note);
+        }
+    }
+
+    // samples follow the patterns
+    for(int i = 0; i < 31; i++)
+    {
+        auto info = header + 20 + i * 30;
+
+        ModuleSample sample;
+        uint32_t storedLength = getUint16BE(info + 22) * 2;
+
+        sample.length = storedLength;
+        sample.finetune = int8_t(info[24] << 4); // signed nibble * 16
+        sample.volume = std::min(info[25], uint8_t(64));
+
+        uint32_t loopStart = getUint16BE(info + 26) * 2, loopLength = getUint16BE(info + 28) * 2;
+
+        if(loopLength > 2)
+        {
+            sample.loop = ModuleSample::Loop::Forward;
+            sample.loopStart = loopStart;
+            sample.loopEnd = loopStart + loopLength;
+        }
+
+        trimToLoop(sample);
+
+        auto data = addSampleData(sample, sample.length, false);
+        if(!data)
+            return false;
+
+        // may be short at the end of the file
+        if(sample.length)
+            file.read(offset, sample.length, reinterpret_cast<char *>(data));
+
+        finishSample(sample);
+
+        offset += storedLength;
+        samples.push_back(sample);
+    }
+
+    addSampleInstruments();
+
+    return true;
+}
+
+bool TrackerModule::loadS3M(StreamFile &file, const uint8_t *header)
+{
+    title = getString(header, 28);
+    linearPeriods = false;
+    effectMemory = true;
+
+    int numOrders = getUint16LE(header + 0x20);
+    int numInstruments = getUint16LE(header + 0x22);
+    int numPatterns = getUint16LE(header + 0x24);
+    bool unsignedSamples = getUint16LE(header + 0x2A) == 2;
+
+    initialGlobalVolume = std::min(header[0x30], uint8_t(64));
+    if(header[0x31] && header[0x31] != 0xFF)
+        initialSpeed = header[0x31];
+    if(header[0x32] >= 0x20)
+        initialTempo = header[0x32];
+
+    // channels 0-15 are samples, the rest are disabled or AdLib
+    channels = 0;
+    for(int c = 0; c < 32; c++)
+    {
+        if(header[0x40 + c] < 16)
+            channels = c + 1;
+    }
+
+    // orders, then the pointers (in 16 byte paragraphs) to the instruments and patterns
+    std::vector<uint8_t> lists(numOrders + (numInstruments + numPatterns) * 2);
+    if(file.read(0x60, lists.size(), reinterpret_cast<char *>(lists.data())) != int32_t(lists.size()))
+        return false;
+
+    for(int i = 0; i < numOrders; i++)
+    {
+        // patterns past the end would be an empty pattern, treat them as the end
+        if(lists[i] != skipOrder && lists[i] >= numPatterns)
+            lists[i] = endOrder;
+    }
+
+    // markers at the end don't need to be kept
+    auto ordersEnd = numOrders;
+    while(ordersEnd && lists[ordersEnd - 1] == endOrder)
+        ordersEnd--;
+
+    orders.assign(lists.begin(), lists.begin() + ordersEnd);
+
+    auto instrumentPointers = lists.data() + numOrders;
+    auto patternPointers = instrumentPointers + numInstruments * 2;
+
+    for(int i = 0; i < numInstruments; i++)
+    {
+        uint8_t info[80];
+        ModuleSample sample;
+
+        uint32_t offset = getUint16LE(instrumentPointers + i * 2) * 16;
+
+        // only samples, no AdLib
+        if(file.read(offset, 80, reinterpret_cast<char *>(info)) == 80 && info[0] == 1)
+        {
+            uint32_t dataOffset = (info[13] << 16 | getUint16LE(info + 14)) * 16;
+            uint32_t storedLength = getUint32LE(info + 16);
+            bool is16Bit = info[31] & 4;
+
+            sample.length = storedLength;
+            sample.volume = std::min(info[28], uint8_t(64));
+
+            if(info[31] & 1)
+            {
+                sample.loop = ModuleSample::Loop::Forward;
+                sample.loopStart = getUint32LE(info + 20);
+                sample.loopEnd = getUint32LE(info + 24);
+            }
+
+            // C-4 speed to a relative note
+            uint32_t c2spd = getUint32LE(info + 32);
+            if(c2spd)
+            {
+                int fine = std::lround(std::log2(c2spd / 8363.0f) * 12 * 128);
+                int note = (fine + 64) >> 7;
+                sample.relativeNote = std::max(-48, std::min(note, 48));
+                sample.finetune = std::max(-128, std::min(fine - note * 128, 127));
+            }
+
+            trimToLoop(sample);
+
+            auto data = addSampleData(sample, sample.length, is16Bit);
+            if(!data)
+                return false;
+
+            // the left channel of stereo samples is first
+            if(sample.length)
+                file.read(dataOffset, sample.length * (is16Bit ? 2 : 1), reinterpret_cast<char *>(data));
+
+            if(unsignedSamples)
+            {
+                if(is16Bit)
+                {
+                    auto data16 = reinterpret_cast<int16_t *>(data);
+                    for(uint32_t j = 0; j < sample.length; j++)
+                        data16[j] ^= int16_t(0x8000);
+                }
+                else
+                {
+                    for(uint32_t j = 0; j < sample.length; j++)
+                        data[j] ^= int8_t(0x80);
+                }
+            }
+
+            finishSample(sample);
+        }
+
+        samples.push_back(sample);
+    }
+
+    addSampleInstruments();
+
+    // patterns are 64 rows of (channel/flags, [note, instrument], [volume], [command, info])
+    std::vector<uint8_t> buf;
+    ModuleNote row[maxChannels];
+
+    for(int p = 0; p < numPatterns; p++)
+    {
+        patterns.push_back({64, uint32_t(patternData.size())});
+
+        uint32_t offset = getUint16LE(patternPointers + p * 2) * 16;
+        uint8_t lengthBuf[2];
+
+        bool valid = offset && file.read(offset, 2, reinterpret_cast<char *>(lengthBuf)) == 2;
+
+        if(valid)
+        {
+            buf.resize(getUint16LE(lengthBuf));
+            valid = file.read(offset + 2, buf.size(), reinterpret_cast<char *>(buf.data())) == int32_t(buf.size());
+        }
+
+        if(!valid)
+            buf.clear();
+
+        size_t pos = 0;
+
+        for(int r = 0; r < 64; r++)
+        {
+            for(int c = 0; c < channels; c++)
+                row[c] = ModuleNote();
+
+            while(pos < buf.size())
+            {
+                auto what = buf[pos++];
+                if(!what)
+                    break;
+
+                // skip anything for disabled channels
+                ModuleNote dummy;
+                int c = what & 31;
+                auto &note = c < channels ? row[c] : dummy;
+
+                if((what & 32) && pos + 2 <= buf.size())
+                {
+                    auto n = buf[pos++];
+
+                    if(n == 0xFE)
+                        note.note = ModuleNote::noteOff;
+                    else if(n != 0xFF && (n >> 4) < 8 && (n & 0x0F) < 12)
+                        note.note = (n >> 4) * 12 + (n & 0x0F) + 1;
+
+                    note.instrument = buf[pos++];
+                }
+
+                if((what & 64) && pos + 1 <= buf.size())
+                {
+                    auto v = buf[pos++];
+                    if(v <= 64)
+                        note.volume = 0x10 + v;
+                }
+
+                if((what & 128) && pos + 2 <= buf.size())
+                {
+                    auto command = buf[pos++];
+                    convertS3MEffect(note, command, buf[pos++]);
+                }
+            }
+
+            for(int c = 0; c < channels; c++)
+                packNote(row[c]);
+        }
+    }
+
+    return true;
+}
+
+bool TrackerModule::loadXM(StreamFile &file, const uint8_t *header)
+{
+    title = getString(header + 17, 20);
+
+    uint32_t headerSize = getUint32LE(header + 60);
+    int songLength = std::min(getUint16LE(header + 64), uint16_t(256));
+    channels = getUint16LE(header + 68);
+    int numPatterns = getUint16LE(header + 70);
+    int numInstruments = getUint16LE(header + 72);
+    linearPeriods = getUint16LE(header + 74) & 1;
+    effectMemory = true;
+
+    if(getUint16LE(header + 76))
+        initialSpeed = std::min(getUint16LE(header + 76), uint16_t(31));
+    if(getUint16LE(header + 78) >= 32)
+        initialTempo = std::min(getUint16LE(header + 78), uint16_t(255));
+
+    // 254/255 are S3M order markers
+    if(!channels || channels > maxChannels || numPatterns >= skipOrder)
+        return false;
+
+    orders.assign(header + 80, header + 80 + songLength);
+
+    for(auto &order : orders)
+    {
+        if(order >= numPatterns)
+            order = numPatterns; // an empty pattern
+    }
+
+    uint32_t offset = 60 + headerSize;
+
+    std::vector<uint8_t> buf;
+
+    for(int p = 0; p < numPatterns; p++)
+    {
+        uint8_t patternHeader[9];
+        if(file.read(offset, 9, reinterpret_cast<char *>(patternHeader)) != 9)
+            return false;
+
+        int rows = getUint16LE(patternHeader + 5);
+        uint32_t packedSize = getUint16LE(patternHeader + 7);
+
+        offset += getUint32LE(patternHeader);
+
+        buf.resize(packedSize);
+        if(packedSize && file.read(offset, packedSize, reinterpret_cast<char *>(buf.data())) != int32_t(packedSize))
+            return false;
+
+        offset += packedSize;
+
+        if(rows < 1 || rows > 256)
+            rows = 64;
+
+        patterns.push_back({rows, uint32_t(patternData.size())});
+
+        // same as ours, but with the note byte instead of flags if the top bit isn't set
+        size_t pos = 0;
+
+        for(int i = 0; i < rows * channels; i++)
+        {
+            ModuleNote note;
+
+            if(pos < buf.size())
+            {
+                auto flags = buf[pos];
+
+                if(flags & 0x80)
+                    pos++;
+                else
+                    flags = 0x1F;
+
+                uint8_t *fields[5]{&note.note, &note.instrument, &note.volume, &note.effect, &note.param};
+
+                for(int f = 0; f < 5; f++)
+                {
+                    if((flags & (1 << f)) && pos < buf.size())
+                        *fields[f] = buf[pos++];
+                }
+
+                if(note.note > ModuleNote::noteOff)
+                    note.note = 0;
+            }
+
+            packNote(note);
+        }
+    }
+
+    for(int i = 0; i < numInstruments; i++)
+    {
+        uint8_t info[241]{};
+
+        auto read = file.read(offset, sizeof(info), reinterpret_cast<char *>(info));
+        if(read < 29)
+            return false;
+
+        uint32_t instrumentSize = getUint32LE(info);
+        int numSamples = getUint16LE(info + 27);
+
+        ModuleInstrument instrument;
+        memset(instrument.sampleMap, ModuleInstrument::noSample, sizeof(instrument.sampleMap));
+
+        offset += instrumentSize;
+
+        if(!numSamples || read < int(sizeof(info)))
+        {
+            instruments.push_back(instrument);
+            continue;
+        }
+
+        uint32_t sampleHeaderSize = getUint32LE(info + 29);
+
+        int firstSample = samples.size();
+
+        for(int n = 0; n < 96; n++)
+        {
+            if(info[33 + n] < numSamples && firstSample + info[33 + n] < ModuleInstrument::noSample)
+                instrument.sampleMap[n] = firstSample + info[33 + n];
+        }
+
+        auto &envelope = instrument.volumeEnvelope;
+        envelope.numPoints = std::min(info[225], uint8_t(ModuleEnvelope::maxPoints));
+        envelope.sustainPoint = info[227];
+        envelope.loopStart = info[228];
+        envelope.loopEnd = info[229];
+        envelope.enabled = (info[233] & 1) && envelope.numPoints;
+        envelope.sustain = (info[233] & 2) && envelope.sustainPoint < envelope.numPoints;
+        envelope.loop = (info[233] & 4) && envelope.loopStart <= envelope.loopEnd && envelope.loopEnd < envelope.numPoints;
+
+        for(int p = 0; p < envelope.numPoints; p++)
+        {
+            envelope.points[p].tick = getUint16LE(info + 129 + p * 4);
+            envelope.points[p].value = std::min(getUint16LE(info + 131 + p * 4), uint16_t(64));
+        }
+
+        instrument.fadeout = getUint16LE(info + 239);
+
+        instruments.push_back(instrument);
+
+        // sample headers, then the data for all of them
+        uint32_t dataOffset = offset + numSamples * sampleHeaderSize;
+
+        for(int s = 0; s < numSamples; s++)
+        {
+            uint8_t sampleInfo[18];
+            if(file.read(offset + s * sampleHeaderSize, 18, reinterpret_cast<char *>(sampleInfo)) != 18)
+                return false;
+
+            uint32_t storedLength = getUint32LE(sampleInfo);
+            bool is16Bit = sampleInfo[14] & 0x10;
+            int shift = is16Bit ? 1 : 0;
+
+            ModuleSample sample;
+            sample.length = storedLength >> shift;
+            sample.volume = std::min(sampleInfo[12], uint8_t(64));
+            sample.finetune = int8_t(sampleInfo[13]);
+            sample.relativeNote = int8_t(sampleInfo[16]);
+
+            int loopType = sampleInfo[14] & 3;
+            if(loopType == 1 || loopType == 2)
+            {
+                sample.loop = loopType == 1 ? ModuleSample::Loop::Forward : ModuleSample::Loop::PingPong;
+                sample.loopStart = getUint32LE(sampleInfo + 4) >> shift;
+                sample.loopEnd = sample.loopStart + (getUint32LE(sampleInfo + 8) >> shift);
+            }
+
+            trimToLoop(sample);
+
+            // too many samples, keep reading through them to get to the next instrument
+            if(firstSample + s >= ModuleInstrument::noSample)
+            {
+                dataOffset += storedLength;
+                continue;
+            }
+
+            auto data = addSampleData(sample, sample.length, is16Bit);
+            if(!data)
+                return false;
+
+            if(sample.length)
+                file.read(dataOffset, sample.length << shift, reinterpret_cast<char *>(data));
+
+            dataOffset += storedLength;
+
+            // delta encoded
+            if(is16Bit)
+            {
+                auto data16 = reinterpret_cast<int16_t *>(data);
+                int16_t last = 0;
+
+                for(uint32_t j = 0; j < sample.length; j++)
+                    data16[j] = last += int16_t(getUint16LE(reinterpret_cast<uint8_t *>(data16 + j)));
+            }
+            else
+            {
+                int8_t last = 0;
+
+                for(uint32_t j = 0; j < sample.length; j++)
+                    data[j] = last += data[j];
+            }
+
+            finishSample(sample);
+            samples.push_back(sample);
+        }
+
+        offset = dataOffset;
+    }
+
+    // orders past the end of the patterns
+    patterns.push_back({64, uint32_t(patternData.size())});
+    patternData.insert(patternData.end(), 64 * channels, 0);
+
+    return true;
+}
+
+void TrackerModule::packNote(const ModuleNote &note)
+{
+    uint8_t flags = (note.note ? 1 : 0) | (note.instrument ? 2 : 0) | (note.volume ? 4 : 0) | (note.effect ? 8 : 0) | (note.param ? 16 : 0);
+
+    patternData.push_back(flags);
+
+    if(note.note)
+        patternData.push_back(note.note);
+    if(note.instrument)
+        patternData.push_back(note.instrument);
+    if(note.volume)
+        patternData.push_back(note.volume);
+    if(note.effect)
+        patternData.push_back(note.effect);
+    if(note.param)
+        patternData.push_back(note.param);
+}
+
+int8_t *TrackerModule::addSampleData(ModuleSample &sample, uint32_t length, bool is16Bit)
+{
+    // 16-bit samples are aligned
+    uint32_t offset = (sampleData.size() + 1) & ~1;
+    uint32_t bytes = (length + 1) << (is16Bit ? 1 : 0);
+
+    if(offset + bytes > maxSampleBytes)
+        return nullptr;
+
+    sample.is16Bit = is16Bit;
+    sample.dataOffset = offset;
+
+    sampleData.resize(offset + bytes);
+
+    return sampleData.data() + offset;
+}
+
+void TrackerModule::finishSample(const ModuleSample &sample)
+{
+    if(!sample.length)
+        return;
+
+    // set the extra sample to whatever plays next, so interpolation doesn't need to check for the end
+    uint32_t next = sample.length;
+
+    if(sample.loop == ModuleSample::Loop::Forward)
+        next = sample.loopStart;
+    else if(sample.loop == ModuleSample::Loop::PingPong)
+        next = sample.length - 1;
+
+    if(sample.is16Bit)
+    {
+        auto data = reinterpret_cast<int16_t *>(sampleData.data() + sample.dataOffset);
+        data[sample.length] = next == sample.length ? 0 : data[next];
+    }
+    else
+    {
+        auto data = sampleData.data() + sample.dataOffset;
+        data[sample.length] = next == sample.length ? 0 : data[next];
+    }
+}
+
+void TrackerModule::addSampleInstruments()
+{
+    instruments.resize(samples.size());
+
+    for(size_t i = 0; i < samples.size(); i++)
+        memset(instruments[i].sampleMap, i, sizeof(instruments[i].sampleMap));
+}
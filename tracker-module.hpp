@@ -0,0 +1,165 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "stream-file.hpp"
+
+// MOD, S3M and XM files, loaded into memory in one format for ModulePlayer
+// patterns are kept packed and effects are converted to their XM equivalents
+
+namespace ModuleEffect
+{
+    enum : uint8_t
+    {
+        Arpeggio = 0,
+        PortaUp,
+        PortaDown,
+        TonePorta,
+        Vibrato,
+        TonePortaVolSlide,
+        VibratoVolSlide,
+        Tremolo,
+        SetPan,
+        SampleOffset,
+        VolSlide,
+        PositionJump,
+        SetVolume,
+        PatternBreak,
+        Extended, // Exy
+        SpeedTempo,
+        SetGlobalVolume,
+        GlobalVolSlide,
+        KeyOff = 20,
+        MultiRetrig = 27,
+        ExtraFinePorta = 33, // X1y/X2y
+    };
+}
+
+struct ModuleSample
+{
+    enum class Loop : uint8_t
+    {
+        None,
+        Forward,
+        PingPong,
+    };
+
+    // in samples, anything after the loop is dropped
+    uint32_t length = 0, loopStart = 0, loopEnd = 0;
+    Loop loop = Loop::None;
+
+    uint8_t volume = 64;
+    int8_t finetune = 0; // 1/128 semitones
+    int8_t relativeNote = 0;
+
+    // into TrackerModule::sampleData, which has one extra sample after the end to interpolate towards
+    bool is16Bit = false;
+    uint32_t dataOffset = 0;
+};
+
+struct ModuleEnvelope
+{
+    static const int maxPoints = 12;
+
+    struct Point
+    {
+        uint16_t tick;
+        uint8_t value; // 0-64
+    };
+
+    bool enabled = false, sustain = false, loop = false;
+    int numPoints = 0;
+    int sustainPoint = 0, loopStart = 0, loopEnd = 0;
+    Point points[maxPoints];
+};
+
+struct ModuleInstrument
+{
+    static const uint8_t noSample = 0xFF;
+
+    // note -> TrackerModule::samples
+    uint8_t sampleMap[96];
+
+    ModuleEnvelope volumeEnvelope;
+    uint16_t fadeout = 0; // per tick after key off, out of 32768
+};
+
+struct ModuleNote
+{
+    static const uint8_t noteOff = 97;
+
+    uint8_t note = 0; // 1 (C-0) - 96, noteOff or 0 for nothing
+    uint8_t instrument = 0; // 1-based
+    uint8_t volume = 0; // XM volume column
+    uint8_t effect = 0, param = 0;
+};
+
+struct ModulePattern
+{
+    int rows = 0;
+    uint32_t offset = 0; // into TrackerModule::patternData
+};
+
+class TrackerModule final
+{
+public:
+    enum class Format
+    {
+        MOD,
+        S3M,
+        XM,
+    };
+
+    static const int maxChannels = 32;
+
+    // S3M order list markers
+    static const uint8_t skipOrder = 0xFE, endOrder = 0xFF;
+
+    // detects the format from the header
+    bool load(StreamFile &file);
+
+    // if the start of a file (up to 1084 bytes for MOD) looks like a module
+    static bool probe(const uint8_t *header, int length);
+    void clear();
+
+    // unpacks a row of every channel, returns the data for the next one
+    static const uint8_t *unpackRow(const uint8_t *data, ModuleNote *row, int channels);
+
+    // start of a row, skipping the ones before it
+    const uint8_t *getRowData(int pattern, int row) const;
+
+    Format format = Format::MOD;
+    std::string title;
+
+    int channels = 0;
+    bool linearPeriods = false; // XM, otherwise Amiga periods
+    bool effectMemory = true; // MOD effects with a 0 parameter do nothing instead of repeating
+
+    int initialSpeed = 6, initialTempo = 125, initialGlobalVolume = 64;
+
+    std::vector<uint8_t> orders;
+    std::vector<ModulePattern> patterns;
+    std::vector<uint8_t> patternData;
+
+    std::vector<ModuleInstrument> instruments;
+    std::vector<ModuleSample> samples;
+    std::vector<int8_t> sampleData;
+
+private:
+    static bool getFormat(const uint8_t *header, int length, Format &format);
+
+    bool loadMOD(StreamFile &file, const uint8_t *header);
+    bool loadS3M(StreamFile &file, const uint8_t *header);
+    bool loadXM(StreamFile &file, const uint8_t *header);
+
+    void packNote(const ModuleNote &note);
+
+    // makes space for a sample in sampleData, returns nullptr if it's too large
+    int8_t *addSampleData(ModuleSample &sample, uint32_t length, bool is16Bit);
+    // after the data has been read
+    void finishSample(const ModuleSample &sample);
+
+    // instrument n uses sample n for every note
+    void addSampleInstruments();
+};
@@ -0,0 +1,291 @@
+#include <cmath>
+
+#include "visualiser.hpp"
+#include "trace.hpp"
+
+#ifdef PROFILER
+#include "engine/profiler.hpp"
+extern blit::ProfilerProbe *profilerVisProbe;
+#endif
+
+static const float pi = 3.14159265358979f;
+
+// range of the bars
+static const float floorDb = -60.0f;
+
+// per frame
+static const float decayDb = 1.5f;
+
+struct Complex16
+{
+    int16_t re, im;
+};
+
+static float toDb(float v)
+{
+    return v > 0.0f ? 20.0f * log10f(v) : floorDb;
+}
+
+// approximate magnitude, max + min / 2
+static int32_t magnitude(int32_t re, int32_t im)
+{
+    re = re < 0 ? -re : re;
+    im = im < 0 ? -im : im;
+    return re > im ? re + im / 2 : im + re / 2;
+}
+
+const char *Visualiser::getModeName(Mode mode)
+{
+    switch(mode)
+    {
+        case Mode::Off:
+            return "Off";
+        case Mode::VU:
+            return "VU";
+        case Mode::Scope:
+            return "Scope";
+        case Mode::Spectrum:
+            return "Spectrum";
+        default:
+            return "?";
+    }
+}
+
+Visualiser::Visualiser()
+{
+    for(int i = 0; i < fftSize; i++)
+        window[i] = static_cast<int16_t>((0.5f - 0.5f * cosf(2.0f * pi * i / fftSize)) * 32767.0f);
+
+    for(int i = 0; i < fftSize / 2; i++)
+    {
+        twiddleCos[i] = static_cast<int16_t>(cosf(2.0f * pi * i / fftSize) * 32767.0f);
+        twiddleSin[i] = static_cast<int16_t>(sinf(2.0f * pi * i / fftSize) * 32767.0f);
+    }
+
+    // log spaced bands over bins 1-128, at least one bin each
+    bandStart[0] = 1;
+    for(int i = 1; i <= numBands; i++)
+    {
+        int start = static_cast<int>(powf(fftSize / 2.0f, static_cast<float>(i) / numBands) + 0.5f);
+        bandStart[i] = std::max(start, bandStart[i - 1] + 1);
+    }
+
+    // squash the top end back into range
+    for(int i = numBands, end = fftSize / 2 + 1; i > 0 && bandStart[i] >= end; i--, end--)
+        bandStart[i] = end;
+}
+
+void Visualiser::render(blit::Surface &dest, const blit::Rect &rect, Mode mode, const int16_t *samples, int count)
+{
+#ifdef PROFILER
+    blit::ScopedProfilerProbe scopedProbe(profilerVisProbe);
+#endif
+    TRACE_SCOPE("Visualiser");
+
+    switch(mode)
+    {
+        case Mode::VU:
+            renderVU(dest, rect, samples, count);
+            break;
+
+        case Mode::Scope:
+            renderScope(dest, rect, samples, count);
+            break;
+
+        case Mode::Spectrum:
+            renderSpectrum(dest, rect, samples, count);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void Visualiser::renderVU(blit::Surface &dest, const blit::Rect &rect, const int16_t *samples, int count)
+{
+    int64_t sumSq = 0;
+    int32_t peak = 0;
+
+    for(int i = 0; i < count; i++)
+    {
+        int32_t s = samples[i];
+        sumSq += s * s;
+        peak = std::max(peak, s < 0 ? -s : s);
+    }
+
+    float rmsDb = count ? toDb(sqrtf(static_cast<float>(sumSq) / count) / 32768.0f) : floorDb;
+    float peakDb = toDb(peak / 32768.0f);
+
+    vuLevel = std::max(rmsDb - floorDb, vuLevel - decayDb);
+    vuLevel = std::max(vuLevel, 0.0f);
+
+    if(peakDb - floorDb >= vuPeak)
+    {
+        vuPeak = peakDb - floorDb;
+        vuPeakHold = 30;
+    }
+    else if(vuPeakHold)
+        vuPeakHold--;
+    else
+        vuPeak = std::max(vuPeak - decayDb, 0.0f);
+
+    int barH = rect.h / 2;
+    int barY = rect.y + (rect.h - barH) / 2;
+    int w = static_cast<int>(vuLevel / -floorDb * rect.w);
+    int peakX = static_cast<int>(vuPeak / -floorDb * rect.w);
+
+    dest.pen = blit::Pen(0, 0, 0);
+    dest.rectangle(blit::Rect(rect.x, barY, rect.w, barH));
+
+    // green up to -12dB, then yellow, red over -3dB
+    const int yellowX = static_cast<int>((floorDb + 12.0f) / floorDb * rect.w), redX = static_cast<int>((floorDb + 3.0f) / floorDb * rect.w);
+
+    dest.pen = blit::Pen(0, 200, 0);
+    dest.rectangle(blit::Rect(rect.x, barY, std::min(w, yellowX), barH));
+
+    if(w > yellowX)
+    {
+        dest.pen = blit::Pen(220, 220, 0);
+        dest.rectangle(blit::Rect(rect.x + yellowX, barY, std::min(w, redX) - yellowX, barH));
+    }
+
+    if(w > redX)
+    {
+        dest.pen = blit::Pen(255, 0, 0);
+        dest.rectangle(blit::Rect(rect.x + redX, barY, w - redX, barH));
+    }
+
+    dest.pen = blit::Pen(255, 255, 255);
+    dest.v_span(blit::Point(rect.x + std::min(peakX, rect.w - 1), barY), barH);
+}
+
+void Visualiser::renderScope(blit::Surface &dest, const blit::Rect &rect, const int16_t *samples, int count)
+{
+    dest.pen = blit::Pen(0, 0, 0);
+    dest.rectangle(rect);
+
+    if(count < 2)
+        return;
+
+    dest.pen = blit::Pen(0, 255, 128);
+
+    int centerY = rect.y + rect.h / 2;
+    blit::Point last;
+
+    for(int x = 0; x < rect.w; x++)
+    {
+        int sample = samples[x * (count - 1) / (rect.w - 1)];
+        blit::Point p(rect.x + x, centerY - sample * (rect.h / 2) / 32768);
+
+        if(x)
+            dest.line(last, p);
+
+        last = p;
+    }
+}
+
+void Visualiser::renderSpectrum(blit::Surface &dest, const blit::Rect &rect, const int16_t *samples, int count)
+{
+    if(count >= fftSize)
+        calcSpectrum(samples);
+    else
+    {
+        // not enough data, just let it fall
+        for(auto &level : bandLevel)
+            level = std::max(level - decayDb, 0.0f);
+    }
+
+    dest.pen = blit::Pen(0, 0, 0);
+    dest.rectangle(rect);
+
+    int barW = rect.w / numBands;
+
+    for(int i = 0; i < numBands; i++)
+    {
+        int h = std::min(static_cast<int>(bandLevel[i] / -floorDb * rect.h), rect.h);
+
+        dest.pen = blit::Pen(i * 255 / numBands, 255 - i * 255 / numBands, 255);
+        dest.rectangle(blit::Rect(rect.x + i * barW, rect.y + rect.h - h, barW - 1, h));
+    }
+}
+
+void Visualiser::calcSpectrum(const int16_t *samples)
+{
+    // real FFT as a half-size complex FFT of the even/odd samples
+    const int n = fftSize / 2;
+    Complex16 data[n];
+
+    // window and bit-reverse
+    const int bits = 7;
+    static_assert(1 << bits == n, "bits doesn't match FFT size");
+
+    for(int i = 0; i < n; i++)
+    {
+        int rev = 0;
+        for(int b = 0; b < bits; b++)
+            rev |= ((i >> b) & 1) << (bits - 1 - b);
+
+        data[rev].re = (samples[i * 2] * window[i * 2]) >> 15;
+        data[rev].im = (samples[i * 2 + 1] * window[i * 2 + 1]) >> 15;
+    }
+
+    // radix-2, halving each stage so nothing overflows
+    for(int size = 2; size <= n; size *= 2)
+    {
+        int half = size / 2;
+        int twiddleStep = fftSize / size;
+
+        for(int start = 0; start < n; start += size)
+        {
+            for(int k = 0; k < half; k++)
+            {
+                int32_t wr = twiddleCos[k * twiddleStep], wi = -twiddleSin[k * twiddleStep];
+
+                auto &a = data[start + k];
+                auto &b = data[start + k + half];
+
+                int32_t tr = (b.re * wr - b.im * wi) >> 15;
+                int32_t ti = (b.re * wi + b.im * wr) >> 15;
+
+                b.re = (a.re - tr) >> 1;
+                b.im = (a.im - ti) >> 1;
+                a.re = (a.re + tr) >> 1;
+                a.im = (a.im + ti) >> 1;
+            }
+        }
+    }
+
+    // split into the real spectrum, only need magnitudes of bins 1-128
+    int32_t mags[n + 1];
+
+    for(int k = 1; k <= n; k++)
+    {
+        auto &z0 = data[k % n];
+        auto &z1 = data[(n - k) % n];
+
+        // even = (Z[k] + conj(Z[n - k])) / 2, odd = (Z[k] - conj(Z[n - k])) / 2j
+        int32_t er = (z0.re + z1.re) >> 1, ei = (z0.im - z1.im) >> 1;
+        int32_t or_ = (z0.im + z1.im) >> 1, oi = (z1.re - z0.re) >> 1;
+
+        // X[k] = even + W^k * odd
+        int32_t wr = k < n ? twiddleCos[k] : -32767, wi = k < n ? -twiddleSin[k] : 0;
+
+        int32_t re = er + ((or_ * wr - oi * wi) >> 15);
+        int32_t im = ei + ((or_ * wi + oi * wr) >> 15);
+
+        mags[k] = magnitude(re, im);
+    }
+
+    for(int i = 0; i < numBands; i++)
+    {
+        int32_t peak = 0;
+        for(int k = bandStart[i]; k < bandStart[i + 1]; k++)
+            peak = std::max(peak, mags[k]);
+
+        // the scaled FFT gives 1/2 for a full scale sine
+        float db = toDb(peak / 16384.0f) - floorDb;
+
+        bandLevel[i] = std::max(db, bandLevel[i] - decayDb);
+        bandLevel[i] = std::max(bandLevel[i], 0.0f);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+
+#include "32blit.hpp"
+
+// VU meter/oscilloscope/spectrum of the samples about to be played
+class Visualiser final
+{
+public:
+    enum class Mode : uint8_t
+    {
+        Off = 0,
+        VU,
+        Scope,
+        Spectrum,
+
+        Count
+    };
+
+    static const char *getModeName(Mode mode);
+
+    Visualiser();
+
+    // samples should be the next ones to play, at most one call per frame
+    void render(blit::Surface &dest, const blit::Rect &rect, Mode mode, const int16_t *samples, int count);
+
+    // 256 point FFT
+    static const int fftSize = 256;
+
+private:
+    void renderVU(blit::Surface &dest, const blit::Rect &rect, const int16_t *samples, int count);
+    void renderScope(blit::Surface &dest, const blit::Rect &rect, const int16_t *samples, int count);
+    void renderSpectrum(blit::Surface &dest, const blit::Rect &rect, const int16_t *samples, int count);
+
+    void calcSpectrum(const int16_t *samples);
+
+    static const int numBands = 32;
+
+    // Q15
+    int16_t window[fftSize];
+    int16_t twiddleCos[fftSize / 2], twiddleSin[fftSize / 2];
+
+    uint8_t bandStart[numBands + 1];
+
+    // dB above the floor, decaying
+    float bandLevel[numBands]{};
+    float vuLevel = 0.0f, vuPeak = 0.0f;
+    int vuPeakHold = 0;
+};
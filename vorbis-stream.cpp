@@ -1,22 +1,51 @@
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 
 #include "vorbis-stream.hpp"
+#include "replay-gain.hpp"
+#include "stream-registry.hpp"
 
-#include "audio/audio.hpp"
-#include "engine/engine.hpp"
-#include "engine/file.hpp"
+#include "stream-file.hpp"
 
-#ifdef PROFILER
-#include "engine/profiler.hpp"
-extern blit::ProfilerProbe *profilerRefillProbe;
-extern blit::ProfilerProbe *profilerReadProbe;
-extern blit::ProfilerProbe *profilerDecProbe;
-#endif
+// the mono quality modes only run the IMDCT for the first channel, see the inverse_mdct overload below
+struct DecodeTag {};
+
+static void inverse_mdct(float *buffer, int n, stb_vorbis *f, int blocktype, DecodeTag);
+
+#define inverse_mdct(...) inverse_mdct(__VA_ARGS__, DecodeTag())
 
 #define STB_VORBIS_NO_PUSHDATA_API
 #include "stdio-wrap.hpp"
 #include "stb_vorbis.c"
 
+#undef inverse_mdct
+
+// set while decoding a packet in one of the mono modes
+static bool mixToFirstChannel = false;
+
+static void inverse_mdct(float *buffer, int n, stb_vorbis *f, int blocktype, DecodeTag)
+{
+    if(mixToFirstChannel)
+    {
+        if(buffer != f->channel_buffers[0])
+        {
+            // clear it so that there's nothing odd in the overlap if the mode goes back to full
+            memset(buffer, 0, n * sizeof(float));
+            return;
+        }
+
+        // the transform is linear, so adding the spectra gives the same mix as stb_vorbis_get_samples_short does
+        for(int c = 1; c < f->channels; c++)
+        {
+            for(int i = 0; i < n / 2; i++)
+                buffer[i] += f->channel_buffers[c][i];
+        }
+    }
+
+    inverse_mdct(buffer, n, f, blocktype, nullptr);
+}
+
 VorbisStream::VorbisStream()
 {
 
@@ -28,15 +57,17 @@ VorbisStream::~VorbisStream()
         stb_vorbis_close(vorbis);
 }
 
-bool VorbisStream::load(std::string filename)
+bool VorbisStream::probe(const uint8_t *header, int length)
 {
-    if(channel != -1)
-        blit::channels[channel].off();
+    // the identification header is always alone in the first page
+    return length >= 35 && memcmp(header, "OggS", 4) == 0 && memcmp(header + 28, "\x01vorbis", 7) == 0;
+}
+
+static StreamRegistry::Format format("Ogg Vorbis", {".ogg", ".oga"}, &VorbisStream::probe, []() -> AudioDecoder & {static VorbisStream decoder; return decoder;});
 
-    currentSample = nullptr;
-    bufferedSamples = 0;
-    needConvert = false;
-    supported = true;
+bool VorbisStream::open(const std::string &filename, SourceInfo &info, MusicTags &tags)
+{
+    monoPacket = false;
 
     if(vorbis)
     {
@@ -57,18 +88,16 @@ bool VorbisStream::load(std::string filename)
     auto durationSamples = calcDuration(filename);
 
     // get info
-    auto info = stb_vorbis_get_info(vorbis);
-    channels = info.channels;
-    sampleRate = info.sample_rate;
+    auto vorbisInfo = stb_vorbis_get_info(vorbis);
+    channels = vorbisInfo.channels;
+    sampleRate = vorbisInfo.sample_rate;
 
-    needConvert = sampleRate != 22050;
-    supported = sampleRate % 22050 == 0;
+    if(!sampleRate)
+        return false;
 
-    durationMs = (durationSamples * 1000) / sampleRate;
+    int durationMs = (durationSamples * 1000) / sampleRate;
 
     // comments/tags
-    tags = MusicTags();
-
     auto comments = stb_vorbis_get_comment(vorbis);
 
     for(int i = 0; i < comments.comment_list_length; i++)
@@ -90,10 +119,26 @@ bool VorbisStream::load(std::string filename)
             tags.title = commentStr.substr(equals + 1);
         else if(key == "TRACK")
             tags.track = commentStr.substr(equals + 1);
+        else if(parseReplayGainTag(key, commentStr.c_str() + equals + 1, tags))
+            continue;
         else if(commentStr.length() < 1024 * 8) // avoid touching huge strings
             printf("%s: %s\n", key.c_str(), commentStr.substr(equals + 1).c_str());
     }
 
+    info.sampleRate = sampleRate;
+    info.channels = channels;
+    info.blockChannels = 1;
+    info.totalFrames = durationSamples;
+    info.fileLength = fileLength;
+
+    // Vorbis is about one and a half times the cost of MP3 at the same rate/bitrate
+    int bitrateKbps = durationMs ? uint64_t(fileLength) * 8 / durationMs : 0;
+    info.cost = QualityGovernor::estimateCost(1.5f, sampleRate, channels, bitrateKbps);
+
+    // don't count the header/comment reads
+    vorbis->f->file.resetStats();
+    vorbis->f->getc_calls = vorbis->f->getc_refills = 0;
+
     return true;
 }
 
@@ -111,203 +156,105 @@ bool VorbisStream::load(std::string filename)
     return ret;
 }*/
 
-void VorbisStream::play(int channel)
+int VorbisStream::decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels)
 {
-    if(!vorbis)
-        return;
-
-    this->channel = channel;
+    // decode the next packet once everything from the last one has been used
+    int available = vorbis->channel_buffer_end - vorbis->channel_buffer_start;
 
-    if(!currentSample)
+    if(!available)
     {
-        decode(0);
-        decode(1);
+        monoPacket = channels > 1 && mode >= QualityMode::Mono;
 
-        curAudioBuf = 0;
-        currentSample = audioBuf[0];
-        endSample = currentSample + dataSize[0];
-        blit::channels[channel].wave_buf_pos = 0;
+        float **outputs;
+        mixToFirstChannel = monoPacket;
+        available = stb_vorbis_get_frame_float(vorbis, nullptr, &outputs);
+        mixToFirstChannel = false;
     }
 
-    blit::channels[channel].waveforms = blit::Waveform::WAVE;
-    blit::channels[channel].user_data  = this;
-    blit::channels[channel].wave_buffer_callback = &VorbisStream::staticCallback;
-
-    //blit::channels[channel].trigger_attack();
-    blit::channels[channel].adsr = 0xFFFF00;
-    blit::channels[channel].trigger_sustain();
-}
-
-void VorbisStream::pause()
-{
-    blit::channels[channel].off();
-}
+    if(!available)
+        return 0;
 
-bool VorbisStream::getPlaying() const
-{
-    return channel != -1 && blit::channels[channel].adsr_phase == blit::ADSRPhase::SUSTAIN;
-}
+    // long packets are split into blocks
+    int size = std::min(available, maxFrames);
 
-void VorbisStream::update()
-{
-    if(!currentSample)
-        return;
+    blockChannels = 1;
 
-    // refill audio buffers
-    for(int i = 0; i < 2; i++)
+    if(monoPacket)
     {
-        if(!dataSize[i])
-            decode(i);
-    }    
-}
-
-int VorbisStream::getCurrentSample() const
-{
-    if(channel == -1)
-        return 0;
+        // everything was mixed into the first channel
+        copy_samples(out, vorbis->channel_buffers[0] + vorbis->channel_buffer_start, size);
+        vorbis->channel_buffer_start += size;
+        return size;
+    }
 
-    return bufferedSamples + blit::channels[channel].wave_buf_pos;
+    short *buf[]{out};
+    return stb_vorbis_get_samples_short(vorbis, 1, buf, size);
 }
 
-int VorbisStream::getDurationMs() const
+uint64_t VorbisStream::seek(int ms)
 {
-    return durationMs;
-}
+    uint64_t sample = static_cast<uint64_t>(ms) * sampleRate / 1000;
+    stb_vorbis_seek(vorbis, sample);
 
-const MusicTags &VorbisStream::getTags() const
-{
-    return tags;
-}
+    // anything left of the packet was decoded with all the channels
+    monoPacket = false;
 
-bool VorbisStream::getFileSupported() const
-{
-    return supported;
+    return sample;
 }
 
-void VorbisStream::decode(int bufIndex)
+uint32_t VorbisStream::getInputPos() const
 {
-#ifdef PROFILER
-    blit::ScopedProfilerProbe scopedProbe(profilerRefillProbe);
-#endif
-
-    int samples = 0;
-    int freqScale = sampleRate / 22050;
-
-    if(needConvert)
-    {
-        while(samples < audioBufSize)
-        {
-            int16_t tmpBuf[audioBufSize];
-            const int maxSize = audioBufSize;
-            const int size = std::min(maxSize, (maxSize - samples) * freqScale);
-
-            short *buf[]{tmpBuf};
-            int tmpSamples = stb_vorbis_get_samples_short(vorbis, 1, buf, size);
-
-            if(!tmpSamples)
-                break;
-
-            for(int i = 0; i < tmpSamples; i += freqScale, samples++)
-            {
-                int32_t tmp = 0;
-                for(int j = 0; j < freqScale && i + j < tmpSamples; j++)
-                    tmp += tmpBuf[i + j];
-                
-                audioBuf[bufIndex][samples] = tmp / freqScale;
-            }
-        }
-    }
-    else
-    {
-        short *buf[]{audioBuf[bufIndex]};
-        samples = stb_vorbis_get_samples_short(vorbis, 1, buf, audioBufSize);
-    }
-
-    if(!samples)
-    {
-        dataSize[bufIndex] = -1;
-        return;
-    }
-
-    // pad samples, should only happen at the end of the file
-    while(samples % 64)
-        audioBuf[bufIndex][samples++] = 0;
-
-    dataSize[bufIndex] = samples;
+    return stb_vorbis_get_file_offset(vorbis);
 }
 
-void VorbisStream::staticCallback(blit::AudioChannel &channel)
+const StreamFile &VorbisStream::getFile() const
 {
-    reinterpret_cast<VorbisStream *>(channel.user_data)->callback(channel);
+    return vorbis->f->file;
 }
 
-void VorbisStream::callback(blit::AudioChannel &channel)
+void VorbisStream::updateStats(StreamStats &stats) const
 {
-    if(!currentSample)
-    {
-        channel.off();
-        return;
-    }
-
-    // there was no buffer last time
-    if(currentSample == endSample)
-    {
-        if(dataSize[curAudioBuf])
-        {
-            // recover from underrun
-            endSample = audioBuf[curAudioBuf] + dataSize[curAudioBuf];
-        }
-        else
-        {
-            memset(channel.wave_buffer, 0, 64 * sizeof(int16_t));
-            return;
-        }
-    }
-
-    auto out = channel.wave_buffer;
-
-    int i = 0;
-    for(; i < 64; i++)
-        *(out++) = *(currentSample++);
-
-    // swap buffers
-    if(currentSample == endSample)
-    {
-        dataSize[curAudioBuf] = 0;
-        curAudioBuf = ++curAudioBuf % 2;
-
-        if(dataSize[curAudioBuf] == -1) // EOF
-            currentSample = endSample = nullptr;
-        else
-        {
-            currentSample = audioBuf[curAudioBuf];
-            endSample = currentSample + dataSize[curAudioBuf];
-
-            // if(currentSample == endSample)
-            // no more samples available - underrun
-        }
-    }
-
-    bufferedSamples += 64;
+    auto f = vorbis->f;
+    stats.cacheHits = f->getc_calls - f->getc_refills;
+    stats.cacheMisses = f->getc_refills;
 }
 
 uint64_t VorbisStream::calcDuration(std::string filename)
 {
     // scan through the file backwards to find the sample pos of the last page
 
-    blit::File file(filename);
+    StreamFile file(filename);
     if(!file.is_open())
         return 0;
 
-    auto length = file.get_length();
+    auto length = fileLength = file.get_length();
     const int chunkLen = 1024;
     
-    for(uint32_t offset = chunkLen; offset < length; offset += chunkLen - 14)
+    // chunks overlap by the 14 bytes of header that are needed, the last one is cut short at the start of the file
+    for(uint32_t end = length; end > 14;)
     {
         uint8_t buf[chunkLen];
-        file.read(length - offset, chunkLen, reinterpret_cast<char *>(buf));
 
-        for(int i = chunkLen - 14; i >= 0; i--)
+        uint32_t start = end > chunkLen ? end - chunkLen : 0;
+        int32_t len = end - start;
+
+        // retry short reads, the scan needs the whole chunk
+        int32_t got = 0;
+        while(got < len)
+        {
+            auto read = file.read(start + got, len - got, reinterpret_cast<char *>(buf) + got);
+            if(read <= 0)
+                return 0;
+
+            got += read;
+        }
+
+        if(!start)
+            end = 0;
+        else
+            end = start + 14;
+
+        for(int i = len - 14; i >= 0; i--)
         {
             if(memcmp(buf + i, "OggS", 4) == 0)
             {
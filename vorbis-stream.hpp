@@ -2,62 +2,45 @@
 
 #include <string>
 
-#include "audio/audio.hpp"
-#include "engine/file.hpp"
+#include "stream-file.hpp"
 
-#include "music-stream.hpp"
+#include "audio-decoder.hpp"
 #include "music-tags.hpp"
 
 struct stb_vorbis;
 
-class VorbisStream final : public MusicStream
+class VorbisStream final : public AudioDecoder
 {
 public:
 
     VorbisStream();
     ~VorbisStream();
 
-    bool load(std::string filename);
+    bool open(const std::string &filename, SourceInfo &info, MusicTags &tags);
 
-    //MusicTags parseTags(std::string filename);
-
-    void play(int channel);
-    void pause();
+    // looks at the start of a file, for StreamRegistry
+    static bool probe(const uint8_t *header, int length);
 
-    bool getPlaying() const;
+    //MusicTags parseTags(std::string filename);
 
-    void update();
+    // always mixed to mono, the same way as stb_vorbis_get_samples_short
+    int decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels);
 
-    int getCurrentSample() const;
-    int getDurationMs() const;
+    uint64_t seek(int ms);
 
-    const MusicTags &getTags() const;
+    uint32_t getInputPos() const;
+    const StreamFile &getFile() const;
 
-    bool getFileSupported() const;
+    void updateStats(StreamStats &stats) const;
 
 private:
-    void decode(int bufIndex);
     uint64_t calcDuration(std::string filename);
 
-    static void staticCallback(blit::AudioChannel &channel);
-    void callback(blit::AudioChannel &channel);
-
-    int channel = -1;
+    uint32_t fileLength = 0;
 
     stb_vorbis *vorbis;
     unsigned int channels, sampleRate;
-    bool needConvert = false;
-
-    static const int audioBufSize = 1024 * 4;
-    int16_t audioBuf[2][audioBufSize];
-    int16_t *currentSample = nullptr, *endSample = nullptr;
-    int dataSize[2]{};
-    int curAudioBuf = 0;
-
-    int bufferedSamples = 0;
-    int durationMs = 0;
-
-    MusicTags tags;
 
-    bool supported = true;
-};
\ No newline at end of file
+    // the last packet was decoded in one of the mono modes
+    bool monoPacket = false;
+};
@@ -0,0 +1,489 @@
+#include <algorithm>
+#include <cstring>
+
+#include "wav-stream.hpp"
+#include "stream-registry.hpp"
+
+#include "trace.hpp"
+
+static const int formatPCM = 1;
+static const int formatMSADPCM = 2;
+static const int formatIMAADPCM = 0x11;
+static const int formatExtensible = 0xFFFE;
+
+static const int imaStepTable[89]
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411,
+    1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int imaIndexTable[16]
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int msAdaptTable[16]
+{
+    230, 230, 230, 230, 307, 409, 512, 614,
+    768, 614, 512, 409, 307, 230, 230, 230
+};
+
+// used if the fmt chunk doesn't have its own
+static const int16_t msDefaultCoefs[7][2]
+{
+    {256, 0}, {512, -256}, {0, 0}, {192, 64}, {240, 0}, {460, -208}, {392, -232}
+};
+
+static uint16_t getUint16(const uint8_t *buf)
+{
+    return buf[0] | buf[1] << 8;
+}
+
+static uint32_t getUint32(const uint8_t *buf)
+{
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | static_cast<uint32_t>(buf[3]) << 24;
+}
+
+static int16_t clamp16(int32_t v)
+{
+    return std::min(std::max(v, -32768), 32767);
+}
+
+bool WavStream::probe(const uint8_t *header, int length)
+{
+    return length >= 12 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WAVE", 4) == 0;
+}
+
+static StreamRegistry::Format format("WAV", {".wav"}, &WavStream::probe, []() -> AudioDecoder & {static WavStream decoder; return decoder;});
+
+bool WavStream::open(const std::string &filename, SourceInfo &info, MusicTags &tags)
+{
+    dataLength = dataPos = 0;
+    frameCount = framePos = 0;
+
+    if(!file.open(filename) || !parseChunks(tags))
+        return false;
+
+    info.sampleRate = sampleRate;
+    info.channels = info.blockChannels = channels;
+    info.totalFrames = totalFrames;
+    info.fileLength = file.get_length();
+
+    // reading is most of the cost, ADPCM is a few operations per sample on top
+    float codecCost = encoding == Encoding::PCM ? 0.05f : 0.1f;
+    info.cost = QualityGovernor::estimateCost(codecCost, sampleRate, channels, 0);
+
+    // don't count the chunk scan
+    file.resetStats();
+
+    return true;
+}
+
+int WavStream::decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels)
+{
+    // there's nothing to skip in the decode, only the resampler changes
+    blockChannels = channels;
+
+    if(encoding == Encoding::PCM)
+        return readPCM(out, maxFrames);
+
+    if(framePos == frameCount)
+    {
+        frameCount = readBlock();
+        framePos = 0;
+
+        if(!frameCount)
+            return 0;
+    }
+
+    // the rest of the block may be more than was asked for
+    int frames = std::min(frameCount - framePos, maxFrames);
+    memcpy(out, frameBuf + framePos * channels, frames * channels * sizeof(int16_t));
+    framePos += frames;
+
+    return frames;
+}
+
+uint64_t WavStream::seek(int ms)
+{
+    // every frame/block is the same size, so this is exact
+    uint32_t frame = std::min(static_cast<uint64_t>(ms) * sampleRate / 1000, uint64_t(totalFrames));
+
+    if(encoding == Encoding::PCM)
+    {
+        dataPos = frame * blockAlign;
+        frameCount = framePos = 0;
+    }
+    else
+    {
+        // decode the block and skip to the frame in it
+        dataPos = frame / samplesPerBlock * blockAlign;
+        frameCount = readBlock();
+        framePos = std::min(int(frame % samplesPerBlock), frameCount);
+    }
+
+    return frame;
+}
+
+uint32_t WavStream::getInputPos() const
+{
+    return dataPos;
+}
+
+const StreamFile &WavStream::getFile() const
+{
+    return file;
+}
+
+bool WavStream::parseChunks(MusicTags &tags)
+{
+    uint8_t buf[12];
+    uint32_t fileLength = file.get_length();
+
+    if(file.read(0, 12, reinterpret_cast<char *>(buf)) != 12 || memcmp(buf, "RIFF", 4) != 0 || memcmp(buf + 8, "WAVE", 4) != 0)
+        return false;
+
+    bool haveFormat = false;
+    uint32_t factFrames = 0;
+    dataOffset = 0;
+
+    uint32_t offset = 12;
+
+    while(offset + 8 <= fileLength)
+    {
+        if(file.read(offset, 8, reinterpret_cast<char *>(buf)) != 8)
+            break;
+
+        uint32_t len = getUint32(buf + 4);
+        offset += 8;
+
+        if(memcmp(buf, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[22 + maxCoefs * 4];
+            int32_t fmtLen = std::min(len, uint32_t(sizeof(fmt)));
+
+            if(file.read(offset, fmtLen, reinterpret_cast<char *>(fmt)) != fmtLen || !parseFormat(fmt, fmtLen))
+                return false;
+
+            haveFormat = true;
+        }
+        else if(memcmp(buf, "fact", 4) == 0 && len >= 4)
+        {
+            if(file.read(offset, 4, reinterpret_cast<char *>(buf)) == 4)
+                factFrames = getUint32(buf);
+        }
+        else if(memcmp(buf, "data", 4) == 0)
+        {
+            // the length may be missing (0/-1) if the file was streamed
+            dataOffset = offset;
+            dataLength = len == 0 || len > fileLength - offset ? fileLength - offset : len;
+        }
+        else if(memcmp(buf, "LIST", 4) == 0 && len >= 4)
+        {
+            if(file.read(offset, 4, reinterpret_cast<char *>(buf)) == 4 && memcmp(buf, "INFO", 4) == 0)
+                parseInfo(offset + 4, len - 4, tags);
+        }
+
+        // chunks are padded to an even length
+        if(len > fileLength - offset)
+            break;
+
+        offset += len + (len & 1);
+    }
+
+    if(!haveFormat || !dataLength)
+        return false;
+
+    if(encoding == Encoding::PCM)
+    {
+        dataLength -= dataLength % blockAlign;
+        totalFrames = dataLength / blockAlign;
+    }
+    else
+    {
+        // the last block may be partly padding, fact has the real length
+        totalFrames = (dataLength + blockAlign - 1) / blockAlign * samplesPerBlock;
+
+        if(factFrames)
+            totalFrames = std::min(totalFrames, factFrames);
+    }
+
+    return totalFrames != 0;
+}
+
+bool WavStream::parseFormat(const uint8_t *buf, uint32_t len)
+{
+    if(len < 16)
+        return false;
+
+    int format = getUint16(buf);
+    channels = getUint16(buf + 2);
+    sampleRate = getUint32(buf + 4);
+    blockAlign = getUint16(buf + 12);
+    bitsPerSample = getUint16(buf + 14);
+
+    // the real format is the first two bytes of the subformat GUID
+    if(format == formatExtensible && len >= 26)
+        format = getUint16(buf + 24);
+
+    if(!channels || !sampleRate || !blockAlign)
+        return false;
+
+    if(format == formatPCM)
+    {
+        encoding = Encoding::PCM;
+
+        if((bitsPerSample != 8 && bitsPerSample != 16) || blockAlign != channels * bitsPerSample / 8)
+            return false;
+
+        // the resampler mixes them all, this just keeps a block of frames in the buffers
+        return channels <= 8;
+    }
+
+    // ADPCM, mono/stereo and the whole block has to fit in the buffers
+    if(channels > 2 || blockAlign > fileBufferSize || bitsPerSample != 4 || len < 20)
+        return false;
+
+    samplesPerBlock = getUint16(buf + 18);
+
+    if(format == formatIMAADPCM)
+    {
+        encoding = Encoding::IMAADPCM;
+
+        // a header per channel, then 8 samples per 4 bytes per channel
+        int maxSamples = (blockAlign - 4 * channels) * 2 / channels + 1;
+
+        if(blockAlign % (4 * channels) || samplesPerBlock < 1 || samplesPerBlock > maxSamples)
+            return false;
+    }
+    else if(format == formatMSADPCM)
+    {
+        encoding = Encoding::MSADPCM;
+
+        // a 7 byte header per channel, which includes two samples
+        int maxSamples = (blockAlign - 7 * channels) * 2 / channels + 2;
+
+        if(samplesPerBlock < 2 || samplesPerBlock > maxSamples)
+            return false;
+
+        numCoefs = 0;
+
+        if(len >= 22)
+        {
+            numCoefs = std::min(int(getUint16(buf + 20)), std::min(maxCoefs, int(len - 22) / 4));
+
+            for(int i = 0; i < numCoefs; i++)
+            {
+                coefs[i][0] = getUint16(buf + 22 + i * 4);
+                coefs[i][1] = getUint16(buf + 24 + i * 4);
+            }
+        }
+
+        if(!numCoefs)
+        {
+            numCoefs = 7;
+            memcpy(coefs, msDefaultCoefs, sizeof(msDefaultCoefs));
+        }
+    }
+    else
+        return false;
+
+    return samplesPerBlock * channels <= frameBufSize;
+}
+
+void WavStream::parseInfo(uint32_t offset, uint32_t len, MusicTags &tags)
+{
+    auto end = offset + len;
+
+    while(offset + 8 <= end)
+    {
+        char buf[8];
+        if(file.read(offset, 8, buf) != 8)
+            break;
+
+        uint32_t itemLen = getUint32(reinterpret_cast<uint8_t *>(buf) + 4);
+        offset += 8;
+
+        // anything we care about is short
+        char value[128];
+        int32_t valueLen = std::min(itemLen, uint32_t(sizeof(value) - 1));
+
+        if(file.read(offset, valueLen, value) == valueLen)
+        {
+            value[valueLen] = 0;
+
+            if(memcmp(buf, "INAM", 4) == 0)
+                tags.title = value;
+            else if(memcmp(buf, "IART", 4) == 0)
+                tags.artist = value;
+            else if(memcmp(buf, "IPRD", 4) == 0)
+                tags.album = value;
+            else if(memcmp(buf, "ITRK", 4) == 0 || memcmp(buf, "IPRT", 4) == 0)
+                tags.track = value;
+        }
+
+        offset += itemLen + (itemLen & 1);
+    }
+}
+
+int WavStream::readPCM(int16_t *out, int maxFrames)
+{
+    TRACE_SCOPE("Read");
+
+    // 8-bit samples are converted from fileBuffer
+    if(bitsPerSample == 8)
+        maxFrames = std::min(maxFrames, fileBufferSize / channels);
+
+    int32_t len = std::min(dataLength - dataPos, uint32_t(maxFrames * blockAlign));
+
+    if(len <= 0)
+        return 0;
+
+    // 16-bit samples don't need converting, the file is little-endian, the same as everything this runs on
+    auto buf = bitsPerSample == 16 ? reinterpret_cast<uint8_t *>(out) : fileBuffer;
+
+    auto read = file.read(dataOffset + dataPos, len, reinterpret_cast<char *>(buf));
+
+    // whole frames only
+    if(read > 0)
+        read -= read % blockAlign;
+
+    if(read <= 0)
+        return 0;
+
+    dataPos += read;
+
+    int frames = read / blockAlign;
+
+    if(bitsPerSample == 8)
+    {
+        for(int i = 0; i < frames * channels; i++)
+            out[i] = (buf[i] - 128) << 8;
+    }
+
+    return frames;
+}
+
+int WavStream::readBlock()
+{
+    TRACE_SCOPE("Read");
+
+    int32_t len = std::min(dataLength - dataPos, uint32_t(blockAlign));
+
+    if(len <= 0)
+        return 0;
+
+    auto read = file.read(dataOffset + dataPos, len, reinterpret_cast<char *>(fileBuffer));
+
+    if(read <= 0)
+        return 0;
+
+    auto blockPos = dataPos;
+    dataPos += read;
+
+    int frames = encoding == Encoding::IMAADPCM ? decodeIMA(fileBuffer, read) : decodeMS(fileBuffer, read);
+
+    // drop the padding at the end of the last block
+    uint32_t blockStart = blockPos / blockAlign * samplesPerBlock;
+    return std::min(uint32_t(frames), totalFrames - std::min(blockStart, totalFrames));
+}
+
+int WavStream::decodeIMA(const uint8_t *in, int32_t len)
+{
+    // short last block
+    if(len < 4 * channels)
+        return 0;
+
+    int frames = std::min(samplesPerBlock, (len - 4 * channels) / (4 * channels) * 8 + 1);
+
+    for(int c = 0; c < channels; c++)
+    {
+        auto header = in + c * 4;
+        int32_t predictor = static_cast<int16_t>(getUint16(header));
+        int index = std::min(int(header[2]), 88);
+
+        auto out = frameBuf + c;
+        *out = predictor;
+        out += channels;
+
+        // groups of 4 bytes (8 samples) for each channel, low nibble first
+        auto data = in + channels * 4 + c * 4;
+
+        for(int i = 1; i < frames; i++)
+        {
+            int group = (i - 1) / 8, sampleInGroup = (i - 1) % 8;
+            int nibble = (data[group * channels * 4 + sampleInGroup / 2] >> ((sampleInGroup & 1) * 4)) & 0xF;
+
+            int step = imaStepTable[index];
+            int32_t diff = step >> 3;
+
+            if(nibble & 1)
+                diff += step >> 2;
+            if(nibble & 2)
+                diff += step >> 1;
+            if(nibble & 4)
+                diff += step;
+
+            predictor = clamp16(nibble & 8 ? predictor - diff : predictor + diff);
+            index = std::min(std::max(index + imaIndexTable[nibble], 0), 88);
+
+            *out = predictor;
+            out += channels;
+        }
+    }
+
+    return frames;
+}
+
+int WavStream::decodeMS(const uint8_t *in, int32_t len)
+{
+    if(len < 7 * channels)
+        return 0;
+
+    int frames = std::min(samplesPerBlock, (len - 7 * channels) * 2 / channels + 2);
+
+    // header: predictor for each channel, then delta, sample 1 and sample 2
+    int32_t coef1[2], coef2[2], delta[2], sample1[2], sample2[2];
+
+    for(int c = 0; c < channels; c++)
+    {
+        int predictor = std::min(int(in[c]), numCoefs - 1);
+        coef1[c] = coefs[predictor][0];
+        coef2[c] = coefs[predictor][1];
+
+        delta[c] = static_cast<int16_t>(getUint16(in + channels + c * 2));
+        sample1[c] = static_cast<int16_t>(getUint16(in + channels * 3 + c * 2));
+        sample2[c] = static_cast<int16_t>(getUint16(in + channels * 5 + c * 2));
+
+        // the older sample comes first
+        frameBuf[c] = sample2[c];
+        frameBuf[channels + c] = sample1[c];
+    }
+
+    // nibbles interleaved by channel, high nibble first
+    auto data = in + channels * 7;
+    auto out = frameBuf + channels * 2;
+    int numNibbles = (frames - 2) * channels;
+
+    for(int i = 0; i < numNibbles; i++)
+    {
+        int c = i % channels;
+        int nibble = (data[i / 2] >> ((i & 1) ? 0 : 4)) & 0xF;
+        int signedNibble = nibble >= 8 ? nibble - 16 : nibble;
+
+        int32_t predicted = (sample1[c] * coef1[c] + sample2[c] * coef2[c]) >> 8;
+        int32_t sample = clamp16(predicted + signedNibble * delta[c]);
+
+        sample2[c] = sample1[c];
+        sample1[c] = sample;
+
+        delta[c] = std::max((msAdaptTable[nibble] * delta[c]) >> 8, 16);
+
+        *out++ = sample;
+    }
+
+    return frames;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+
+#include "stream-file.hpp"
+
+#include "audio-decoder.hpp"
+#include "music-tags.hpp"
+
+// uncompressed (8/16-bit) and IMA/MS ADPCM .wav files
+class WavStream final : public AudioDecoder
+{
+public:
+    bool open(const std::string &filename, SourceInfo &info, MusicTags &tags);
+
+    // looks at the start of a file, for StreamRegistry
+    static bool probe(const uint8_t *header, int length);
+
+    int decode(int16_t *out, int maxFrames, QualityMode mode, int &blockChannels);
+
+    uint64_t seek(int ms);
+
+    uint32_t getInputPos() const;
+    const StreamFile &getFile() const;
+
+private:
+    enum class Encoding
+    {
+        PCM,
+        IMAADPCM,
+        MSADPCM,
+    };
+
+    // reads the fmt/data/fact/LIST chunks, returns false if the format can't be played
+    bool parseChunks(MusicTags &tags);
+    bool parseFormat(const uint8_t *buf, uint32_t len);
+    void parseInfo(uint32_t offset, uint32_t len, MusicTags &tags);
+
+    // reads PCM frames straight into out, converting 8-bit ones
+    int readPCM(int16_t *out, int maxFrames);
+
+    // reads and decodes the next ADPCM block into frameBuf, returns the number of frames
+    int readBlock();
+    int decodeIMA(const uint8_t *in, int32_t len);
+    int decodeMS(const uint8_t *in, int32_t len);
+
+    StreamFile file;
+
+    // the data chunk, dataPos is relative to dataOffset
+    uint32_t dataOffset = 0, dataLength = 0, dataPos = 0;
+
+    // format
+    Encoding encoding = Encoding::PCM;
+    int channels = 0, sampleRate = 0, bitsPerSample = 0;
+    int blockAlign = 0; // bytes per frame for PCM, per block for ADPCM
+    int samplesPerBlock = 0; // frames per ADPCM block
+    uint32_t totalFrames = 0;
+
+    static const int maxCoefs = 32;
+    int numCoefs = 0;
+    int16_t coefs[maxCoefs][2];
+
+    // one ADPCM block or some 8-bit PCM frames before conversion
+    static const int fileBufferSize = 2048;
+    uint8_t fileBuffer[fileBufferSize];
+
+    // the decoded ADPCM block, interleaved
+    static const int frameBufSize = 4096;
+    int16_t frameBuf[frameBufSize];
+    int frameCount = 0, framePos = 0;
+};
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "waveform.hpp"
+
+void Waveform::reset(uint32_t totalSamples)
+{
+    this->totalSamples = totalSamples;
+    position = 0;
+    curBucket = 0;
+    curBucketLen = 0;
+    curPeak = 0;
+    curSumSq = 0;
+
+    nextBoundary = (totalSamples + numBuckets - 1) / numBuckets;
+
+    memset(peak, 0, sizeof(peak));
+    memset(rms, 0, sizeof(rms));
+
+    version++;
+}
+
+void Waveform::process(const int16_t *samples, int count)
+{
+    // no duration, or the duration was wrong
+    if(!totalSamples || curBucket == numBuckets)
+        return;
+
+    for(int i = 0; i < count; i++)
+    {
+        int32_t s = samples[i];
+        int32_t absS = s < 0 ? -s : s;
+
+        if(absS > curPeak)
+            curPeak = absS;
+
+        curSumSq += s * s;
+        curBucketLen++;
+
+        if(++position >= nextBoundary)
+        {
+            finishBucket();
+
+            if(curBucket == numBuckets)
+                break;
+        }
+    }
+}
+
+void Waveform::setData(const uint8_t *peak, const uint8_t *rms)
+{
+    memcpy(this->peak, peak, numBuckets);
+    memcpy(this->rms, rms, numBuckets);
+
+    curBucket = numBuckets;
+    version++;
+}
+
+void Waveform::finish()
+{
+    // the duration was slightly off, flush whatever we have
+    if(totalSamples && curBucket < numBuckets)
+    {
+        finishBucket();
+        curBucket = numBuckets;
+    }
+}
+
+int Waveform::getFilledBuckets() const
+{
+    return curBucket;
+}
+
+uint32_t Waveform::getVersion() const
+{
+    return version;
+}
+
+const uint8_t *Waveform::getPeaks() const
+{
+    return peak;
+}
+
+const uint8_t *Waveform::getRMS() const
+{
+    return rms;
+}
+
+void Waveform::finishBucket()
+{
+    peak[curBucket] = std::min(curPeak >> 7, int32_t(255));
+
+    if(curBucketLen)
+        rms[curBucket] = std::min(static_cast<int32_t>(sqrtf(static_cast<float>(curSumSq) / curBucketLen)) >> 7, int32_t(255));
+
+    curBucket++;
+    curBucketLen = 0;
+    curPeak = 0;
+    curSumSq = 0;
+
+    // round up so the last bucket ends at the last sample
+    nextBoundary = (static_cast<uint64_t>(curBucket + 1) * totalSamples + numBuckets - 1) / numBuckets;
+
+    version++;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+// low resolution peak/RMS overview of a track, built up as it's decoded
+class Waveform final
+{
+public:
+    static const int numBuckets = 320;
+
+    void reset(uint32_t totalSamples);
+
+    void process(const int16_t *samples, int count);
+
+    // end of the track
+    void finish();
+
+    // from the track index
+    void setData(const uint8_t *peak, const uint8_t *rms);
+
+    // number of buckets filled in, all of them once the track has been played through
+    int getFilledBuckets() const;
+
+    // changes whenever the data does
+    uint32_t getVersion() const;
+
+    // 0-255, linear
+    const uint8_t *getPeaks() const;
+    const uint8_t *getRMS() const;
+
+private:
+    void finishBucket();
+
+    uint8_t peak[numBuckets], rms[numBuckets];
+
+    uint32_t totalSamples = 0, position = 0, nextBoundary = 0;
+    int curBucket = 0, curBucketLen = 0;
+    int32_t curPeak = 0;
+    int64_t curSumSq = 0;
+
+    uint32_t version = 0;
+};